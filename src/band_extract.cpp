@@ -1,4 +1,5 @@
 #include "raster_include.h"
+#include "raster_copy.h"
 
 /*
     argparse::ArgumentParser sub_band_extract("band_extract");
@@ -40,37 +41,59 @@ int band_extract(argparse::ArgumentParser* args, std::shared_ptr<spdlog::logger>
     PRINT_LOGGER(logger, info, fmt::format("ds_src.band is {}.", ds_src->GetRasterCount()));
     PRINT_LOGGER(logger, info, fmt::format("bands to extract is {}.", fmt::join(bands,", ")));
 
+    /// 所有波段的输出先全部创建, 再一次并行拷贝, 源数据只读取一遍
+    vector<int> valid_bands;
+    vector<raster_copy_target> targets;
+    vector<fs::path> out_paths;
     for(auto b : bands)
     {
-        fs::path new_path(src_path);
-        new_path.replace_extension(fmt::format("band_{}.tif",b));
-
-        auto rb = ds_src->GetRasterBand(b);
-        if(!rb){
+        if(b < 1 || b > ds_src->GetRasterCount()){
             PRINT_LOGGER(logger, error, fmt::format("band {}, is invalid",b));
             continue;
         }
-        auto datatype = rb->GetRasterDataType();
+        auto datatype = ds_src->GetRasterBand(b)->GetRasterDataType();
 
-        auto ds_out = driver->Create(new_path.string().c_str(), width, height, 1, datatype, NULL);
-        auto rb_out = ds_out->GetRasterBand(1);
+        fs::path new_path(src_path);
+        new_path.replace_extension(fmt::format("band_{}.tif",b));
 
+        auto ds_out = driver->Create(new_path.string().c_str(), width, height, 1, datatype, NULL);
+        if(!ds_out){
+            PRINT_LOGGER(logger, error, fmt::format("band {}, create '{}' failed",b, new_path.string()));
+            continue;
+        }
         ds_out->SetGeoTransform(gt);
         ds_out->SetProjection(ds_src->GetProjectionRef());
 
-        void* arr = malloc(width * GDALGetDataTypeSize(datatype));
+        valid_bands.push_back(b);
+        targets.push_back({ds_out, 1});
+        out_paths.push_back(new_path);
+    }
+    GDALClose(ds_src);
 
-        for(int i=0; i<height; i++)
-        {
-            rb->RasterIO(GF_Read, 0, i, width, 1, arr, width, 1, datatype, 0, 0);
-            rb_out->RasterIO(GF_Write, 0, i, width, 1, arr, width, 1, datatype, 0, 0);
-        }
-        
-        free(arr);
-        GDALClose(ds_out);
-        PRINT_LOGGER(logger, info, fmt::format("band {}, extract success.",b));
+    /// raster_copy按第一个波段的数据类型读写, 不同类型的波段分开拷贝
+    funcrst rst(true, "");
+    for(size_t k = 0; k < valid_bands.size() && rst; )
+    {
+        GDALDataType datatype = targets[k].ds->GetRasterBand(1)->GetRasterDataType();
+        size_t end = k;
+        while(end < valid_bands.size() && targets[end].ds->GetRasterBand(1)->GetRasterDataType() == datatype)
+            end++;
+        rst = raster_copy(src_path, 0, 0, width, height,
+            vector<int>(valid_bands.begin() + k, valid_bands.begin() + end),
+            vector<raster_copy_target>(targets.begin() + k, targets.begin() + end));
+        k = end;
+    }
+
+    for(auto& target : targets)
+        GDALClose(target.ds);
+
+    if(!rst){
+        PRINT_LOGGER(logger, error, fmt::format("band_extract failed, {}", rst.explain));
+        return -3;
+    }
+    for(size_t k = 0; k < valid_bands.size(); k++){
+        PRINT_LOGGER(logger, info, fmt::format("band {}, extract success ({}).", valid_bands[k], out_paths[k].string()));
     }
 
-    GDALClose(ds_src);
     return 1;
 }
\ No newline at end of file
@@ -1,22 +1,26 @@
 #include "datatype.h"
+#include "raw_file_io.h"
 
-/// @brief 可以逐行生成binary + vrt的类, 用法是先init定义类, 然后用array_to_bin按顺序的写二进制文件(注意不要用并行打乱存储顺序), 最后用print_vrt生成vrt文件
-/// @tparam _Ty 只支持float, cpx_float, short, cpx_short, 其余类型在init时会报错
+#include <mutex>
+
+/// @brief 可以逐行生成binary + vrt的类, 用法是先init定义类, 然后用array_to_bin按顺序的写二进制文件, 或用write_rows在多个线程中写互不重叠的行,
+/// 最后用print_vrt生成vrt文件. 数据先在缓冲区内整块交换字节序, 再以大块写入(raw_file_io.h)
+/// @tparam _Ty 支持byte, short, int, float, double及其复数类型, 其余类型在init时会报错
 template<typename _Ty>
 class binary_write
 {
 public:
     binary_write(){}
     ~binary_write(){
-        if(ofs.is_open())
-            ofs.close();
+        flush();
+        file.close();
         if(m_looper_time != nullptr)
-            delete[] m_looper_time;
+            delete m_looper_time;
     }
 
-    funcrst init(const char* binary_filepath, int height, int width, ByteOrder_ byte_order)
+    /// @param direct_io 写入时绕过系统缓存, 适合远大于内存的数据
+    funcrst init(const char* binary_filepath, int height, int width, ByteOrder_ byte_order, bool direct_io = false)
     {
-        using std::ios;
         funcrst rst;
         fs::path binary_path(binary_filepath);
 
@@ -49,9 +53,14 @@ public:
         else
             return funcrst(false, "print_vrt, unknown type of arr");
 
-        ofs.open(m_bin_filepath, ios::binary);
-        if(!ofs.is_open()){
-            return funcrst(false, "ofs open failed.");
+        m_swap = need_swap(byte_order);
+        m_offset = 0;
+        m_buffer_used = 0;
+        if(!m_buffer.reserve(buffer_size))
+            return funcrst(false, "buffer alloc failed.");
+        rst = file.open(m_bin_filepath, true, uint64_t(height) * width * sizeof(_Ty), direct_io);
+        if(!rst){
+            return rst;
         }
 
         /// for_looper_time
@@ -62,50 +71,73 @@ public:
         return funcrst(true, "binary_write::init success.");
     }
 
-    /// @brief 使用的是顺序存储模式, 所以要避免多任务并行, 以及非正常顺序(倒序, 乱序等)的存储方式
+    /// @brief 顺序写入, 数据先拷贝到缓冲区(按需交换字节序), 缓冲区满时整块写出, 不能与write_rows混用
     /// @param arr 数组
     /// @param length 数组长度
-    void array_to_bin(_Ty* arr, size_t length)
+    funcrst array_to_bin(const _Ty* arr, size_t length)
     {
-        if (m_byteorder == ByteOrder_::MSB)
+        size_t capacity = buffer_size / sizeof(_Ty);
+        while(length > 0)
         {
-            /// 数组存储格式的转换(从小端转换到大端存储)
-            if (std::is_same<_Ty, float>::value || std::is_same<_Ty, short>::value)
-            {
-                _Ty val;
-                for (int i = 0; i < length; i++) {
-                    val = swap(arr[i]);
-                    ofs.write((char*)(&val), sizeof(val));
-                }
-            }
-            else if (std::is_same<_Ty, std::complex<short>>::value) { ///complex short
-                short* arr_st = (short*)(arr);
-                short val;
-                for (size_t i = 0; i < 2 * length; i++) {
-                    val = swap(arr_st[i]);
-                    ofs.write((char*)(&val), sizeof(val));
-                }
-            }
-            else if(std::is_same<_Ty, std::complex<float>>::value) { /// complex float
-                float* arr_flt = (float*)(arr);
-                float val;
-                for (size_t i = 0; i < 2*length; i++) {
-                    val = swap(arr_flt[i]);
-                    ofs.write((char*)(&val), sizeof(val));
-                }
-            }
-            else {
-                return ;
+            size_t count = MIN(length, capacity - m_buffer_used);
+            _Ty* dst = (_Ty*)m_buffer.data() + m_buffer_used;
+            std::memcpy(dst, arr, count * sizeof(_Ty));
+            if(m_swap)
+                swap_byte_order(dst, count);
+            m_buffer_used += count;
+            arr += count;
+            length -= count;
+            if(m_buffer_used == capacity){
+                funcrst rst = flush();
+                if(!rst)
+                    return rst;
             }
+            m_looper_time->m_current += count - 1;
+            m_looper_time->update_percentage(); /// 先从外部让m_current加上count-1, 在update时++m_current就正常了
         }
-        else {
-            /// 如果不需要转换到大端存储模式, 则直接逐个写二进制文件即可
-            for (int i = 0; i < length; i++) {
-                ofs.write((char*)(&arr[i]), sizeof(_Ty));
-            }
+        return funcrst(true, "array_to_bin success.");
+    }
+
+    /// @brief 将array_to_bin缓冲区中的数据写出
+    funcrst flush()
+    {
+        if(m_buffer_used == 0 || !file.is_open())
+            return funcrst(true, "flush success.");
+        funcrst rst = file.write_at(m_offset, m_buffer.data(), m_buffer_used * sizeof(_Ty));
+        m_offset += m_buffer_used * sizeof(_Ty);
+        m_buffer_used = 0;
+        return rst;
+    }
+
+    /// @brief 写入第row行开始的rows行(arr长度为rows * width), 按偏移量写入, 多个线程可以同时写不同的行
+    funcrst write_rows(int row, int rows, const _Ty* arr)
+    {
+        if(row < 0 || rows < 0 || size_t(row) + rows > m_height)
+            return funcrst(false, "write_rows, rows out of range.");
+        size_t length = size_t(rows) * m_width;
+        uint64_t offset = uint64_t(row) * m_width * sizeof(_Ty);
+        funcrst rst;
+        if(m_swap){
+            /// 在对齐缓冲区中与文件偏移量保持相同的对齐余数, direct io时无需再次拷贝
+            thread_local aligned_buffer buffer;
+            size_t shift = size_t(offset % aligned_buffer::alignment);
+            unsigned char* ptr = buffer.reserve(shift + length * sizeof(_Ty));
+            if(!ptr)
+                return funcrst(false, "write_rows, buffer alloc failed.");
+            std::memcpy(ptr + shift, arr, length * sizeof(_Ty));
+            swap_byte_order((_Ty*)(ptr + shift), length);
+            rst = file.write_at(offset, ptr + shift, length * sizeof(_Ty));
+        }
+        else{
+            rst = file.write_at(offset, arr, length * sizeof(_Ty));
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(length > 0){
+            m_looper_time->m_current += length - 1;
+            m_looper_time->update_percentage();
         }
-        m_looper_time->m_current += length - 1;
-        m_looper_time->update_percentage(); /// 先从外部让m_current加上length-1, 在update时++m_current就正常了
+        return rst;
     }
 
     /// 需要二进制文件完成后再执行
@@ -143,14 +175,22 @@ public:
         return funcrst(true, "print_vrt success.");
     }
 
-    void close(){
-        if(ofs.is_open())
-            ofs.close();
+    funcrst close(){
+        funcrst rst = flush();
+        file.close();
         std::cout<<std::endl;
+        return rst;
     }
 
     public:
-        std::ofstream ofs;
+        static constexpr size_t buffer_size = size_t(8) << 20;   ///< array_to_bin的缓冲区大小, 为对齐大小的整数倍
+
+        raw_file file;
+        aligned_buffer m_buffer;
+        size_t m_buffer_used = 0;       ///< 缓冲区中的元素数
+        uint64_t m_offset = 0;          ///< 缓冲区对应的文件偏移量
+        bool m_swap = false;
+        std::mutex m_mutex;
         ByteOrder_ m_byteorder;
         for_loop_timer* m_looper_time = nullptr;
         size_t m_width, m_height;
@@ -0,0 +1,177 @@
+#ifndef BLOCK_WINDOW_H
+#define BLOCK_WINDOW_H
+
+#include <gdal_priv.h>
+
+#include <vector>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+
+#include "datatype.h"
+
+/// 按block对齐的窗口划分, 以及基于窗口的多线程 读取 -> 处理 -> 写出 流程
+
+/// @brief 单个读写窗口, 行列号均为band内的行列号
+struct block_window{
+    int band;
+    int x, y, xsize, ysize;
+};
+
+/// @brief 按rb的block尺寸划分rb内的子区域[x0, x0+xsize) x [y0, y0+ysize), 窗口边界与block网格对齐(首尾窗口可能不完整),
+/// 每个窗口包含整数个block, 像素数约为target_pixels(至少一个block), 先沿行方向拼接block, 整行仍不足target_pixels时再向下拼接block行. 
+/// 1~bands的每个波段都使用相同的划分(同一数据集的各波段尺寸与block尺寸通常一致)
+inline std::vector<block_window> split_block_windows(GDALRasterBand* rb, int x0, int y0, int xsize, int ysize, int bands, size_t target_pixels = size_t(1) << 22)
+{
+    std::vector<block_window> windows;
+    if(rb == nullptr || bands < 1 || xsize < 1 || ysize < 1)
+        return windows;
+
+    int block_x = 0, block_y = 0;
+    rb->GetBlockSize(&block_x, &block_y);
+    block_x = MAX(1, MIN(block_x, rb->GetXSize()));
+    block_y = MAX(1, MIN(block_y, rb->GetYSize()));
+
+    int win_x = block_x * MAX(1, int(MIN(size_t((xsize + block_x - 1) / block_x + 1), target_pixels / (size_t(block_x) * block_y))));
+    int win_y = block_y * MAX(1, int(target_pixels / (size_t(MIN(win_x, xsize)) * block_y)));
+
+    /// 窗口的起点对齐到block网格: 第一个窗口从x0(y0)到下一个网格边界
+    int grid_x0 = x0 - x0 % block_x;
+    int grid_y0 = y0 - y0 % block_y;
+    for(int b = 1; b <= bands; b++)
+        for(int y = grid_y0; y < y0 + ysize; y += win_y)
+            for(int x = grid_x0; x < x0 + xsize; x += win_x){
+                int left = MAX(x, x0), top = MAX(y, y0);
+                int right = MIN(x + win_x, x0 + xsize), bottom = MIN(y + win_y, y0 + ysize);
+                windows.push_back({b, left, top, right - left, bottom - top});
+            }
+    return windows;
+}
+
+inline std::vector<block_window> split_block_windows(GDALRasterBand* rb, int bands, size_t target_pixels = size_t(1) << 22)
+{
+    if(rb == nullptr)
+        return {};
+    return split_block_windows(rb, 0, 0, rb->GetXSize(), rb->GetYSize(), bands, target_pixels);
+}
+
+inline std::vector<block_window> split_block_windows(GDALDataset* ds, size_t target_pixels = size_t(1) << 22)
+{
+    if(ds == nullptr || ds->GetRasterCount() < 1)
+        return {};
+    return split_block_windows(ds->GetRasterBand(1), ds->GetRasterCount(), target_pixels);
+}
+
+/// @brief c++类型对应的GDALDataType
+template<typename _Ty> constexpr GDALDataType gdal_datatype_of() { return GDT_Unknown; }
+template<> constexpr GDALDataType gdal_datatype_of<unsigned char>()  { return GDT_Byte; }
+template<> constexpr GDALDataType gdal_datatype_of<unsigned short>() { return GDT_UInt16; }
+template<> constexpr GDALDataType gdal_datatype_of<short>()          { return GDT_Int16; }
+template<> constexpr GDALDataType gdal_datatype_of<unsigned int>()   { return GDT_UInt32; }
+template<> constexpr GDALDataType gdal_datatype_of<int>()            { return GDT_Int32; }
+template<> constexpr GDALDataType gdal_datatype_of<float>()          { return GDT_Float32; }
+template<> constexpr GDALDataType gdal_datatype_of<double>()         { return GDT_Float64; }
+#if GDAL_VERSION_NUM >= 3050000
+template<> constexpr GDALDataType gdal_datatype_of<std::int64_t>()   { return GDT_Int64; }
+template<> constexpr GDALDataType gdal_datatype_of<std::uint64_t>()  { return GDT_UInt64; }
+#endif
+#if GDAL_VERSION_NUM >= 3070000
+template<> constexpr GDALDataType gdal_datatype_of<std::int8_t>()    { return GDT_Int8; }
+#endif
+
+/// @brief 对ds_in的所有波段逐窗口执行 读取 -> op(band, arr, count) -> 写出到ds_out的同一位置, band从1开始, op会在多个线程中同时调用.
+/// 窗口(含所有波段)在多个线程间分配, 每个线程只申请一次缓冲区. GDALDataset不是线程安全的: ds_in与ds_out不同时,
+/// 每个线程按ds_in的路径以只读方式打开各自的句柄并行读取(与raster_copy一致), 只有写出在互斥锁内执行;
+/// ds_in与ds_out为同一个数据集(原地处理)或ds_in无法按路径重新打开(如MEM)时, 读取也在锁内通过ds_in执行
+template<typename _Ty, typename _Op>
+funcrst block_transform(GDALDataset* ds_in, GDALDataset* ds_out, std::string func_name, _Op op)
+{
+    using namespace std;
+    constexpr GDALDataType datatype = gdal_datatype_of<_Ty>();
+    static_assert(datatype != GDT_Unknown, "block_transform, unsupported type.");
+
+    if(ds_in == nullptr || ds_out == nullptr)
+        return funcrst(false, func_name + ", ds_in or ds_out is nullptr.");
+
+    vector<block_window> windows = split_block_windows(ds_in);
+    int num = int(windows.size());
+    int done = 0;
+    double last_percent = -1;
+    std::atomic<bool> failed(false);
+    string err_msg;
+
+    /// 原地处理时读写共用一个锁, 否则读取使用线程内的句柄
+    std::mutex mutex_io, mutex_state;
+    bool thread_reader = ds_in != ds_out;
+    std::string src_path = ds_in->GetDescription();
+
+    auto set_failed = [&](){
+        std::lock_guard<std::mutex> lock(mutex_state);
+        if(!failed.exchange(true))
+            err_msg = CPLGetLastErrorMsg();
+    };
+
+    cout<<"progress: ";
+#pragma omp parallel
+    {
+        vector<_Ty> arr;
+        GDALDataset* ds_thread = thread_reader ? (GDALDataset*)GDALOpen(src_path.c_str(), GA_ReadOnly) : nullptr;
+#pragma omp for schedule(dynamic)
+        for(int w = 0; w < num; w++)
+        {
+            if(failed)
+                continue;
+            const block_window& win = windows[w];
+            size_t count = size_t(win.xsize) * win.ysize;
+            arr.resize(count);
+
+            CPLErr err;
+            if(ds_thread){
+                err = ds_thread->GetRasterBand(win.band)->RasterIO(GF_Read, win.x, win.y, win.xsize, win.ysize, arr.data(), win.xsize, win.ysize, datatype, 0, 0);
+            }
+            else{
+                std::lock_guard<std::mutex> lock(mutex_io);
+                err = ds_in->GetRasterBand(win.band)->RasterIO(GF_Read, win.x, win.y, win.xsize, win.ysize, arr.data(), win.xsize, win.ysize, datatype, 0, 0);
+            }
+            if(err != CE_None){
+                set_failed();
+                continue;
+            }
+
+            op(win.band, arr.data(), count);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_io);
+                err = ds_out->GetRasterBand(win.band)->RasterIO(GF_Write, win.x, win.y, win.xsize, win.ysize, arr.data(), win.xsize, win.ysize, datatype, 0, 0);
+            }
+            if(err != CE_None){
+                set_failed();
+                continue;
+            }
+
+            ///print prog,
+            std::lock_guard<std::mutex> lock(mutex_state);
+            double percent = double(++done) / num;
+            if(percent - last_percent > 0.01 && int(percent * 100) % 5 == 0 && int(percent * 100) < 100)
+            {
+                last_percent = percent;
+                if(int(percent * 100)%10 == 0)
+                    cout<< int(percent * 100);
+                else
+                    cout<< "..";
+            }
+        }
+        if(ds_thread)
+            GDALClose(ds_thread);
+    }
+    cout<<100<<endl;
+
+    if(failed || done != num)
+        return funcrst(false, func_name + ", RasterIO failed. (" + err_msg + ")");
+
+    return funcrst(true, func_name + " func successd.");
+}
+
+#endif // BLOCK_WINDOW_H
@@ -0,0 +1,277 @@
+#include "raster_include.h"
+#include "block_window.h"
+
+#include <cmath>
+#include <mutex>
+#include <complex>
+#include <atomic>
+#include <omp.h>
+
+/*
+    sub_build_overviews.add_argument("img_path")
+        .help("image filepath, overviews of all bands will be rebuilt, complex bands are resampled as complex values.");
+
+    sub_build_overviews.add_argument("-l","--levels")
+        .help("overview levels, powers of 2 in ascending order, e.g. '-l 2 4 8 16', default is 2, 4, ... until the overview is smaller than 256 pixels.")
+        .scan<'i',int>()
+        .nargs(argparse::nargs_pattern::at_least_one);
+
+    sub_build_overviews.add_argument("-r","--resample")
+        .help("resampling kernel: nearest, average, gauss or mode, default is average.")
+        .choices("nearest","average","gauss","mode")
+        .default_value("average");
+
+    sub_build_overviews.add_argument("--external")
+        .help("write overviews into an external '.ovr' file, the image itself is opened read-only.")
+        .implicit_value(true)
+        .default_value(false);
+*/
+
+namespace {
+
+enum class ovr_kernel{nearest, average, gauss, mode};
+
+/// @brief 是否为有效值, 复数的nodata只比较实部(与GDAL一致)
+bool is_valid(double v, bool has_nodata, double nodata)
+{
+    return !std::isnan(v) && !(has_nodata && v == nodata);
+}
+
+bool is_valid(const std::complex<double>& v, bool has_nodata, double nodata)
+{
+    return !std::isnan(v.imag()) && is_valid(v.real(), has_nodata, nodata);
+}
+
+/// @brief 从上一级(src)的窗口计算当前级(dst)的窗口, 每级为上一级的1/2.
+/// dst的像素(x, y)对应src的像素(2x, 2y)~(2x+1, 2y+1), src窗口的左上角为(src_x0, src_y0), 尺寸为src_w * src_h(已裁剪到上一级的范围内).
+/// nodata与nan不参与计算, 全部无效时输出invalid; _Ty为double或std::complex<double>, 复数按复数加权平均
+template<typename _Ty>
+void downsample_2x(const _Ty* src, int src_x0, int src_y0, int src_w, int src_h,
+    _Ty* dst, int dst_x0, int dst_y0, int dst_w, int dst_h,
+    ovr_kernel kernel, bool has_nodata, double nodata, _Ty invalid)
+{
+    auto valid = [&](const _Ty& v){ return is_valid(v, has_nodata, nodata); };
+    /// gauss为可分离的[1,3,3,1]/8, 以(2x+0.5, 2y+0.5)为中心
+    static const double gauss_w[4] = {1, 3, 3, 1};
+
+    std::vector<_Ty> values;
+    for(int i = 0; i < dst_h; i++)
+    {
+        int sy = 2 * (dst_y0 + i) - src_y0;
+        for(int j = 0; j < dst_w; j++)
+        {
+            int sx = 2 * (dst_x0 + j) - src_x0;
+            _Ty& out = dst[size_t(i) * dst_w + j];
+            out = invalid;
+
+            if(kernel == ovr_kernel::nearest){
+                /// 取2x2中的左上角, 与GDAL的nearest一致; 无效时依次取其余像素
+                for(int k = 0; k < 4; k++){
+                    int y = sy + k / 2, x = sx + k % 2;
+                    if(y < src_h && x < src_w && valid(src[size_t(y) * src_w + x])){
+                        out = src[size_t(y) * src_w + x];
+                        break;
+                    }
+                }
+                continue;
+            }
+
+            if(kernel == ovr_kernel::mode){
+                values.clear();
+                for(int y = sy; y < MIN(sy + 2, src_h); y++)
+                    for(int x = sx; x < MIN(sx + 2, src_w); x++)
+                        if(valid(src[size_t(y) * src_w + x]))
+                            values.push_back(src[size_t(y) * src_w + x]);
+                int best = 0;
+                for(size_t a = 0; a < values.size(); a++){
+                    int cnt = 0;
+                    for(size_t b = 0; b < values.size(); b++)
+                        cnt += values[b] == values[a];
+                    if(cnt > best){
+                        best = cnt;
+                        out = values[a];
+                    }
+                }
+                continue;
+            }
+
+            int r0 = kernel == ovr_kernel::gauss ? -1 : 0;
+            int r1 = kernel == ovr_kernel::gauss ? 3 : 2;
+            _Ty sum = 0;
+            double weight = 0;
+            for(int dy = r0; dy < r1; dy++){
+                int y = sy + dy;
+                if(y < 0 || y >= src_h)
+                    continue;
+                for(int dx = r0; dx < r1; dx++){
+                    int x = sx + dx;
+                    if(x < 0 || x >= src_w)
+                        continue;
+                    const _Ty& v = src[size_t(y) * src_w + x];
+                    if(!valid(v))
+                        continue;
+                    double w = kernel == ovr_kernel::gauss ? gauss_w[dy + 1] * gauss_w[dx + 1] : 1;
+                    sum += v * w;
+                    weight += w;
+                }
+            }
+            if(weight > 0)
+                out = sum / weight;
+        }
+    }
+}
+
+/// @brief rb中尺寸为xsize * ysize的概视图
+GDALRasterBand* find_overview(GDALRasterBand* rb, int xsize, int ysize)
+{
+    for(int i = 0; i < rb->GetOverviewCount(); i++){
+        GDALRasterBand* ov = rb->GetOverview(i);
+        if(ov && ov->GetXSize() == xsize && ov->GetYSize() == ysize)
+            return ov;
+    }
+    return nullptr;
+}
+
+}
+
+int build_overviews(argparse::ArgumentParser* args, std::shared_ptr<spdlog::logger> logger)
+{
+    GDALAllRegister();
+    CPLSetConfigOption("GDAL_FILENAME_IS_UTF8", "NO");
+
+    std::string img_path = args->get<std::string>("img_path");
+    std::string str_kernel = args->get<std::string>("--resample");
+    bool external = args->get<bool>("--external");
+    ovr_kernel kernel = ovr_kernel::average;
+    if(str_kernel == "nearest")     kernel = ovr_kernel::nearest;
+    else if(str_kernel == "gauss")  kernel = ovr_kernel::gauss;
+    else if(str_kernel == "mode")   kernel = ovr_kernel::mode;
+
+    /// 外部概视图(.ovr)以只读方式打开原始影像
+    GDALDataset* ds = (GDALDataset*)GDALOpen(img_path.c_str(), external ? GA_ReadOnly : GA_Update);
+    if(!ds){
+        PRINT_LOGGER(logger, error, "ds is nullptr.");
+        return -1;
+    }
+    int width = ds->GetRasterXSize();
+    int height = ds->GetRasterYSize();
+    int bands = ds->GetRasterCount();
+
+    std::vector<int> levels;
+    if(args->is_used("--levels")){
+        levels = args->get<std::vector<int>>("--levels");
+    }
+    else{
+        for(int level = 2; MAX(width, height) / level >= 256; level *= 2)
+            levels.push_back(level);
+        if(levels.empty())
+            levels.push_back(2);
+    }
+    for(size_t k = 0; k < levels.size(); k++){
+        int prev = k == 0 ? 1 : levels[k - 1];
+        if(levels[k] != prev * 2){
+            GDALClose(ds);
+            PRINT_LOGGER(logger, error, fmt::format("levels should be 2, 4, 8, ... in ascending order, level ({}) is invalid.", levels[k]));
+            return -1;
+        }
+    }
+    PRINT_LOGGER(logger, info, fmt::format("levels: {}, resample: {}.", fmt::join(levels, ", "), str_kernel));
+
+    /// 先清除已有的概视图, 再以"NONE"创建空的概视图, 数值由下面逐级计算
+    if(GDALBuildOverviews(ds, "NONE", 0, nullptr, 0, nullptr, nullptr, nullptr) != CE_None ||
+       GDALBuildOverviews(ds, "NONE", int(levels.size()), levels.data(), 0, nullptr, nullptr, nullptr) != CE_None){
+        GDALClose(ds);
+        PRINT_LOGGER(logger, error, fmt::format("create overviews failed, {}", CPLGetLastErrorMsg()));
+        return -2;
+    }
+
+    /// GDALDataset不是线程安全的: 读写在锁内执行, 重采样在锁外并行
+    std::mutex mutex_io;
+    auto start_time = std::chrono::system_clock::now();
+    for(size_t k = 0; k < levels.size(); k++)
+    {
+        int level = levels[k];
+        int dst_w = (width + level - 1) / level, dst_h = (height + level - 1) / level;
+        std::vector<GDALRasterBand*> rb_src(bands), rb_dst(bands);
+        std::vector<int> has_nodata(bands, 0);
+        std::vector<double> nodata(bands, 0);
+        std::vector<bool> is_complex(bands, false);
+        bool found = true;
+        for(int b = 1; b <= bands; b++){
+            GDALRasterBand* rb = ds->GetRasterBand(b);
+            nodata[b - 1] = rb->GetNoDataValue(&has_nodata[b - 1]);
+            is_complex[b - 1] = GDALDataTypeIsComplex(rb->GetRasterDataType()) != 0;
+            int prev = level / 2;
+            rb_src[b - 1] = prev == 1 ? rb : find_overview(rb, (width + prev - 1) / prev, (height + prev - 1) / prev);
+            rb_dst[b - 1] = find_overview(rb, dst_w, dst_h);
+            found = found && rb_src[b - 1] && rb_dst[b - 1];
+        }
+        if(!found){
+            GDALClose(ds);
+            PRINT_LOGGER(logger, error, fmt::format("level {}, overview band is not found.", level));
+            return -3;
+        }
+
+        /// 每个窗口约1M像素(输出), 对应上一级约4M像素
+        std::vector<block_window> windows = split_block_windows(rb_dst[0], bands, size_t(1) << 20);
+        int num = int(windows.size());
+        int halo = kernel == ovr_kernel::gauss ? 1 : 0;
+        std::atomic<bool> failed(false);
+
+        /// 复数波段以GDT_CFloat64读写, 实部与虚部一起重采样
+        auto process = [&](const block_window& win, auto& src, auto& dst, GDALDataType buf_type) -> CPLErr
+        {
+            using value_type = typename std::decay_t<decltype(src)>::value_type;
+            GDALRasterBand* rs = rb_src[win.band - 1];
+            GDALRasterBand* rd = rb_dst[win.band - 1];
+            int x0 = MAX(0, 2 * win.x - halo), y0 = MAX(0, 2 * win.y - halo);
+            int x1 = MIN(rs->GetXSize(), 2 * (win.x + win.xsize) + halo);
+            int y1 = MIN(rs->GetYSize(), 2 * (win.y + win.ysize) + halo);
+            src.resize(size_t(x1 - x0) * (y1 - y0));
+            dst.resize(size_t(win.xsize) * win.ysize);
+
+            CPLErr err;
+            {
+                std::lock_guard<std::mutex> lock(mutex_io);
+                err = rs->RasterIO(GF_Read, x0, y0, x1 - x0, y1 - y0, src.data(), x1 - x0, y1 - y0, buf_type, 0, 0);
+            }
+            if(err != CE_None)
+                return err;
+
+            int b = win.band - 1;
+            value_type invalid = has_nodata[b] ? value_type(nodata[b]) : value_type(NAN);
+            downsample_2x(src.data(), x0, y0, x1 - x0, y1 - y0, dst.data(), win.x, win.y, win.xsize, win.ysize,
+                kernel, has_nodata[b] != 0, nodata[b], invalid);
+
+            std::lock_guard<std::mutex> lock(mutex_io);
+            return rd->RasterIO(GF_Write, win.x, win.y, win.xsize, win.ysize, dst.data(), win.xsize, win.ysize, buf_type, 0, 0);
+        };
+
+#pragma omp parallel
+        {
+            std::vector<double> src, dst;
+            std::vector<std::complex<double>> csrc, cdst;
+#pragma omp for schedule(dynamic)
+            for(int w = 0; w < num; w++)
+            {
+                if(failed)
+                    continue;
+                const block_window& win = windows[w];
+                CPLErr err = is_complex[win.band - 1] ? process(win, csrc, cdst, GDT_CFloat64) : process(win, src, dst, GDT_Float64);
+                if(err != CE_None)
+                    failed = true;
+            }
+        }
+
+        if(failed){
+            GDALClose(ds);
+            PRINT_LOGGER(logger, error, fmt::format("level {}, RasterIO failed, {}", level, CPLGetLastErrorMsg()));
+            return -4;
+        }
+        PRINT_LOGGER(logger, info, fmt::format("level {} ({}x{}) finished.", level, dst_w, dst_h));
+    }
+
+    GDALClose(ds);
+    PRINT_LOGGER(logger, info, fmt::format("build_overviews success, spend time {}s.", spend_time(start_time)));
+    return 1;
+}
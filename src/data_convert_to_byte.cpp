@@ -1,9 +1,203 @@
 #include "raster_include.h"
+#include "raster_statistics.h"
+#include "block_window.h"
 
 #include <string>
+#include <memory>
+#include <type_traits>
 #include <filesystem>
 namespace fs = std::filesystem;
 
+/*
+    sub_data_to_8bit.add_argument("img_path")
+        .help("image filepath, supporting  data in 'byte', '(u)short', '(u)int', 'float', 'double' type");
+
+    sub_data_to_8bit.add_argument("out_path")
+        .help("out_path, which extension could be changed if it's diff with 'enxtension' par");
+
+    sub_data_to_8bit.add_argument("extension")
+        .help("extension, support jpg, png, bmp and tif");
+
+    sub_data_to_8bit.add_argument("-r","--range")
+        .help("value range used to map to [0,255]: band (min/max of each band) or global (min/max of all bands), default is band.")
+        .choices("band","global")
+        .default_value("band");
+
+    sub_data_to_8bit.add_argument("-s","--stretch_rate")
+        .help("optional, remove the extreme values at both ends by proportion before mapping, within (0,0.5), e.g. 0.02. byte data is copied unchanged without it.")
+        .scan<'g',double>();
+
+    sub_data_to_8bit.add_argument("--approx")
+        .help("approximate min/max (and stretch) from overviews if existed (see 'build_overviews'), otherwise from one of every 10 blocks.")
+        .implicit_value(true)
+        .default_value(false);
+*/
+
+namespace {
+
+/// @brief 单个波段的线性映射: (value - min) / (max - min) * 255, 截断到[0,255], nan为0
+struct byte_range
+{
+    double min, max;
+
+    double width() const { return max == min ? 1 : max - min; }
+};
+
+/// @brief 以lut或向量化的缩放截断将一段数据转为8bit, 8/16位整数使用预先计算的查找表
+template<typename _Ty>
+class byte_quantizer
+{
+public:
+    explicit byte_quantizer(byte_range range) : m_range(range)
+    {
+        if constexpr (sizeof(_Ty) <= 2 && std::is_integral<_Ty>::value){
+            constexpr int lut_size = 1 << (8 * sizeof(_Ty));
+            m_lut.resize(lut_size);
+            for(int i = 0; i < lut_size; i++){
+                /// 按_Ty的位模式索引, 有符号类型的负数同样适用
+                _Ty val = _Ty(std::make_unsigned_t<_Ty>(i));
+                m_lut[i] = map(double(val));
+            }
+        }
+    }
+
+    void operator()(const _Ty* in, size_t count, unsigned char* out) const
+    {
+        if constexpr (sizeof(_Ty) <= 2 && std::is_integral<_Ty>::value){
+            const unsigned char* lut = m_lut.data();
+            for(size_t i = 0; i < count; i++)
+                out[i] = lut[std::make_unsigned_t<_Ty>(in[i])];
+        }
+        else{
+            /// float, double, 32位整数: 缩放后截断, nan经比较后为0
+            double min = m_range.min;
+            double width = m_range.width();
+#pragma omp simd
+            for(size_t i = 0; i < count; i++){
+                double val = (double(in[i]) - min) / width * 255;
+                val = val >= 0 ? val : 0;
+                val = val <= 255 ? val : 255;
+                out[i] = (unsigned char)(val);
+            }
+        }
+    }
+
+private:
+    unsigned char map(double value) const
+    {
+        double val = (value - m_range.min) / m_range.width() * 255;
+        val = val < 0 ? 0 : (val > 255 ? 255 : val);
+        return (unsigned char)(val);
+    }
+
+    byte_range m_range;
+    std::vector<unsigned char> m_lut;
+};
+
+/// 只读的虚拟8bit数据集: 每个block在被读取时才从源数据集读取并转换, 作为CreateCopy的源,
+/// 使png/jpg等只支持CreateCopy的驱动也能逐block写出, 不需要完整的MEM数据集
+
+class byte_convert_dataset : public GDALDataset
+{
+public:
+    byte_convert_dataset(GDALDataset* src, const std::vector<byte_range>& ranges, const std::vector<int>& bands);
+
+    CPLErr GetGeoTransform(double* gt) override { return m_src->GetGeoTransform(gt); }
+    const OGRSpatialReference* GetSpatialRef() const override { return m_src->GetSpatialRef(); }
+
+    GDALDataset* source() { return m_src; }
+    int block_rows() const { return m_block_rows; }
+
+private:
+    GDALDataset* m_src;
+    int m_block_rows;
+};
+
+template<typename _Ty>
+class byte_convert_band : public GDALRasterBand
+{
+public:
+    byte_convert_band(byte_convert_dataset* ds, int band, int src_band, byte_range range)
+        : m_src_band(src_band), m_quantizer(range)
+    {
+        poDS = ds;
+        nBand = band;
+        eDataType = GDT_Byte;
+        nRasterXSize = ds->GetRasterXSize();
+        nRasterYSize = ds->GetRasterYSize();
+        nBlockXSize = nRasterXSize;
+        nBlockYSize = ds->block_rows();
+    }
+
+protected:
+    CPLErr IReadBlock(int, int block_y, void* image) override
+    {
+        int row = block_y * nBlockYSize;
+        int rows = MIN(nBlockYSize, nRasterYSize - row);
+        size_t count = size_t(rows) * nRasterXSize;
+        m_buffer.resize(count);
+
+        GDALDataset* src = static_cast<byte_convert_dataset*>(poDS)->source();
+        CPLErr err = src->GetRasterBand(m_src_band)->RasterIO(GF_Read, 0, row, nRasterXSize, rows, m_buffer.data(),
+            nRasterXSize, rows, gdal_datatype_of<_Ty>(), 0, 0);
+        if(err != CE_None)
+            return err;
+
+        unsigned char* out = static_cast<unsigned char*>(image);
+        m_quantizer(m_buffer.data(), count, out);
+        std::fill(out + count, out + size_t(nBlockYSize) * nBlockXSize, (unsigned char)0);
+        return CE_None;
+    }
+
+private:
+    int m_src_band;
+    byte_quantizer<_Ty> m_quantizer;
+    std::vector<_Ty> m_buffer;
+};
+
+byte_convert_dataset::byte_convert_dataset(GDALDataset* src, const std::vector<byte_range>& ranges, const std::vector<int>& bands)
+    : m_src(src)
+{
+    nRasterXSize = src->GetRasterXSize();
+    nRasterYSize = src->GetRasterYSize();
+
+    /// block行数与源数据的block对齐, 且每个block至少约1M像素, 减少源数据的读取次数
+    int block_x = 0, block_y = 0;
+    src->GetRasterBand(1)->GetBlockSize(&block_x, &block_y);
+    block_y = MAX(1, block_y);
+    m_block_rows = block_y * MAX(1, (1 << 20) / (MAX(1, nRasterXSize) * block_y));
+    m_block_rows = MIN(m_block_rows, MAX(1, nRasterYSize));
+
+    GDALDataType datatype = src->GetRasterBand(1)->GetRasterDataType();
+    for(size_t k = 0; k < bands.size(); k++){
+        int b = int(k) + 1;
+        GDALRasterBand* band = nullptr;
+        switch (datatype)
+        {
+        case GDT_Byte:      band = new byte_convert_band<unsigned char>(this, b, bands[k], ranges[k]); break;
+        case GDT_UInt16:    band = new byte_convert_band<unsigned short>(this, b, bands[k], ranges[k]); break;
+        case GDT_Int16:     band = new byte_convert_band<short>(this, b, bands[k], ranges[k]); break;
+        case GDT_UInt32:    band = new byte_convert_band<unsigned int>(this, b, bands[k], ranges[k]); break;
+        case GDT_Int32:     band = new byte_convert_band<int>(this, b, bands[k], ranges[k]); break;
+        case GDT_Float32:   band = new byte_convert_band<float>(this, b, bands[k], ranges[k]); break;
+        default:            band = new byte_convert_band<double>(this, b, bands[k], ranges[k]); break;
+        }
+        SetBand(b, band);
+    }
+}
+
+/// @brief 驱动是否支持对应的波段数
+bool driver_supports_bands(std::string driver, int bands)
+{
+    if(driver == "JPEG" || driver == "BMP")
+        return bands == 1 || bands == 3;
+    if(driver == "PNG")
+        return bands >= 1 && bands <= 4;
+    return true;
+}
+
+}
+
 int data_convert_to_byte(argparse::ArgumentParser* args,std::shared_ptr<spdlog::logger> logger)
 {
     GDALAllRegister();
@@ -13,10 +207,14 @@ int data_convert_to_byte(argparse::ArgumentParser* args,std::shared_ptr<spdlog::
     std::string out_path = args->get<std::string>("out_path");
     std::string extension = args->get<std::string>("extension"); /// png jpg tif bmp
     std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
-
-    if(extension != "png" && extension != "jpg" && extension != "tif" && extension != "bmp"){
-        PRINT_LOGGER(logger, error,fmt::format("un-supported extension '{}'",extension));
-        return -1;
+    bool global_range = args->get<std::string>("--range") == "global";
+    double stretch_rate = 0;
+    if(args->is_used("--stretch_rate")){
+        stretch_rate = args->get<double>("--stretch_rate");
+        if(stretch_rate <= 0 || stretch_rate >= 0.5){
+            PRINT_LOGGER(logger, warn, fmt::format("stretch_rate input is a invalid data ({}) which has been ignored.", stretch_rate));
+            stretch_rate = 0;
+        }
     }
 
     std::string gdal_driver_str = "";
@@ -42,8 +240,6 @@ int data_convert_to_byte(argparse::ArgumentParser* args,std::shared_ptr<spdlog::
         return -1;
     }
 
-
-
     fs::path p_out(out_path);
     if(p_out.extension().string() != ("." + extension)){
         std::string old_extension = p_out.extension().string();
@@ -57,126 +253,79 @@ int data_convert_to_byte(argparse::ArgumentParser* args,std::shared_ptr<spdlog::
         PRINT_LOGGER(logger, error, "ds_in is nullptr.");
         return -1;
     }
-    int width = ds_in->GetRasterXSize();
-    int height= ds_in->GetRasterYSize();
-    GDALRasterBand* rb_in = ds_in->GetRasterBand(1);
-    GDALDataType datatype = rb_in->GetRasterDataType();
-    int datasize = GDALGetDataTypeSize(datatype);
+    int bands = ds_in->GetRasterCount();
+    GDALDataType datatype = ds_in->GetRasterBand(1)->GetRasterDataType();
     if(datatype > 7 || datatype == 0){ /// 1(byte), 2(ushort), 3(short), 4(uint), 5(int), 6(float), 7(double)
         GDALClose(ds_in);
         PRINT_LOGGER(logger, error, fmt::format("datatype is complex({}), error.",GDALGetDataTypeName(datatype)));
         return -1;
     }
 
-    double minmax[2];
-    auto err = rb_in->ComputeRasterMinMax(FALSE,minmax);
-    if(err == CE_Failure){
-        PRINT_LOGGER(logger, error,"rb.computeRasterMinMax failed.");
-        return -2;
+    std::vector<int> out_bands;
+    if(driver_supports_bands(gdal_driver_str, bands)){
+        for(int b = 1; b <= bands; b++)
+            out_bands.push_back(b);
+    }
+    else{
+        out_bands.push_back(1);
+        PRINT_LOGGER(logger, warn, fmt::format("driver '{}' doesn't support {} bands, only band 1 will be converted.", gdal_driver_str, bands));
     }
 
-    auto value_map = [&minmax](double value) -> unsigned char{
-        if(minmax[1] == minmax[0])
-            return unsigned char(0);
-        return unsigned char( (value - minmax[0]) / ( minmax[1] -  minmax[0]) * 255 );
-    };
-
-    GDALDriver* dri_mem = GetGDALDriverManager()->GetDriverByName("MEM");
-    GDALDataset* ds_mem = dri_mem->Create("", width, height, 1, GDT_Byte, NULL);
-    
-    unsigned char* arr_out = new unsigned char[width];
-    switch (datatype)
-    {
-    case GDT_Byte:{
-        for(int i=0; i<height; i++){
-            rb_in->RasterIO(GF_Read, 0, i, width, 1, arr_out, width, 1, datatype, 0, 0);
-            ds_mem->GetRasterBand(1)->RasterIO(GF_Write, 0, i, width, 1, arr_out, width, 1, GDT_Byte, 0, 0);
+    /// Byte数据不拉伸时保持原值: 映射范围固定为[0,255], 不需要统计, --range不起作用
+    auto start_time = std::chrono::system_clock::now();
+    std::vector<byte_range> ranges(out_bands.size(), byte_range{0, 255});
+    bool identity = datatype == GDT_Byte && stretch_rate <= 0;
+    if(identity){
+        PRINT_LOGGER(logger, info, "byte data without stretch_rate, values are copied unchanged.");
+    }
+    else{
+        /// 并行遍历得到所有波段的最值, 拉伸时同时得到精确直方图(浮点与32位整数再遍历一次)
+        raster_statistics_options opt;
+        opt.bands = out_bands;
+        opt.histogram_size = stretch_rate > 0 ? 256 : 0;
+        opt.approx = args->get<bool>("--approx");
+        std::vector<band_statistics> stats;
+        funcrst rst = compute_raster_statistics(img_path, opt, stats);
+        if(!rst){
+            GDALClose(ds_in);
+            PRINT_LOGGER(logger, error, fmt::format("compute_raster_statistics failed. ({})", rst.explain));
+            return -2;
         }
 
-    }break;
-    case GDT_UInt16:{
-        unsigned short* arr = new unsigned short[width];
-        for(int i=0; i<height; i++){
-            rb_in->RasterIO(GF_Read, 0, i, width, 1, arr, width, 1, datatype, 0, 0);
-            for(int j=0; i<width; j++){
-                arr_out[j] = value_map(arr[j]);
-            }
-            ds_mem->GetRasterBand(1)->RasterIO(GF_Write, 0, i, width, 1, arr_out, width, 1, GDT_Byte, 0, 0);
-        }
-        delete[] arr;
-    }break;
-    case GDT_Int16:{
-        short* arr = new short[width];
-        for(int i=0; i<height; i++){
-            rb_in->RasterIO(GF_Read, 0, i, width, 1, arr, width, 1, datatype, 0, 0);
-            for(int j=0; i<width; j++){
-                arr_out[j] = value_map(arr[j]);
-            }
-            ds_mem->GetRasterBand(1)->RasterIO(GF_Write, 0, i, width, 1, arr_out, width, 1, GDT_Byte, 0, 0);
-        }
-        delete[] arr;
-    }break;
-    case GDT_UInt32:{
-        unsigned int* arr = new unsigned int[width];
-        for(int i=0; i<height; i++){
-            rb_in->RasterIO(GF_Read, 0, i, width, 1, arr, width, 1, datatype, 0, 0);
-            for(int j=0; i<width; j++){
-                arr_out[j] = value_map(arr[j]);
-            }
-            ds_mem->GetRasterBand(1)->RasterIO(GF_Write, 0, i, width, 1, arr_out, width, 1, GDT_Byte, 0, 0);
-        }
-        delete[] arr;
-    }break;
-    case GDT_Int32:{
-        int* arr = new int[width];
-        for(int i=0; i<height; i++){
-            rb_in->RasterIO(GF_Read, 0, i, width, 1, arr, width, 1, datatype, 0, 0);
-            for(int j=0; i<width; j++){
-                arr_out[j] = value_map(arr[j]);
+        for(size_t k = 0; k < out_bands.size(); k++){
+            ranges[k] = {stats[k].min, stats[k].max};
+            if(stretch_rate > 0){
+                rst = cal_stretched_minmax(stats[k], 256, stretch_rate, ranges[k].min, ranges[k].max);
+                if(!rst){
+                    PRINT_LOGGER(logger, warn, fmt::format("band[{}] cal_stretched_minmax failed ({}), min/max is used.", out_bands[k], rst.explain));
+                    ranges[k] = {stats[k].min, stats[k].max};
+                }
             }
-            ds_mem->GetRasterBand(1)->RasterIO(GF_Write, 0, i, width, 1, arr_out, width, 1, GDT_Byte, 0, 0);
         }
-        delete[] arr;
-    }break;
-    case GDT_Float32:{
-        float* arr = new float[width];
-        for(int i=0; i<height; i++){
-            rb_in->RasterIO(GF_Read, 0, i, width, 1, arr, width, 1, datatype, 0, 0);
-            for(int j=0; i<width; j++){
-                arr_out[j] = value_map(arr[j]);
-            }
-            ds_mem->GetRasterBand(1)->RasterIO(GF_Write, 0, i, width, 1, arr_out, width, 1, GDT_Byte, 0, 0);
-        }
-        delete[] arr;
-    }break;
-    case GDT_Float64:{
-        double* arr = new double[width];
-        for(int i=0; i<height; i++){
-            rb_in->RasterIO(GF_Read, 0, i, width, 1, arr, width, 1, datatype, 0, 0);
-            for(int j=0; i<width; j++){
-                arr_out[j] = value_map(arr[j]);
-            }
-            ds_mem->GetRasterBand(1)->RasterIO(GF_Write, 0, i, width, 1, arr_out, width, 1, GDT_Byte, 0, 0);
+    }
+    if(global_range && !identity){
+        byte_range global = ranges[0];
+        for(auto& range : ranges){
+            global.min = MIN(global.min, range.min);
+            global.max = MAX(global.max, range.max);
         }
-        delete[] arr;
-    }break;
-    default:
-        break;
+        std::fill(ranges.begin(), ranges.end(), global);
+    }
+    for(size_t k = 0; k < out_bands.size(); k++){
+        PRINT_LOGGER(logger, info, fmt::format("band[{}] mapping range: [{}, {}].", out_bands[k], ranges[k].min, ranges[k].max));
     }
-    
-    delete[] arr_out;
-    GDALClose(ds_in);
 
-    GDALDataset* ds_out = dri_out->CreateCopy(out_path.c_str(), ds_mem, false, nullptr, nullptr, nullptr);
+    /// 虚拟8bit数据集 -> CreateCopy, 目标驱动按block拉取数据
+    std::unique_ptr<byte_convert_dataset> ds_byte = std::make_unique<byte_convert_dataset>(ds_in, ranges, out_bands);
+    GDALDataset* ds_out = dri_out->CreateCopy(out_path.c_str(), ds_byte.get(), false, nullptr, GDALTermProgress, nullptr);
+    ds_byte.reset();
+    GDALClose(ds_in);
     if(!ds_out){
-        GDALClose(ds_mem);
         PRINT_LOGGER(logger, error,"ds_out is nullptr");
         return -3;
     }
-
-    GDALClose(ds_mem);
     GDALClose(ds_out);
-    
-    PRINT_LOGGER(logger, info,"data_convert_to_byte success.");
+
+    PRINT_LOGGER(logger, info, fmt::format("data_convert_to_byte success, spend time {}s.", spend_time(start_time)));
     return 1;
-}
\ No newline at end of file
+}
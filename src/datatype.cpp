@@ -673,49 +673,38 @@ void color_map::load_cpt(const char* cpt_path)
 }
 
 
-funcrst cal_stretched_minmax(GDALRasterBand* rb, int histogram_size, double stretch_rate, double& min, double& max)
+funcrst cal_stretched_minmax(const std::vector<uint64_t>& histogram, double hist_min, double hist_max, double stretch_rate, double& min, double& max)
 {
-	CPLErr cplerr;
-	double minmax[2];
-	cplerr = rb->ComputeRasterMinMax(false, minmax);
-	if (cplerr == CE_Failure) {
-		return funcrst(false, "rb.ComputeRasterMinMax failed.");
+	int histogram_size = int(histogram.size());
+	if (histogram_size < 2) {
+		return funcrst(false, "histogram size is less than 2.");
 	}
 
-	GUIntBig* histgram_result = new GUIntBig[histogram_size];
-	cplerr = rb->GetHistogram(minmax[0], minmax[1], histogram_size, histgram_result, FALSE, FALSE, GDALDummyProgress, nullptr);
-	if (cplerr == CE_Failure) {
-		delete[] histgram_result;
-		return funcrst(false, "rb.GetHistogram failed.");
-	}
-
-	GUIntBig* histgram_accumulate = new GUIntBig[histogram_size];
-	histgram_accumulate[0] = histgram_result[0];
+	std::vector<uint64_t> histgram_accumulate(histogram_size);
+	histgram_accumulate[0] = histogram[0];
 	for (int i = 1; i < histogram_size; i++) {
-		histgram_accumulate[i] = histgram_accumulate[i - 1] + histgram_result[i];
+		histgram_accumulate[i] = histgram_accumulate[i - 1] + histogram[i];
+	}
+	if (histgram_accumulate[histogram_size - 1] == 0) {
+		return funcrst(false, "histogram is empty.");
 	}
+
 	/// 换算成百分比
-	double* histgram_accumulate_percent = new double[histogram_size];
+	std::vector<double> histgram_accumulate_percent(histogram_size);
 	bool update_min{ false }, update_max{ false };
-    int index_min{-1}, index_max{-1};
 	for (int i = 0; i < histogram_size; i++) {
 		histgram_accumulate_percent[i] = 1. * histgram_accumulate[i] / histgram_accumulate[histogram_size - 1];
 		if (i == 0)continue;
 		if ((histgram_accumulate_percent[i - 1] <= stretch_rate || i == 1) && histgram_accumulate_percent[i] >= stretch_rate) {
-			min = minmax[0] + (minmax[1] - minmax[0]) / histogram_size * (i - 1);
-            index_min = i;
+			min = hist_min + (hist_max - hist_min) / histogram_size * (i - 1);
 			update_min = true;
 		}
 		if (histgram_accumulate_percent[i - 1] <= 1 - stretch_rate && histgram_accumulate_percent[i] >= 1 - stretch_rate) {
-			max = minmax[0] + (minmax[1] - minmax[0]) / histogram_size * i;
-            index_max = i;
+			max = hist_min + (hist_max - hist_min) / histogram_size * i;
 			update_max = true;
 		}
 	}
 
-	delete[] histgram_result;
-	delete[] histgram_accumulate;
-
 	if (!update_min) {
 		return funcrst(false, "min is not be updated.");
 	}
@@ -5,6 +5,7 @@
 #include <string>
 #include <complex>
 #include <chrono>
+#include <cstdint>
 
 #include <gdal_priv.h>
 
@@ -125,14 +126,14 @@ private:
 
 };
 
-/// @brief 通过创建直方图, 对影像进行百分比拉伸, 并获取拉伸后的最值
-/// @param rb RasterBand, 图像的某个波段
-/// @param histogram_size 直方图长度, 通常为100~256
+/// @brief 根据直方图对影像进行百分比拉伸, 获取拉伸后的最值
+/// @param histogram 直方图, 在[hist_min, hist_max]内等间隔划分, 长度通常为100~256
 /// @param stretch_rate 拉伸比例, 通常为 0.02
 /// @param min 要输出的最小值
 /// @param max 要输出的最大值
 /// @return 
-funcrst cal_stretched_minmax(GDALRasterBand* rb, int histogram_size, double stretch_rate, double& min, double& max);
+/// @note 从GDALRasterBand直接计算的版本(一次遍历得到最值与直方图)见raster_statistics.h
+funcrst cal_stretched_minmax(const std::vector<uint64_t>& histogram, double hist_min, double hist_max, double stretch_rate, double& min, double& max);
 
 
 struct err_hei_image{
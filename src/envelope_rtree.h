@@ -0,0 +1,181 @@
+#ifndef ENVELOPE_RTREE_H
+#define ENVELOPE_RTREE_H
+
+#include <ogr_core.h>
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <algorithm>
+
+/// 基于外接矩形(OGREnvelope)的静态R-tree, 用STR(Sort-Tile-Recursive)一次性批量构建, 构建后只读.
+/// 用于数万个分块数据的四至范围与shp中几何体的快速筛选: 先用外接矩形求出候选, 再只对候选做精确的GEOS相交判断.
+/// 查询不修改树, 可以在多个线程中同时调用.
+
+class envelope_rtree
+{
+public:
+    envelope_rtree() {}
+
+    /// @param envelopes 各元素的外接矩形, 查询结果为元素在envelopes中的下标
+    /// @param node_capacity 每个节点的子节点(或元素)数
+    explicit envelope_rtree(const std::vector<OGREnvelope>& envelopes, int node_capacity = 16)
+        : m_items(envelopes), m_capacity(std::max(2, node_capacity))
+    {
+        build();
+    }
+
+    /// 叶子节点的子元素为ids()[first, first+count), 非叶子节点的子节点为nodes()[first, first+count), 根节点在nodes()的末尾
+    struct node{
+        OGREnvelope env;
+        uint64_t first, count;
+        bool leaf;
+    };
+
+    /// @brief 由已构建好的树(如从文件中读取的ids()与nodes())恢复, 不重新排序; 结构不合法时为空树
+    envelope_rtree(const std::vector<OGREnvelope>& envelopes, std::vector<uint64_t> ids, std::vector<node> nodes, int node_capacity)
+        : m_items(envelopes), m_ids(std::move(ids)), m_nodes(std::move(nodes)), m_capacity(std::max(2, node_capacity))
+    {
+        bool ok = m_ids.size() == m_items.size() && (m_items.empty() == m_nodes.empty());
+        for(size_t k = 0; k < m_nodes.size() && ok; k++){
+            const node& n = m_nodes[k];
+            ok = n.leaf ? n.first + n.count <= m_ids.size() : n.first + n.count <= k;
+        }
+        for(size_t k = 0; k < m_ids.size() && ok; k++)
+            ok = m_ids[k] < m_items.size();
+        if(!ok){
+            m_ids.clear();
+            m_nodes.clear();
+        }
+    }
+
+    size_t size() const { return m_items.size(); }
+    int capacity() const { return m_capacity; }
+    const std::vector<uint64_t>& ids() const { return m_ids; }
+    const std::vector<node>& nodes() const { return m_nodes; }
+    const OGREnvelope& item(size_t id) const { return m_items[id]; }
+
+    /// @brief 对外接矩形与env相交的每个元素调用func(id)
+    template<typename _Func>
+    void query(const OGREnvelope& env, _Func&& func) const
+    {
+        if(m_nodes.empty())
+            return;
+        std::vector<uint64_t> stack{ m_nodes.size() - 1 };
+        while(!stack.empty())
+        {
+            const node& n = m_nodes[stack.back()];
+            stack.pop_back();
+            if(!n.env.Intersects(env))
+                continue;
+            for(uint64_t k = n.first; k < n.first + n.count; k++){
+                if(!n.leaf)
+                    stack.push_back(k);
+                else if(m_items[m_ids[k]].Intersects(env))
+                    func(m_ids[k]);
+            }
+        }
+    }
+
+    /// @brief 两棵树的外接矩形连接: 对外接矩形相交的每一对元素调用func(id_a, id_b), 同时遍历两棵树, 不相交的子树整体跳过
+    template<typename _Func>
+    friend void envelope_join(const envelope_rtree& a, const envelope_rtree& b, _Func&& func)
+    {
+        if(a.m_nodes.empty() || b.m_nodes.empty())
+            return;
+        std::vector<std::pair<uint64_t, uint64_t>> stack{ {a.m_nodes.size() - 1, b.m_nodes.size() - 1} };
+        while(!stack.empty())
+        {
+            auto [ia, ib] = stack.back();
+            stack.pop_back();
+            const node& na = a.m_nodes[ia];
+            const node& nb = b.m_nodes[ib];
+            if(!na.env.Intersects(nb.env))
+                continue;
+
+            if(na.leaf && nb.leaf){
+                for(size_t i = na.first; i < na.first + na.count; i++){
+                    const OGREnvelope& ea = a.m_items[a.m_ids[i]];
+                    if(!ea.Intersects(nb.env))
+                        continue;
+                    for(size_t j = nb.first; j < nb.first + nb.count; j++){
+                        if(ea.Intersects(b.m_items[b.m_ids[j]]))
+                            func(a.m_ids[i], b.m_ids[j]);
+                    }
+                }
+            }
+            /// 展开面积较大(或非叶子)的一侧
+            else if(nb.leaf || (!na.leaf && area(na.env) >= area(nb.env))){
+                for(size_t k = na.first; k < na.first + na.count; k++)
+                    stack.push_back({k, ib});
+            }
+            else{
+                for(size_t k = nb.first; k < nb.first + nb.count; k++)
+                    stack.push_back({ia, k});
+            }
+        }
+    }
+
+private:
+    static double area(const OGREnvelope& env) { return (env.MaxX - env.MinX) * (env.MaxY - env.MinY); }
+
+    /// @brief STR排序: 按中心x分为sqrt(P)个竖条, 条内按中心y排序, 之后每m_capacity个连续元素组成一个节点
+    template<typename _Ty, typename _Env>
+    void str_sort(std::vector<_Ty>& vec, _Env&& env_of) const
+    {
+        auto cx = [&](const _Ty& v){ const OGREnvelope& e = env_of(v); return e.MinX + e.MaxX; };
+        auto cy = [&](const _Ty& v){ const OGREnvelope& e = env_of(v); return e.MinY + e.MaxY; };
+        size_t pages = (vec.size() + m_capacity - 1) / m_capacity;
+        size_t slice = size_t(std::ceil(std::sqrt(double(pages)))) * m_capacity;
+        std::sort(vec.begin(), vec.end(), [&](const _Ty& l, const _Ty& r){ return cx(l) < cx(r); });
+        for(size_t s = 0; s < vec.size(); s += slice)
+            std::sort(vec.begin() + s, vec.begin() + std::min(vec.size(), s + slice), [&](const _Ty& l, const _Ty& r){ return cy(l) < cy(r); });
+    }
+
+    /// @brief 由连续的[first, first+count)个外接矩形生成父节点
+    template<typename _Env>
+    node make_node(uint64_t first, uint64_t count, bool leaf, _Env&& env_of) const
+    {
+        node n{ env_of(first), first, count, leaf };
+        for(uint64_t k = first + 1; k < first + count; k++)
+            n.env.Merge(env_of(k));
+        return n;
+    }
+
+    void build()
+    {
+        if(m_items.empty())
+            return;
+
+        m_ids.resize(m_items.size());
+        std::iota(m_ids.begin(), m_ids.end(), uint64_t(0));
+        str_sort(m_ids, [&](uint64_t id) -> const OGREnvelope& { return m_items[id]; });
+
+        std::vector<node> level;
+        for(size_t k = 0; k < m_ids.size(); k += m_capacity)
+            level.push_back(make_node(k, std::min(size_t(m_capacity), m_ids.size() - k), true,
+                [&](size_t i) -> const OGREnvelope& { return m_items[m_ids[i]]; }));
+
+        /// 逐层向上构建, 每层排序后追加到m_nodes, 父节点引用其中连续的一段
+        while(level.size() > 1)
+        {
+            str_sort(level, [](const node& n) -> const OGREnvelope& { return n.env; });
+            size_t base = m_nodes.size();
+            m_nodes.insert(m_nodes.end(), level.begin(), level.end());
+            std::vector<node> parents;
+            for(size_t k = 0; k < level.size(); k += m_capacity)
+                parents.push_back(make_node(base + k, std::min(size_t(m_capacity), level.size() - k), false,
+                    [&](size_t i) -> const OGREnvelope& { return m_nodes[i].env; }));
+            level.swap(parents);
+        }
+        m_nodes.push_back(level[0]);
+    }
+
+    std::vector<OGREnvelope> m_items;
+    std::vector<uint64_t> m_ids;
+    std::vector<node> m_nodes;
+    int m_capacity{ 16 };
+};
+
+#endif // ENVELOPE_RTREE_H
@@ -0,0 +1,96 @@
+#include "fft_plan_cache.h"
+
+#include <filesystem>
+#include <fmt/format.h>
+
+fft_plan_cache& fft_plan_cache::instance()
+{
+	static fft_plan_cache cache;
+	return cache;
+}
+
+fft_plan_cache::~fft_plan_cache()
+{
+	clear();
+}
+
+funcrst fft_plan_cache::set_planning(std::string method)
+{
+	if(method == "estimate")
+		m_flag = FFTW_ESTIMATE;
+	else if(method == "measure")
+		m_flag = FFTW_MEASURE;
+	else if(method == "patient")
+		m_flag = FFTW_PATIENT;
+	else
+		return funcrst(false, fmt::format("fft_plan_cache::set_planning, unknown method '{}'.", method));
+	return funcrst(true, "fft_plan_cache::set_planning finished.");
+}
+
+funcrst fft_plan_cache::load_wisdom(std::string wisdom_path)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if(!std::filesystem::exists(wisdom_path))
+		return funcrst(false, fmt::format("fft_plan_cache::load_wisdom, '{}' is not existed.", wisdom_path));
+
+	if(fftwf_import_wisdom_from_filename(wisdom_path.c_str()) == 0)
+		return funcrst(false, fmt::format("fft_plan_cache::load_wisdom, import '{}' failed.", wisdom_path));
+
+	return funcrst(true, "fft_plan_cache::load_wisdom finished.");
+}
+
+funcrst fft_plan_cache::save_wisdom(std::string wisdom_path)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if(fftwf_export_wisdom_to_filename(wisdom_path.c_str()) == 0)
+		return funcrst(false, fmt::format("fft_plan_cache::save_wisdom, export '{}' failed.", wisdom_path));
+
+	return funcrst(true, "fft_plan_cache::save_wisdom finished.");
+}
+
+void fft_plan_cache::prepare(int size, int threads)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for(int i = 0; i < threads; i++){
+		if(m_blocks.find({size, i}) == m_blocks.end())
+			create(size, i);
+	}
+}
+
+fft_block& fft_plan_cache::get(int size, int thread_idx)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto iter = m_blocks.find({size, thread_idx});
+	if(iter != m_blocks.end())
+		return iter->second;
+	return create(size, thread_idx);
+}
+
+fft_block& fft_plan_cache::create(int size, int thread_idx)
+{
+	/// 调用者已持有m_mutex
+	fft_block& block = m_blocks[{size, thread_idx}];
+	block.size = size;
+	block.spatial = fftwf_alloc_complex(size * size);
+	block.frequency = fftwf_alloc_complex(size * size);
+	block.amplitude = fftwf_alloc_real(size * size);
+	block.buffer = fftwf_alloc_real(size * size);
+	/// measure/patient 会改写数组内容, 所以plan必须在填充数据之前创建
+	block.forward = fftwf_plan_dft_2d(size, size, block.spatial, block.frequency, FFTW_FORWARD, m_flag);
+	block.backward = fftwf_plan_dft_2d(size, size, block.frequency, block.spatial, FFTW_BACKWARD, m_flag);
+	return block;
+}
+
+void fft_plan_cache::clear()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for(auto& iter : m_blocks){
+		fftwf_destroy_plan(iter.second.forward);
+		fftwf_destroy_plan(iter.second.backward);
+		fftwf_free(iter.second.spatial);
+		fftwf_free(iter.second.frequency);
+		fftwf_free(iter.second.amplitude);
+		fftwf_free(iter.second.buffer);
+	}
+	m_blocks.clear();
+}
@@ -0,0 +1,64 @@
+#ifndef FFT_PLAN_CACHE_H
+#define FFT_PLAN_CACHE_H
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include <fftw3.h>
+
+#include "datatype.h"
+
+/// @brief 单个线程使用的size*size二维fft工作区, spatial与frequency分别为正变换的输入和输出
+/// amplitude与buffer是block内频谱幅值与平滑用的临时数组, 与plan一同创建, 逐block处理时不再申请内存
+struct fft_block
+{
+	int size{ 0 };
+	fftwf_complex* spatial{ nullptr };
+	fftwf_complex* frequency{ nullptr };
+	fftwf_plan forward{ nullptr };
+	fftwf_plan backward{ nullptr };
+	float* amplitude{ nullptr };
+	float* buffer{ nullptr };
+};
+
+/// @brief goldstein系列滤波共用的fftw plan缓存, 以(block size, 线程号)为键, 整个进程内只创建一次
+/// fftw的planner不是线程安全的, 所以plan的创建与wisdom的读写都在互斥锁内完成, 
+/// 建议在并行区之前调用prepare, 并行区内每个线程只需通过get取回自己的工作区
+class fft_plan_cache
+{
+public:
+	static fft_plan_cache& instance();
+
+	/// @brief 设置plan的规划方式, estimate(默认), measure, patient, 对已创建的plan无效
+	funcrst set_planning(std::string method);
+	unsigned planning() const { return m_flag; }
+
+	/// @brief 读取/保存fftw wisdom文件, 读取wisdom后以相同参数创建plan几乎没有耗时
+	funcrst load_wisdom(std::string wisdom_path);
+	funcrst save_wisdom(std::string wisdom_path);
+
+	/// @brief 为size大小的block预先创建threads个工作区
+	void prepare(int size, int threads);
+
+	/// @brief 返回(size, thread_idx)对应的工作区, 不存在时创建
+	fft_block& get(int size, int thread_idx);
+
+	/// @brief 销毁所有plan与工作区
+	void clear();
+
+private:
+	fft_plan_cache() {}
+	~fft_plan_cache();
+	fft_plan_cache(const fft_plan_cache&) = delete;
+	fft_plan_cache& operator=(const fft_plan_cache&) = delete;
+
+	fft_block& create(int size, int thread_idx);
+
+	std::map<std::pair<int, int>, fft_block> m_blocks;
+	std::mutex m_mutex;
+	unsigned m_flag{ FFTW_ESTIMATE };
+};
+
+#endif // FFT_PLAN_CACHE_H
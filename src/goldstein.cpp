@@ -1,6 +1,5 @@
 #include "insar_include.h"
 
-funcrst goldstein(std::complex<float>* arr_in, int height, int width, float alpha, std::complex<float>* arr_out);
 funcrst goldstein_single(std::complex<float>* arr_in, int height, int width, float alpha, std::complex<float>* arr_out);
 
 /*
@@ -17,6 +16,34 @@ funcrst goldstein_single(std::complex<float>* arr_in, int height, int width, flo
             .help("the power of window, within range [0,1], , default is 0.5. The higher the power, the more pronounced the filtering effect.")
             .scan<'g',double>()
             .default_value("0.5");   
+
+        sub_goldstein.add_argument("-s","--strip")
+            .help("rows of each strip in streaming mode, which will be rounded up to a multiple of step (block - overlap), default is 512.")
+            .scan<'i',int>()
+            .default_value("512");
+
+        sub_goldstein.add_argument("-b","--block")
+            .help("block size of fft, within range [8,1024], default is 32.")
+            .scan<'i',int>()
+            .default_value("32");
+
+        sub_goldstein.add_argument("-o","--overlap")
+            .help("overlap between adjacent blocks, within range [0,block), default is 24. larger step (block - overlap) needs fewer fft, e.g. 64/16 needs about 6x fewer fft than 32/24.")
+            .scan<'i',int>()
+            .default_value("24");
+
+        sub_goldstein.add_argument("-t","--taper")
+            .help("how blocks are stitched: crop (keep the center of block), triangle or hann (weighted overlap-add), default is crop.")
+            .choices("crop","triangle","hann")
+            .default_value("crop");
+
+        sub_goldstein.add_argument("--fft_plan")
+            .help("fftw planning method: estimate, measure or patient, default is estimate. measure and patient take longer to plan but run faster, recommended with --wisdom.")
+            .choices("estimate","measure","patient")
+            .default_value("estimate");
+
+        sub_goldstein.add_argument("--wisdom")
+            .help("fftw wisdom filepath, loaded before filtering (if existed) and saved after filtering.");
     }
 */
 
@@ -31,6 +58,8 @@ int filter_goldstein(argparse::ArgumentParser* args, std::shared_ptr<spdlog::log
 		alpha = 0.5;
 	}
 
+	goldstein_params par = goldstein_args(args, logger);
+
 	GDALAllRegister();
     CPLSetConfigOption("GDAL_FILENAME_IS_UTF8", "NO");
 
@@ -45,254 +74,120 @@ int filter_goldstein(argparse::ArgumentParser* args, std::shared_ptr<spdlog::log
     GDALDataType datatype = rb->GetRasterDataType();
 
 	if(datatype != GDT_CFloat32 && datatype != GDT_Float32){
+		GDALClose(ds);
 		PRINT_LOGGER(logger, error, "datatype is diff with float or fcomplex.");
 		return -2;
 	}
 
-	std::complex<float>* arr = new std::complex<float>[width * height];
-	if(datatype == GDT_CFloat32){
-		rb->RasterIO(GF_Read, 0, 0, width, height, arr, width, height, datatype, 0, 0);
-	}
-	else{
-		/// datatype == GDT_Float32
-		float* arr_flt = new float[width * height];	/// 直接全申请, 更省事, 并且如果这里都申请不下来的话, 后面的arr_out肯定更不行
-		rb->RasterIO(GF_Read, 0, 0, width, height, arr_flt, width, height, datatype, 0, 0);
-		for(int i=0; i<width * height;i++){
-			arr[i].real(cos(arr_flt[i]));
-			arr[i].imag(sin(arr_flt[i]));
-		}
-		delete[] arr_flt;
-	}
-	std::complex<float>* arr_out = new std::complex<float>[width * height];
-	
-	PRINT_LOGGER(logger, info, "Preparation completed, start filtering with goldstein.");
-
-	funcrst rst = goldstein(arr, height, width, alpha, arr_out);
-	if(!rst){
-		PRINT_LOGGER(logger, error, fmt::format("goldstein failed. ({})", rst.explain));
-		return -3;
-	}
-
-    delete[] arr;
-	GDALClose(ds);
-
 	GDALDriver* dv = GetGDALDriverManager()->GetDriverByName("GTiff");
     GDALDataset* ds_out = dv->Create(output_path.c_str(), width, height, 1, datatype, NULL);
     if(!ds_out){
-		delete[] arr_out;
+		GDALClose(ds);
         PRINT_LOGGER(logger, error, "ds_out is nullptr.");
 		return -3;
     }
     GDALRasterBand* rb_out = ds_out->GetRasterBand(1);
-	if(datatype == GDT_CFloat32){
-		rb_out->RasterIO(GF_Write, 0, 0, width, height, arr_out, width, height, datatype, 0, 0);
-	}
-	else{
-		/// datatype == GDT_Float32
-		float* arr_flt = new float[width * height];	/// 直接全申请, 更省事, 并且如果这里都申请不下来的话, 后面的arr_out肯定更不行
-		for(int i=0; i<width * height;i++){
-			arr_flt[i] = atan2(arr[i].imag(), arr[i].real());
-		}
-		rb_out->RasterIO(GF_Write, 0, 0, width, height, arr_flt, width, height, datatype, 0, 0);
-		delete[] arr_flt;
-	}
-	delete[] arr_out;
+
+	fft_plan_init(args, logger, par.size);
+
+	PRINT_LOGGER(logger, info, "Preparation completed, start filtering with goldstein.");
+
+	float alpha_f = float(alpha);
+	funcrst rst = goldstein_filter(rb, rb_out, par, [alpha_f](const goldstein_block_info&){ return alpha_f; });
+
+	GDALClose(ds);
 	GDALClose(ds_out);
 
+	if(!rst){
+		PRINT_LOGGER(logger, error, fmt::format("goldstein failed. ({})", rst.explain));
+		return -3;
+	}
+
+	fft_plan_finish(args, logger);
+
 	PRINT_LOGGER(logger, info, "filter_goldstein finished.");
 	return 1;
 }
 
-funcrst conv_2d(float* arr_in, int width, int height, float* arr_out, float* kernel, int size)
+goldstein_params goldstein_args(argparse::ArgumentParser* args, std::shared_ptr<spdlog::logger> logger)
 {
-	if(arr_in == nullptr)
-		return funcrst(false, "filter::conv_2d, arr_in is nullptr.");
-	
-	if(dynamic_array_size(arr_in) != width * height)
-		return funcrst(false, fmt::format("filter::conv_2d, arr_in.size({}) is diff with width*height({}).",dynamic_array_size(arr_in),width * height));
-	
-	if(kernel == nullptr)
-		return funcrst(false, "filter::conv_2d, kernel is nullptr.");
-
-	if(dynamic_array_size(kernel) != size * size)
-		return funcrst(false, fmt::format("filter::conv_2d, kernel.size({}) is diff with size^2({}).",dynamic_array_size(kernel),size*size));
-
-	float* kernel_overturn = new float[size*size];
-	for(int i=0; i<size*size; i++)
-		kernel_overturn[i] = kernel[size*size-1-i];
+	goldstein_params par;
+	int size = args->get<int>("--block");
+	int overlap = args->get<int>("--overlap");
+	int strip_height = args->get<int>("--strip");
+	std::string taper = args->get<string>("--taper");
+
+	if(size < 8 || size > 1024){
+		PRINT_LOGGER(logger, warn, fmt::format("block input is a invalid data ({}) which has been replaced by default ({})",size, par.size));
+		size = par.size;
+	}
+	par.size = size;
 
-	if(arr_out == nullptr){
-		arr_out = new float[height * width];
+	if(overlap < 0 || overlap >= size){
+		PRINT_LOGGER(logger, warn, fmt::format("overlap input is a invalid data ({}) which has been replaced by block * 3 / 4 ({})",overlap, size * 3 / 4));
+		overlap = size * 3 / 4;
 	}
-	else if(dynamic_array_size(arr_out) != height * width){
-		delete[] arr_out;
-		arr_out = new float[height * width];
+	par.overlap = overlap;
+
+	if(strip_height < 1){
+		PRINT_LOGGER(logger, warn, fmt::format("strip input is a invalid data ({}) which has been replaced by default ({})",strip_height, par.strip));
+		strip_height = par.strip;
 	}
+	par.strip = strip_height;
 
-	for(int i = 0; i < height; i++){
-		for(int j = 0; j < width; j++){
-			/// 这种重复计算的方式肯定会多耗费一些时间, 如果使用同行向右滑动, 逐列增减数据的方式, 可以大大减少耗时
-			float sum = 0;
-			for(int m = 0; m< size; m++){
-				for(int n = 0; n< size; n++){
-					if(i-size/2+m < 0 || i-size/2+m > height-1 || j-size/2+n < 0 || j-size/2+n > width-1)
-						continue;/// 超界
-					sum +=  kernel_overturn[m*size+n] * arr_in[(i-size/2+m)*width+(j-size/2+n)];
-				}
-			}
-			arr_out[i*width+j]=sum;
-		}
+	funcrst rst = goldstein_taper_from_string(taper, par.taper);
+	if(!rst){
+		PRINT_LOGGER(logger, warn, fmt::format("{}, taper has been replaced by 'crop'.", rst.explain));
+		par.taper = goldstein_taper::crop;
 	}
 
-	delete[] kernel_overturn;
-	return funcrst(true, "filter::conv_2d finished.");
+	PRINT_LOGGER(logger, info, fmt::format("goldstein block: {}, overlap: {}, step: {}, strip: {}, taper: {}.", par.size, par.overlap, par.step(), par.strip, goldstein_taper_name(par.taper)));
+	return par;
 }
 
-
-funcrst goldstein(std::complex<float>* arr_in, int height, int width, float alpha, std::complex<float>* arr_out)
+void fft_plan_init(argparse::ArgumentParser* args, std::shared_ptr<spdlog::logger> logger, int size)
 {
+	fft_plan_cache& cache = fft_plan_cache::instance();
 
-    auto start_time = std::chrono::system_clock::now();
-
-	int size = 32;
-	int overlap = 24;
-	int step = size - overlap;
-
-	if(arr_out == nullptr){
-		arr_out = new std::complex<float>[height * width];
-	}
-	else if(dynamic_array_size(arr_out) != height * width){
-		delete[] arr_out;
-		arr_out = new std::complex<float>[height * width];
+	std::string method = args->get<string>("--fft_plan");
+	funcrst rst = cache.set_planning(method);
+	if(!rst){
+		PRINT_LOGGER(logger, warn, fmt::format("{}, fftw planning method has been replaced by 'estimate'.", rst.explain));
+		cache.set_planning("estimate");
 	}
 
-	int max_threads = omp_get_max_threads();
-
-	fftwf_complex** spatial_arrs =  new fftwf_complex*[max_threads];
-	fftwf_complex** frequency_arrs =  new fftwf_complex*[max_threads];
-	fftwf_plan* forward_plans = new fftwf_plan[max_threads];
-	fftwf_plan* backward_plans = new fftwf_plan[max_threads];
-	for(int i=0; i < max_threads; i++){
-		spatial_arrs[i] = fftwf_alloc_complex(size*size);
-		frequency_arrs[i] = fftwf_alloc_complex(size*size);
-		forward_plans[i] = fftwf_plan_dft_2d(size, size, spatial_arrs[i], frequency_arrs[i], FFTW_FORWARD, FFTW_ESTIMATE);
-		backward_plans[i] = fftwf_plan_dft_2d(size, size, frequency_arrs[i], spatial_arrs[i], FFTW_BACKWARD, FFTW_ESTIMATE);
-	}
-	
-#pragma omp parallel for
-	for(int i=0; i < height; i+=step)
-	{
-		/// out_i_start, out_i_end, 控制block数组内需要赋值到arr_out的行数, 保证输出数据没有"黑框"
-		int out_i_start, out_i_end;
-		if(i == 0){
-			out_i_start = 0; out_i_end = size - overlap / 2 - 1;
-		}
-		else if(i + step - 1 > height - 1){
-			out_i_start = overlap / 2; out_i_end = height - 1 - i;
+	if(args->is_used("--wisdom")){
+		std::string wisdom_path = args->get<string>("--wisdom");
+		rst = cache.load_wisdom(wisdom_path);
+		if(rst){
+			PRINT_LOGGER(logger, info, fmt::format("fftw wisdom loaded from '{}'.", wisdom_path));
 		}
 		else{
-			out_i_start = overlap / 2; out_i_end = size - overlap / 2 - 1;
+			PRINT_LOGGER(logger, warn, rst.explain);
 		}
-		
-		int thread_idx = omp_get_thread_num();
-
-
-		for(int j=0; j < width; j+=step)
-		{
-			/// out_j_start, out_j_end, 控制block数组内需要赋值到arr_out的列数, 保证输出数据没有"黑框"
-			int out_j_start, out_j_end;
-			if(j == 0){
-				out_j_start = 0; out_j_end = size - overlap / 2 - 1;
-			}
-			else if(j + step - 1 > width - 1){
-				out_j_start = overlap / 2; out_j_end = width - 1 - j;
-			}
-			else{
-				out_j_start = overlap / 2; out_j_end = size - overlap / 2 - 1;
-			}
-
-			/// spatial_arr init
-			for(int k = 0; k< size*size; k++){
-				int block_i = k / size + i;
-				int block_j = k % size + j;
-				if(block_j > width - 1 || block_i > height - 1){
-					/// 说明超界, 需要补零
-					spatial_arrs[thread_idx][k][0]=0;
-					spatial_arrs[thread_idx][k][1]=0;
-				}
-				else{
-					spatial_arrs[thread_idx][k][0]=arr_in[block_i * width + block_j].real();
-					spatial_arrs[thread_idx][k][1]=arr_in[block_i * width + block_j].imag();
-				}
-			}
-
-			///  fft
-			fftwf_execute(forward_plans[thread_idx]);
-
-
-			/// abs
-			float* block_abs = new float[size*size];
-			for(int k=0; k<size*size; k++){
-				block_abs[k] = sqrtf(powf(frequency_arrs[thread_idx][k][0],2) + powf(frequency_arrs[thread_idx][k][1],2));
-			}
-
-			/// smooth
-			float* smooth_spatial = new float[25];
-			for(int k = 0; k<25; k++)
-				smooth_spatial[k] = 0.04;
-			float* block_smooth = new float[size*size];
-			// conv_2d(block_abs, size, size, block_smooth, smooth_frequency, 5);
-            auto rst = conv_2d(block_abs, size, size, block_smooth, smooth_spatial, 5);
-
-			delete[] block_abs;
-			delete[] smooth_spatial;
-
-
-			/// block_smooth^alpha * spatial_arrs -> frequency_arrs
-			for(int k=0; k< size*size; k++){
-				// frequency_arrs[thread_idx][k][0] = block_smooth[k] * alpha * frequency_arrs[thread_idx][k][0];
-				// frequency_arrs[thread_idx][k][1] = block_smooth[k] * alpha * frequency_arrs[thread_idx][k][1];
-				frequency_arrs[thread_idx][k][0] = pow(block_smooth[k],alpha) * frequency_arrs[thread_idx][k][0];
-				frequency_arrs[thread_idx][k][1] = pow(block_smooth[k],alpha) * frequency_arrs[thread_idx][k][1];
-			}
-
-			delete[] block_smooth;
-
-
-			/// ifft
-			fftwf_execute(backward_plans[thread_idx]);
-
+	}
 
-			/// 赋值
-			for(int m = out_i_start; m <= out_i_end; m++){
-				for(int n = out_j_start; n <= out_j_end; n++){
-                    if(i + m < 0 || i + m > height - 1 || j + n < 0 || j + n > width - 1)
-                        continue;
-					arr_out[(i+m)*width+(j+n)].real(spatial_arrs[thread_idx][m*size+n][0] / size / size);
-					arr_out[(i+m)*width+(j+n)].imag(spatial_arrs[thread_idx][m*size+n][1] / size / size);
-				}
-			}
+	auto start_time = std::chrono::system_clock::now();
+	cache.prepare(size, omp_get_max_threads());
+	PRINT_LOGGER(logger, info, fmt::format("fftw plans ({}x{}, {} threads, {}) prepared, spend time {}s.", size, size, omp_get_max_threads(), method, spend_time(start_time)));
+	PRINT_LOGGER(logger, info, fmt::format("spectral weighting kernel: {}.", simd_level_name(spectral_simd_level())));
+}
 
+void fft_plan_finish(argparse::ArgumentParser* args, std::shared_ptr<spdlog::logger> logger)
+{
+	if(!args->is_used("--wisdom"))
+		return;
 
-		}
-		
+	std::string wisdom_path = args->get<string>("--wisdom");
+	funcrst rst = fft_plan_cache::instance().save_wisdom(wisdom_path);
+	if(rst){
+		PRINT_LOGGER(logger, info, fmt::format("fftw wisdom saved to '{}'.", wisdom_path));
 	}
-
-	for(int i=0; i< max_threads; i++){
-		fftwf_destroy_plan(forward_plans[i]);
-		fftwf_destroy_plan(backward_plans[i]);
-		fftwf_free(spatial_arrs[i]);
-		fftwf_free(frequency_arrs[i]);
+	else{
+		PRINT_LOGGER(logger, warn, rst.explain);
 	}
-	
-
-    double spend_sec = spend_time(start_time);
-    cout<<"glodstein_single spend_time: "<<spend_sec<<endl;
-
-	return funcrst(true, "filter::goldstein finished.");
 }
 
-
 funcrst goldstein_single(std::complex<float>* arr_in, int height, int width, float alpha, std::complex<float>* arr_out)
 {
     auto start_time = std::chrono::system_clock::now();
@@ -301,11 +196,9 @@ funcrst goldstein_single(std::complex<float>* arr_in, int height, int width, flo
 	int overlap = 24;
 	int step = size - overlap;
 
-	/// 避免多线程时多线程同时调用一个plan出现异常
-    fftwf_complex* spatial_arr =  fftwf_alloc_complex(size*size);
-	fftwf_complex* frequency_arr = fftwf_alloc_complex(size*size);
-	fftwf_plan forward  = fftwf_plan_dft_2d(size, size, spatial_arr, frequency_arr, FFTW_FORWARD, FFTW_ESTIMATE);
-	fftwf_plan backward = fftwf_plan_dft_2d(size, size, frequency_arr, spatial_arr, FFTW_BACKWARD, FFTW_ESTIMATE);
+	/// 单线程版本, 只使用0号线程的工作区
+	fft_block& fft = fft_plan_cache::instance().get(size, 0);
+	fftwf_complex* spatial_arr = fft.spatial;
 
 	if(arr_out == nullptr){
 		arr_out = new std::complex<float>[height * width];
@@ -339,21 +232,6 @@ funcrst goldstein_single(std::complex<float>* arr_in, int height, int width, flo
         cout<<endl;
     };
 
-	/// smooth
-	float* smooth_spatial = new float[25];
-	float* smooth_frequency = new float[25];
-	for(int i=0;i<25;i++)
-        smooth_spatial[i] = 0.04;
-	// fftwf_plan smooth_fft_plan = fftwf_plan_r2r_2d( 5, 5, smooth_spatial, smooth_frequency, FFTW_R2HC, FFTW_R2HC, FFTW_MEASURE);
-	// fftwf_execute(smooth_fft_plan);
-	// fftwf_destroy_plan(smooth_fft_plan);
-	// delete[] smooth_spatial;
-
-#ifdef DEBUG
-    print_flt_arr(smooth_spatial, 25);
-    print_flt_arr(smooth_frequency, 25);
-#endif
-
 	for(int i=0; i < height; i+=step)
 	{
 		/// out_i_start, out_i_end, 控制block数组内需要赋值到arr_out的行数, 保证输出数据没有"黑框"
@@ -368,7 +246,6 @@ funcrst goldstein_single(std::complex<float>* arr_in, int height, int width, flo
 			out_i_start = overlap / 2; out_i_end = size - overlap / 2 - 1;
 		}
 		
-		int thread_idx = omp_get_thread_num();
 		for(int j=0; j < width; j+=step)
 		{
 			/// out_j_start, out_j_end, 控制block数组内需要赋值到arr_out的列数, 保证输出数据没有"黑框"
@@ -399,34 +276,15 @@ funcrst goldstein_single(std::complex<float>* arr_in, int height, int width, flo
 			}
 
 			///  fft
-			fftwf_execute(forward);
-
-
-			/// abs
-			float* block_abs = new float[size*size];
-			for(int k=0; k<size*size; k++){
-				block_abs[k] = sqrtf(powf(frequency_arr[k][0],2) + powf(frequency_arr[k][1],2));
-			}
+			fftwf_execute(fft.forward);
 
-			/// smooth
-			float* block_smooth = new float[size*size];
-			// conv_2d(block_abs, size, size, block_smooth, smooth_frequency, 5);
-            auto rst = conv_2d(block_abs, size, size, block_smooth, smooth_spatial, 5);
 
-			delete[] block_abs;
-
-
-			/// block_smooth^alpha * spatial_arrs -> frequency_arrs
-			for(int k=0; k< size*size; k++){
-				// frequency_arr[k][0] = block_smooth[k] * alpha * frequency_arr[k][0];
-				// frequency_arr[k][1] = block_smooth[k] * alpha * frequency_arr[k][1];
-				frequency_arr[k][0] = pow(block_smooth[k],alpha) * frequency_arr[k][0];
-				frequency_arr[k][1] = pow(block_smooth[k],alpha) * frequency_arr[k][1];
-			}
+			/// abs -> smooth -> smooth^alpha * frequency
+			goldstein_block_weight(fft, alpha);
 
 
 			/// ifft
-			fftwf_execute(backward);
+			fftwf_execute(fft.backward);
 
 
 			/// 赋值
@@ -444,11 +302,6 @@ funcrst goldstein_single(std::complex<float>* arr_in, int height, int width, flo
 	}
 
 
-    fftwf_destroy_plan(forward);
-    fftwf_destroy_plan(backward);
-    fftwf_free(spatial_arr);
-    fftwf_free(frequency_arr);
-
     double spend_sec = spend_time(start_time);
     cout<<"glodstein_single spend_time: "<<spend_sec<<endl;
 
@@ -1,6 +1,7 @@
 #include "insar_include.h"
 
-funcrst baran(std::complex<float>* arr_in, float* cor, int height, int width, std::complex<float>* arr_out, float* arr_alpha_out, bool write_alpha);
+/// @brief baran方法的alpha: 1 - block内未超界部分的平均相干系数
+float baran_alpha(const goldstein_block_info& info);
 
 /*
     argparse::ArgumentParser sub_goldstein_baran("baran");
@@ -17,6 +18,34 @@ funcrst baran(std::complex<float>* arr_in, float* cor, int height, int width, st
 
         sub_goldstein_baran.add_argument("-a","--alpha_outpath")
             .help("optional output the alpha_output_path, with recorded the aplha used with goldstein in every window");   
+
+        sub_goldstein_baran.add_argument("-s","--strip")
+            .help("rows of each strip in streaming mode, which will be rounded up to a multiple of step (block - overlap), default is 512.")
+            .scan<'i',int>()
+            .default_value("512");
+
+        sub_goldstein_baran.add_argument("-b","--block")
+            .help("block size of fft, within range [8,1024], default is 32.")
+            .scan<'i',int>()
+            .default_value("32");
+
+        sub_goldstein_baran.add_argument("-o","--overlap")
+            .help("overlap between adjacent blocks, within range [0,block), default is 24. larger step (block - overlap) needs fewer fft, e.g. 64/16 needs about 6x fewer fft than 32/24.")
+            .scan<'i',int>()
+            .default_value("24");
+
+        sub_goldstein_baran.add_argument("-t","--taper")
+            .help("how blocks are stitched: crop (keep the center of block), triangle or hann (weighted overlap-add), default is crop.")
+            .choices("crop","triangle","hann")
+            .default_value("crop");
+
+        sub_goldstein_baran.add_argument("--fft_plan")
+            .help("fftw planning method: estimate, measure or patient, default is estimate. measure and patient take longer to plan but run faster, recommended with --wisdom.")
+            .choices("estimate","measure","patient")
+            .default_value("estimate");
+
+        sub_goldstein_baran.add_argument("--wisdom")
+            .help("fftw wisdom filepath, loaded before filtering (if existed) and saved after filtering.");
     }
 */
 
@@ -27,11 +56,13 @@ int filter_goldstein_baran(argparse::ArgumentParser* args, std::shared_ptr<spdlo
 	std::string output_path = args->get<string>("output_path");
 	std::string alpha_out_path;
 	bool write_alpha = false;
-	if(args->is_used("alpha_outpath")){
-		alpha_out_path = args->get<string>("alpha_outpath");
+	if(args->is_used("--alpha_outpath")){
+		alpha_out_path = args->get<string>("--alpha_outpath");
 		write_alpha = true;
 	}
 
+	goldstein_params par = goldstein_args(args, logger);
+
 	GDALAllRegister();
     CPLSetConfigOption("GDAL_FILENAME_IS_UTF8", "NO");
 
@@ -45,13 +76,15 @@ int filter_goldstein_baran(argparse::ArgumentParser* args, std::shared_ptr<spdlo
     GDALRasterBand* rb = ds->GetRasterBand(1);
     GDALDataType datatype = rb->GetRasterDataType();
 
-	if(datatype != GDT_CFloat32){
-		PRINT_LOGGER(logger, error, "ds.datatype is not fcomplex.");
+	if(datatype != GDT_CFloat32 && datatype != GDT_Float32){
+		GDALClose(ds);
+		PRINT_LOGGER(logger, error, "ds.datatype is diff with float or fcomplex.");
 		return -1;
 	}
 	
 	GDALDataset* ds_cor = (GDALDataset*)GDALOpen(cor_path.c_str(), GA_ReadOnly);
 	if(!ds_cor){
+		GDALClose(ds);
 		PRINT_LOGGER(logger, error, "ds_cor is nullptr");
 		return -2;
 	}
@@ -79,63 +112,67 @@ int filter_goldstein_baran(argparse::ArgumentParser* args, std::shared_ptr<spdlo
 		}
 	}
 	
-	float* arr_cor = new float[width * height];
-	rb_cor->RasterIO(GF_Read, 0, 0, width, height, arr_cor, width, height, GDT_Float32, 0, 0);
-	GDALClose(ds_cor);
-
-	std::complex<float>* arr = new std::complex<float>[width * height];
-	rb->RasterIO(GF_Read, 0, 0, width, height, arr, width, height, datatype, 0, 0);
-
-	std::complex<float>* arr_out = new std::complex<float>[width * height];
-	float* arr_alpha;
-	if(write_alpha)
-		arr_alpha = new float[width * height];
-
-	PRINT_LOGGER(logger, info, "Preparation completed, start filtering with baran.");
-	
-	funcrst rst = baran(arr, arr_cor, height, width, arr_out, arr_alpha, write_alpha);
-	if(!rst){
-		PRINT_LOGGER(logger, error, fmt::format("goldstein_baran failed. ({})", rst.explain));
-		return -3;
-	}
-
-    delete[] arr;
-	GDALClose(ds);
-
 	GDALDriver* dv = GetGDALDriverManager()->GetDriverByName("GTiff");
     GDALDataset* ds_out = dv->Create(output_path.c_str(), width, height, 1, datatype, NULL);
     if(!ds_out){
-		delete[] arr_out;
-		if(write_alpha) delete[] arr_alpha;
+		GDALClose(ds);
+		GDALClose(ds_cor);
         PRINT_LOGGER(logger, error, "ds_out is nullptr.");
 		return -3;
     }
     GDALRasterBand* rb_out = ds_out->GetRasterBand(1);
-	rb_out->RasterIO(GF_Write, 0, 0, width, height, arr_out, width, height, datatype, 0, 0);
-	delete[] arr_out;
-	GDALClose(ds_out);
-
-	PRINT_LOGGER(logger, info, "filtered data write over.");
 
+	GDALDataset* ds_alpha_out = nullptr;
+	GDALRasterBand* rb_alpha_out = nullptr;
 	if(write_alpha)
 	{
-		GDALDataset* ds_alpha_out = dv->Create(alpha_out_path.c_str(), width, height, 1, GDT_Float32, NULL);
+		ds_alpha_out = dv->Create(alpha_out_path.c_str(), width, height, 1, GDT_Float32, NULL);
 		if(!ds_alpha_out){
-			delete[] arr_alpha;
+			GDALClose(ds);
+			GDALClose(ds_cor);
+			GDALClose(ds_out);
 			PRINT_LOGGER(logger, error, "ds_alpha_out is nullptr.");
 			return -3;
 		}
-		GDALRasterBand* rb_alpha_out = ds_alpha_out->GetRasterBand(1);
-		rb_alpha_out->RasterIO(GF_Write, 0, 0, width, height, arr_alpha, width, height, GDT_Float32, 0, 0);
-		delete[] arr_alpha;
+		rb_alpha_out = ds_alpha_out->GetRasterBand(1);
+	}
+
+	fft_plan_init(args, logger, par.size);
+
+	PRINT_LOGGER(logger, info, "Preparation completed, start filtering with baran.");
+	
+	/// 相干系数与干涉图按相同的条带读取, 通过block_info.aux传给baran_alpha
+	funcrst rst = goldstein_filter(rb, rb_out, par, baran_alpha, rb_cor, rb_alpha_out);
+
+	GDALClose(ds);
+	GDALClose(ds_cor);
+	GDALClose(ds_out);
+	if(write_alpha)
 		GDALClose(ds_alpha_out);
-		PRINT_LOGGER(logger, info, "alpha data write over.");
+
+	if(!rst){
+		PRINT_LOGGER(logger, error, fmt::format("goldstein_baran failed. ({})", rst.explain));
+		return -3;
 	}
+	fft_plan_finish(args, logger);
 
 	PRINT_LOGGER(logger, info, "filter_goldstein_baran finished.");
 	return 1;
 }
 
+float baran_alpha(const goldstein_block_info& info)
+{
+	float alpha = 0;
+	for(int m = 0; m < info.rows; m++)
+		for(int n = 0; n < info.cols; n++)
+			alpha += info.aux[m * info.aux_stride + n];
+	int num = info.rows * info.cols;
+
+	alpha = (num==0 ? 0 : alpha / num);
+	alpha = alpha > 1 ? 1 : (alpha < 0 ? 0 : alpha);
+	return 1 - alpha;
+}
+
 // funcrst conv_2d(float* arr_in, int width, int height, float* arr_out, float* kernel, int size)
 // {
 // 	if(arr_in == nullptr)
@@ -180,161 +217,3 @@ int filter_goldstein_baran(argparse::ArgumentParser* args, std::shared_ptr<spdlo
 // 	delete[] kernel_overturn;
 // 	return funcrst(true, "filter::conv_2d finished.");
 // }
-
-funcrst baran(std::complex<float>* arr_in, float* cor, int height, int width, std::complex<float>* arr_out, float* arr_alpha_out, bool write_alpha)
-{
-	auto start_time = std::chrono::system_clock::now();
-
-	int size = 32;
-	int overlap = 24;
-	int step = size - overlap;
-
-	if(arr_out == nullptr){
-		arr_out = new std::complex<float>[height * width];
-	}
-	else if(dynamic_array_size(arr_out) != height * width){
-		delete[] arr_out;
-		arr_out = new std::complex<float>[height * width];
-	}
-
-	int max_threads = omp_get_max_threads();
-
-	fftwf_complex** spatial_arrs =  new fftwf_complex*[max_threads];
-	fftwf_complex** frequency_arrs =  new fftwf_complex*[max_threads];
-	fftwf_plan* forward_plans = new fftwf_plan[max_threads];
-	fftwf_plan* backward_plans = new fftwf_plan[max_threads];
-	for(int i=0; i < max_threads; i++){
-		spatial_arrs[i] = fftwf_alloc_complex(size*size);
-		frequency_arrs[i] = fftwf_alloc_complex(size*size);
-		forward_plans[i] = fftwf_plan_dft_2d(size, size, spatial_arrs[i], frequency_arrs[i], FFTW_FORWARD, FFTW_ESTIMATE);
-		backward_plans[i] = fftwf_plan_dft_2d(size, size, frequency_arrs[i], spatial_arrs[i], FFTW_BACKWARD, FFTW_ESTIMATE);
-	}
-	
-#pragma omp parallel for
-	for(int i=0; i < height; i+=step)
-	{
-		/// out_i_start, out_i_end, 控制block数组内需要赋值到arr_out的行数, 保证输出数据没有"黑框"
-		int out_i_start, out_i_end;
-		if(i == 0){
-			out_i_start = 0; out_i_end = size - overlap / 2 - 1;
-		}
-		else if(i + step - 1 > height - 1){
-			out_i_start = overlap / 2; out_i_end = height - 1 - i;
-		}
-		else{
-			out_i_start = overlap / 2; out_i_end = size - overlap / 2 - 1;
-		}
-		
-		int thread_idx = omp_get_thread_num();
-
-
-		for(int j=0; j < width; j+=step)
-		{
-			/// out_j_start, out_j_end, 控制block数组内需要赋值到arr_out的列数, 保证输出数据没有"黑框"
-			int out_j_start, out_j_end;
-			if(j == 0){
-				out_j_start = 0; out_j_end = size - overlap / 2 - 1;
-			}
-			else if(j + step - 1 > width - 1){
-				out_j_start = overlap / 2; out_j_end = width - 1 - j;
-			}
-			else{
-				out_j_start = overlap / 2; out_j_end = size - overlap / 2 - 1;
-			}
-
-			/// spatial_arr init & 
-			/// calculate average correlation of overlap area to replace alpha in goldstein
-			int num = 0;
-			float alpha = 0;
-			for(int k = 0; k< size*size; k++){
-				int block_i = k / size + i;
-				int block_j = k % size + j;
-				if(block_j > width - 1 || block_i > height - 1){
-					/// 说明超界, 需要补零
-					spatial_arrs[thread_idx][k][0]=0;
-					spatial_arrs[thread_idx][k][1]=0;
-				}
-				else{
-					spatial_arrs[thread_idx][k][0]=arr_in[block_i * width + block_j].real();
-					spatial_arrs[thread_idx][k][1]=arr_in[block_i * width + block_j].imag();
-					
-					alpha += cor[block_i * width + block_j];
-					num++;
-				}
-			}
-
-			alpha = (num==0 ? 0 : alpha / num);
-			alpha = alpha > 1 ? 1 : (alpha < 0 ? 0 : alpha);
-			alpha = 1 - alpha;
-			for(int m = out_i_start; m <= out_i_end; m++){
-				for(int n = out_j_start; n <= out_j_end; n++){
-                    if(i + m < 0 || i + m > height - 1 || j + n < 0 || j + n > width - 1)
-                        continue;
-					if(write_alpha)
-						arr_alpha_out[(i+m)*width+(j+n)] = alpha;
-				}
-			}
-
-			///  fft
-			fftwf_execute(forward_plans[thread_idx]);
-
-
-			/// abs
-			float* block_abs = new float[size*size];
-			for(int k=0; k<size*size; k++){
-				block_abs[k] = sqrtf(powf(frequency_arrs[thread_idx][k][0],2) + powf(frequency_arrs[thread_idx][k][1],2));
-			}
-
-			/// smooth
-			float* smooth_spatial = new float[25];
-			for(int k = 0; k<25; k++)
-				smooth_spatial[k] = 0.04;
-			float* block_smooth = new float[size*size];
-			// conv_2d(block_abs, size, size, block_smooth, smooth_frequency, 5);
-            auto rst = conv_2d(block_abs, size, size, block_smooth, smooth_spatial, 5);
-
-			delete[] block_abs;
-			delete[] smooth_spatial;
-
-
-			/// block_smooth^alpha * spatial_arrs -> frequency_arrs
-			for(int k=0; k< size*size; k++){
-				frequency_arrs[thread_idx][k][0] = pow(block_smooth[k],alpha) * frequency_arrs[thread_idx][k][0];
-				frequency_arrs[thread_idx][k][1] = pow(block_smooth[k],alpha) * frequency_arrs[thread_idx][k][1];
-			}
-
-			delete[] block_smooth;
-
-
-			/// ifft
-			fftwf_execute(backward_plans[thread_idx]);
-
-
-			/// 赋值
-			for(int m = out_i_start; m <= out_i_end; m++){
-				for(int n = out_j_start; n <= out_j_end; n++){
-                    if(i + m < 0 || i + m > height - 1 || j + n < 0 || j + n > width - 1)
-                        continue;
-					arr_out[(i+m)*width+(j+n)].real(spatial_arrs[thread_idx][m*size+n][0] / size / size);
-					arr_out[(i+m)*width+(j+n)].imag(spatial_arrs[thread_idx][m*size+n][1] / size / size);
-				}
-			}
-
-
-		}
-		
-	}
-
-	for(int i=0; i< max_threads; i++){
-		fftwf_destroy_plan(forward_plans[i]);
-		fftwf_destroy_plan(backward_plans[i]);
-		fftwf_free(spatial_arrs[i]);
-		fftwf_free(frequency_arrs[i]);
-	}
-	
-
-    double spend_sec = spend_time(start_time);
-    cout<<"glodstein_single spend_time: "<<spend_sec<<endl;
-
-	return funcrst(true, "filter::goldstein finished.");
-}
\ No newline at end of file
@@ -0,0 +1,25 @@
+#ifndef GOLDSTEIN_BLOCK_H
+#define GOLDSTEIN_BLOCK_H
+
+#include "fft_plan_cache.h"
+#include "smoothing.h"
+#include "spectral_weight.h"
+
+/// @brief goldstein频域加权: 对fft.frequency求幅值, 5*5均值平滑后取alpha次幂, 再乘回fft.frequency
+/// 只使用fft_block中预先申请的临时数组, 不涉及任何内存申请; 幅值与幂次使用spectral_weight中的向量化内核
+inline void goldstein_block_weight(fft_block& fft, float alpha)
+{
+	int size = fft.size;
+	fftwf_complex* frequency = fft.frequency;
+
+	/// abs
+	spectral_amplitude(frequency, fft.amplitude, size * size);
+
+	/// smooth, 结果原地写回amplitude
+	box_filter_fixed<5>(fft.amplitude, fft.buffer, size, size);
+
+	/// smooth^alpha * frequency -> frequency
+	spectral_weight(frequency, fft.amplitude, alpha, size * size);
+}
+
+#endif // GOLDSTEIN_BLOCK_H
@@ -0,0 +1,344 @@
+#include "goldstein_engine.h"
+
+#include <iostream>
+#include <complex>
+#include <cmath>
+#include <future>
+#include <omp.h>
+
+#include <fmt/format.h>
+
+#include "fft_plan_cache.h"
+#include "goldstein_block.h"
+
+namespace {
+
+/// @brief 一维窗函数, 采样点位于像素中心, 所以两端的权重不为0, 影像边缘只被一个block覆盖的像素也能正常归一化
+std::vector<float> taper_window(goldstein_taper taper, int size)
+{
+	const double pi = 3.14159265358979323846;
+	std::vector<float> window(size, 1.f);
+	for(int m = 0; m < size; m++){
+		double x = (m + 0.5) / size;
+		if(taper == goldstein_taper::triangle)
+			window[m] = float(1 - std::abs(2 * x - 1));
+		else if(taper == goldstein_taper::hann)
+			window[m] = float(std::sin(pi * x) * std::sin(pi * x));
+	}
+	return window;
+}
+
+/// @brief 对一个条带内的所有block执行goldstein滤波, 结果写入以strip.block_start为首行的累加数组
+/// @param acc crop方式下直接赋值为block中心区域的结果, 加权重叠相加方式下累加 window * 结果
+/// @param wsum 加权重叠相加方式下累加window, crop方式下为nullptr
+/// @param alpha_map 可选, 记录block中心区域使用的alpha
+template<typename _Ty>
+void goldstein_strip_filter(const _Ty* arr_in, const float* arr_aux, const goldstein_strip& strip, int height, int width,
+	const goldstein_params& par, const std::vector<float>& window, const goldstein_alpha_func& alpha_func,
+	std::complex<float>* acc, float* wsum, float* alpha_map)
+{
+	constexpr bool phase_input = std::is_same<_Ty, float>::value;
+
+	int size = par.size;
+	int overlap = par.overlap;
+	int step = par.step();
+	bool wola = (wsum != nullptr);
+
+	/// 加权重叠相加时, 相邻ceil(size/step)个block行会累加到相同的行, 所以按block行号分组(phase)执行, 同组内的block行互不重叠;
+	/// crop方式下每个block行写出的区域本就互不重叠
+	int block_rows = (strip.block_end - strip.block_start + step - 1) / step;
+	int phases = wola ? (size + step - 1) / step : 1;
+
+#pragma omp parallel
+	{
+		fft_block& fft = fft_plan_cache::instance().get(size, omp_get_thread_num());
+		fftwf_complex* spatial_arr = fft.spatial;
+
+		/// 相位输入时, 当前block行(size行)展开后的单位复数, 每个线程独立且只申请一次
+		std::vector<std::complex<float>> band;
+		if(phase_input)
+			band.resize(size_t(size) * width);
+
+		for(int phase = 0; phase < phases; phase++)
+		{
+#pragma omp for schedule(dynamic)
+			for(int k = phase; k < block_rows; k += phases)
+			{
+				int i = strip.block_start + k * step;
+				int band_rows = MIN(size, height - i);
+
+				/// out_i_start, out_i_end, crop方式下block数组内需要赋值到输出的行数(左闭右开), 保证输出数据没有"黑框"
+				int out_i_start = (i == 0 ? 0 : overlap / 2);
+				int out_i_end = MIN(overlap / 2 + step, height - i);
+
+				/// 当前block行的数据, 复数直接使用arr_in, 相位展开为单位复数, 使每个像素在一个block行内只计算一次cos/sin
+				const std::complex<float>* src;
+				if constexpr (phase_input){
+					const float* phase_arr = arr_in + size_t(i - strip.in_start) * width;
+					for(size_t idx = 0; idx < size_t(band_rows) * width; idx++)
+						band[idx] = std::complex<float>(cosf(phase_arr[idx]), sinf(phase_arr[idx]));
+					src = band.data();
+				}
+				else{
+					src = arr_in + size_t(i - strip.in_start) * width;
+				}
+
+				for(int j = 0; j < width; j += step)
+				{
+					int band_cols = MIN(size, width - j);
+
+					/// out_j_start, out_j_end, crop方式下block数组内需要赋值到输出的列数(左闭右开)
+					int out_j_start = (j == 0 ? 0 : overlap / 2);
+					int out_j_end = MIN(overlap / 2 + step, width - j);
+
+					/// spatial_arr init
+					for(int idx = 0; idx < size * size; idx++){
+						int block_i = idx / size;
+						int block_j = idx % size;
+						if(block_j > band_cols - 1 || block_i > band_rows - 1){
+							/// 说明超界, 需要补零
+							spatial_arr[idx][0] = 0;
+							spatial_arr[idx][1] = 0;
+						}
+						else{
+							const std::complex<float>& val = src[size_t(block_i) * width + j + block_j];
+							spatial_arr[idx][0] = val.real();
+							spatial_arr[idx][1] = val.imag();
+						}
+					}
+
+					goldstein_block_info info;
+					info.row = i;
+					info.col = j;
+					info.rows = band_rows;
+					info.cols = band_cols;
+					info.size = size;
+					info.spatial = spatial_arr;
+					info.aux = (arr_aux == nullptr ? nullptr : arr_aux + size_t(i - strip.in_start) * width + j);
+					info.aux_stride = width;
+					float alpha = alpha_func(info);
+
+					if(alpha_map != nullptr){
+						for(int m = out_i_start; m < out_i_end; m++)
+							for(int n = out_j_start; n < out_j_end; n++)
+								alpha_map[size_t(i + m - strip.block_start) * width + j + n] = alpha;
+					}
+
+					///  fft
+					fftwf_execute(fft.forward);
+
+					/// abs -> smooth -> smooth^alpha * frequency
+					goldstein_block_weight(fft, alpha);
+
+					/// ifft
+					fftwf_execute(fft.backward);
+
+					/// 赋值, acc的首行对应全图的strip.block_start行
+					if(!wola){
+						for(int m = out_i_start; m < out_i_end; m++){
+							std::complex<float>* dst = acc + size_t(i + m - strip.block_start) * width + j;
+							for(int n = out_j_start; n < out_j_end; n++){
+								dst[n].real(spatial_arr[m*size+n][0] / size / size);
+								dst[n].imag(spatial_arr[m*size+n][1] / size / size);
+							}
+						}
+					}
+					else{
+						for(int m = 0; m < band_rows; m++){
+							std::complex<float>* dst = acc + size_t(i + m - strip.block_start) * width + j;
+							float* dst_w = wsum + size_t(i + m - strip.block_start) * width + j;
+							for(int n = 0; n < band_cols; n++){
+								float w = window[m] * window[n];
+								dst[n] += std::complex<float>(spatial_arr[m*size+n][0], spatial_arr[m*size+n][1]) * (w / size / size);
+								dst_w[n] += w;
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+template<typename _Ty>
+funcrst goldstein_stream(GDALRasterBand* rb_in, GDALRasterBand* rb_out, const goldstein_params& par, const goldstein_alpha_func& alpha_func,
+	GDALRasterBand* rb_aux, GDALRasterBand* rb_alpha)
+{
+	constexpr bool phase_input = std::is_same<_Ty, float>::value;
+	GDALDataType datatype = phase_input ? GDT_Float32 : GDT_CFloat32;
+
+	int width = rb_in->GetXSize();
+	int height = rb_in->GetYSize();
+	bool wola = (par.taper != goldstein_taper::crop);
+
+	std::vector<goldstein_strip> strips = split_goldstein_strips(height, par.size, par.overlap, par.strip);
+	std::vector<float> window = taper_window(par.taper, par.size);
+
+	struct strip_data{
+		std::vector<_Ty> in;
+		std::vector<float> aux;
+	};
+
+	auto read_strip = [&](const goldstein_strip& strip, strip_data& data) -> CPLErr
+	{
+		int rows = strip.in_end - strip.in_start;
+		data.in.resize(size_t(rows) * width);
+		CPLErr err = rb_in->RasterIO(GF_Read, 0, strip.in_start, width, rows, data.in.data(), width, rows, datatype, 0, 0);
+		if(err != CE_None || rb_aux == nullptr)
+			return err;
+		data.aux.resize(size_t(rows) * width);
+		return rb_aux->RasterIO(GF_Read, 0, strip.in_start, width, rows, data.aux.data(), width, rows, GDT_Float32, 0, 0);
+	};
+
+	/// 累加数组比条带多overlap行, 用于保存block超出条带下边界的部分, 写出条带后平移到下一个条带的开头
+	int max_rows = 0;
+	for(auto& strip : strips)
+		max_rows = MAX(max_rows, strip.block_end - strip.block_start);
+	size_t acc_size = size_t(max_rows + par.overlap) * width;
+	std::vector<std::complex<float>> acc(acc_size);
+	std::vector<float> wsum(wola ? acc_size : 0);
+	std::vector<float> alpha_map(rb_alpha ? acc_size : 0);
+	std::vector<_Ty> arr_out;
+
+	/// 双缓冲: 当前条带滤波与写出的同时, 在另一个线程中读取下一个条带
+	strip_data data_cur, data_next;
+	CPLErr read_err = strips.empty() ? CE_None : read_strip(strips[0], data_cur);
+	for(size_t s = 0; s < strips.size(); s++)
+	{
+		if(read_err != CE_None)
+			return funcrst(false, fmt::format("read strip [{},{}) failed. ({})", strips[s].in_start, strips[s].in_end, CPLGetLastErrorMsg()));
+
+		std::future<CPLErr> next;
+		if(s + 1 < strips.size())
+			next = std::async(std::launch::async, [&, s]{ return read_strip(strips[s+1], data_next); });
+
+		const goldstein_strip& strip = strips[s];
+		int rows = strip.block_end - strip.block_start;
+		size_t count = size_t(rows) * width;
+
+		goldstein_strip_filter(data_cur.in.data(), rb_aux ? data_cur.aux.data() : nullptr, strip, height, width, par, window, alpha_func,
+			acc.data(), wola ? wsum.data() : nullptr, rb_alpha ? alpha_map.data() : nullptr);
+
+		/// 累加结果 -> 输出, 相位只需计算角度, 与权重之和无关
+		void* out_ptr = acc.data();
+		if(phase_input || wola){
+			arr_out.resize(count);
+			out_ptr = arr_out.data();
+#pragma omp parallel for
+			for(long long idx = 0; idx < (long long)count; idx++){
+				if constexpr (phase_input)
+					arr_out[idx] = atan2f(acc[idx].imag(), acc[idx].real());
+				else
+					arr_out[idx] = acc[idx] / wsum[idx];
+			}
+		}
+
+		CPLErr write_err = rb_out->RasterIO(GF_Write, 0, strip.block_start, width, rows, out_ptr, width, rows, datatype, 0, 0);
+		if(write_err == CE_None && rb_alpha != nullptr)
+			write_err = rb_alpha->RasterIO(GF_Write, 0, strip.block_start, width, rows, alpha_map.data(), width, rows, GDT_Float32, 0, 0);
+
+		/// 将超出条带的overlap行平移到开头, 其余部分清零
+		size_t carry = size_t(par.overlap) * width;
+		std::copy(acc.begin() + count, acc.begin() + count + carry, acc.begin());
+		std::fill(acc.begin() + carry, acc.end(), std::complex<float>(0, 0));
+		if(wola){
+			std::copy(wsum.begin() + count, wsum.begin() + count + carry, wsum.begin());
+			std::fill(wsum.begin() + carry, wsum.end(), 0.f);
+		}
+		if(rb_alpha != nullptr)
+			std::copy(alpha_map.begin() + count, alpha_map.begin() + count + carry, alpha_map.begin());
+
+		if(next.valid()){
+			read_err = next.get();
+			std::swap(data_cur, data_next);
+		}
+
+		if(write_err != CE_None)
+			return funcrst(false, fmt::format("write strip [{},{}) failed. ({})", strip.block_start, strip.block_end, CPLGetLastErrorMsg()));
+
+		std::cout<<fmt::format("\rstrip: {}/{}...", s + 1, strips.size());
+	}
+	std::cout<<std::endl;
+
+	return funcrst(true, "goldstein_stream finished.");
+}
+
+}
+
+funcrst goldstein_taper_from_string(std::string str, goldstein_taper& taper)
+{
+	if(str == "crop")
+		taper = goldstein_taper::crop;
+	else if(str == "triangle")
+		taper = goldstein_taper::triangle;
+	else if(str == "hann")
+		taper = goldstein_taper::hann;
+	else
+		return funcrst(false, fmt::format("goldstein_taper_from_string, unknown taper '{}'.", str));
+	return funcrst(true, "goldstein_taper_from_string finished.");
+}
+
+const char* goldstein_taper_name(goldstein_taper taper)
+{
+	switch (taper)
+	{
+	case goldstein_taper::triangle:
+		return "triangle";
+	case goldstein_taper::hann:
+		return "hann";
+	default:
+		return "crop";
+	}
+}
+
+std::vector<goldstein_strip> split_goldstein_strips(int height, int size, int overlap, int strip_height)
+{
+	int step = size - overlap;
+	strip_height = (strip_height + step - 1) / step * step;
+
+	std::vector<goldstein_strip> strips;
+	for(int i = 0; i < height; i += strip_height)
+	{
+		goldstein_strip strip;
+		strip.block_start = i;
+		strip.block_end = MIN(i + strip_height, height);
+		strip.in_start = i;
+		strip.in_end = MIN(i + strip_height - step + size, height);
+		strips.push_back(strip);
+	}
+	return strips;
+}
+
+funcrst goldstein_filter(GDALRasterBand* rb_in, GDALRasterBand* rb_out, const goldstein_params& par, goldstein_alpha_func alpha_func,
+	GDALRasterBand* rb_aux, GDALRasterBand* rb_alpha)
+{
+	if(rb_in == nullptr || rb_out == nullptr)
+		return funcrst(false, "goldstein_filter, rb_in or rb_out is nullptr.");
+
+	if(!alpha_func)
+		return funcrst(false, "goldstein_filter, alpha_func is empty.");
+
+	if(par.size < 8 || par.overlap < 0 || par.overlap >= par.size || par.strip < 1)
+		return funcrst(false, fmt::format("goldstein_filter, invalid parameters (size: {}, overlap: {}, strip: {}).", par.size, par.overlap, par.strip));
+
+	int width = rb_in->GetXSize();
+	int height = rb_in->GetYSize();
+	GDALDataType datatype = rb_in->GetRasterDataType();
+
+	if(datatype != GDT_CFloat32 && datatype != GDT_Float32)
+		return funcrst(false, "goldstein_filter, rb_in.datatype is diff with float or fcomplex.");
+
+	if(rb_out->GetXSize() != width || rb_out->GetYSize() != height || rb_out->GetRasterDataType() != datatype)
+		return funcrst(false, "goldstein_filter, rb_out is diff with rb_in in size or datatype.");
+
+	if(rb_aux != nullptr && (rb_aux->GetXSize() != width || rb_aux->GetYSize() != height))
+		return funcrst(false, fmt::format("goldstein_filter, rb_aux.size({}x{}) is diff with rb_in.size({}x{}).", rb_aux->GetXSize(), rb_aux->GetYSize(), width, height));
+
+	if(rb_alpha != nullptr && (rb_alpha->GetXSize() != width || rb_alpha->GetYSize() != height))
+		return funcrst(false, "goldstein_filter, rb_alpha is diff with rb_in in size.");
+
+	if(datatype == GDT_CFloat32)
+		return goldstein_stream<std::complex<float>>(rb_in, rb_out, par, alpha_func, rb_aux, rb_alpha);
+	else
+		return goldstein_stream<float>(rb_in, rb_out, par, alpha_func, rb_aux, rb_alpha);
+}
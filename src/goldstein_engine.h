@@ -0,0 +1,72 @@
+#ifndef GOLDSTEIN_ENGINE_H
+#define GOLDSTEIN_ENGINE_H
+
+#include <string>
+#include <vector>
+#include <functional>
+
+#include <gdal_priv.h>
+#include <fftw3.h>
+
+#include "datatype.h"
+
+/// goldstein, zhao, baran共用的条带式goldstein滤波引擎.
+/// 影像按条带(strip)读取, 每个条带内以step = size - overlap为间隔划分size*size的block, 逐block执行 fft -> 频域加权 -> ifft,
+/// 三种方法的区别只在于每个block的alpha如何计算, 由goldstein_alpha_func给出.
+/// block结果的拼接方式(taper):
+///   crop: 只保留block中心step*step的区域(默认, 与原实现一致);
+///   triangle/hann: 加权重叠相加(WOLA), 每个像素为覆盖它的所有block以窗函数加权的平均, 可消除block之间的拼接痕迹.
+
+enum class goldstein_taper{ crop, triangle, hann };
+
+struct goldstein_params
+{
+	int size{ 32 };
+	int overlap{ 24 };
+	int strip{ 512 };
+	goldstein_taper taper{ goldstein_taper::crop };
+
+	int step() const { return size - overlap; }
+};
+
+/// @brief 字符串(crop, triangle, hann)转goldstein_taper
+funcrst goldstein_taper_from_string(std::string str, goldstein_taper& taper);
+
+const char* goldstein_taper_name(goldstein_taper taper);
+
+/// @brief 计算alpha时可以使用的block信息, 行列号均为全图行列号
+struct goldstein_block_info
+{
+	int row, col;					///< block左上角的行列号
+	int rows, cols;					///< block内未超界的行列数
+	int size;						///< block尺寸
+	const fftwf_complex* spatial;	///< block数据(size*size), 超界部分为0
+	const float* aux;				///< 辅助数据(如相干系数)中block左上角的指针, 行间隔为aux_stride; 没有辅助数据时为nullptr
+	size_t aux_stride;
+};
+
+/// @brief 返回block使用的alpha, 会在多个线程中同时调用
+using goldstein_alpha_func = std::function<float(const goldstein_block_info&)>;
+
+/// @brief goldstein条带的几何信息, 行号均为全图行号, 区间左闭右开
+/// block_start~block_end: 条带负责的block起始行(以step为间隔), 同时也是条带写出的行;
+/// in_start~in_end: 需要读取的行, 在block_start~block_end的基础上额外包含下方的overlap行.
+/// block下方超出block_end的部分结果会保留到下一个条带, 所以相邻条带之间不需要重复计算
+struct goldstein_strip{
+	int block_start, block_end;
+	int in_start, in_end;
+};
+
+/// @brief 按照条带高度(行数)划分全图, strip_height会向上取整为step的倍数
+std::vector<goldstein_strip> split_goldstein_strips(int height, int size, int overlap, int strip_height);
+
+/// @brief 条带式goldstein滤波, 当前条带滤波写出的同时读取下一个条带, 峰值内存只与条带行数有关
+/// @param rb_in 输入波段, 支持fcomplex(干涉图)与float(相位), 相位在block行内即时展开为单位复数, 不保存展开后的复数影像
+/// @param rb_out 输出波段, 数据类型与rb_in相同
+/// @param alpha_func 每个block的alpha
+/// @param rb_aux 可选的辅助数据波段(float, 与rb_in同尺寸), 按条带读取后通过goldstein_block_info::aux传给alpha_func
+/// @param rb_alpha 可选的alpha输出波段(float), 每个像素记录其所在block中心区域使用的alpha
+funcrst goldstein_filter(GDALRasterBand* rb_in, GDALRasterBand* rb_out, const goldstein_params& par, goldstein_alpha_func alpha_func,
+	GDALRasterBand* rb_aux = nullptr, GDALRasterBand* rb_alpha = nullptr);
+
+#endif // GOLDSTEIN_ENGINE_H
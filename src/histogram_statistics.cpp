@@ -1,5 +1,6 @@
 #include "raster_include.h"
 #include "template_stretch.h"
+#include "raster_statistics.h"
 
 /*
     sub_histogram_stretch.add_argument("input_imgpath")
@@ -23,47 +24,44 @@ int histogram_statistics(argparse::ArgumentParser* args,std::shared_ptr<spdlog::
         return -1;
     }
 
-    GDALDataset* ds = (GDALDataset*)GDALOpen(img_filepath.c_str(), GA_Update);
+    GDALDataset* ds = (GDALDataset*)GDALOpen(img_filepath.c_str(), GA_ReadOnly);
     if(!ds){
         PRINT_LOGGER(logger, error, "ds is nullptr.");
         return -2;
     }
-        
-    int xsize = ds->GetRasterXSize();
-    int ysize = ds->GetRasterYSize();
-    int bands = ds->GetRasterCount();
     GDALDataType datatype = ds->GetRasterBand(1)->GetRasterDataType();
+    GDALClose(ds);
     if(datatype > GDT_Float64 /*cshort cint cfloat cdouble*/ || datatype == 0 /*unknown*/){
         PRINT_LOGGER(logger, error,"unsupported datatype, unsupport list: complex.");
         return -3;
     }
-    GDALRasterBand* rb = ds->GetRasterBand(1);
 
-    CPLErr err;
-    double minmax[2];
-    GUIntBig* histogram_result = new GUIntBig[histogram_length];
-    err = rb->ComputeRasterMinMax(FALSE,minmax);
-    if(err == CE_Failure){
-        PRINT_LOGGER(logger, error,"rb.computeRasterMinMax failed.");
+    /// 并行遍历得到最值与[min, max]内的直方图(等于max的值归入最后一箱), 8/16位整数一次遍历, 浮点与32位整数再遍历一次
+    raster_statistics_options opt;
+    opt.bands.push_back(1);
+    opt.histogram_size = histogram_length;
+    std::vector<band_statistics> stats;
+    funcrst rst = compute_raster_statistics(img_filepath, opt, stats);
+    if(!rst){
+        PRINT_LOGGER(logger, error, fmt::format("compute_raster_statistics failed. ({})", rst.explain));
         return -4;
     }
-    err = rb->GetHistogram(minmax[0], minmax[1], histogram_length, histogram_result, FALSE, FALSE, GDALDummyProgress, nullptr);
-    if(err == CE_Failure){
-        PRINT_LOGGER(logger, error,"rb.getHistrogram failed.");
+    const band_statistics& st = stats[0];
+    if(st.count == 0){
+        PRINT_LOGGER(logger, error, "band 1 has no valid value.");
         return -5;
     }
 
-    double delta_value = ( minmax[1] -  minmax[0]) / histogram_length;
+    double delta_value = (st.max - st.min) / histogram_length;
 
     string msg = "histogram statistics:\n";
     for(int i=0; i< histogram_length; i++)
     {
-        double min = minmax[0] + i * delta_value;
-        double max = minmax[0] + (i+1) * delta_value;
-        unsigned long long num = histogram_result[i];
+        double min = st.min + i * delta_value;
+        double max = st.min + (i+1) * delta_value;
+        unsigned long long num = st.histogram[i];
         msg += fmt::format("range: [{},{}], num:{}\n", min, max, num);
     }
-    delete[] histogram_result;
     PRINT_LOGGER(logger, info, msg);
 
     PRINT_LOGGER(logger, info,"histogram_statistics success.");
@@ -1,5 +1,7 @@
 #include "raster_include.h"
 #include "template_stretch.h"
+#include "raster_statistics.h"
+#include "raster_copy.h"
 #define HISTOGRAM_SIZE 256
 
 /*
@@ -24,68 +26,106 @@ int histogram_stretch(argparse::ArgumentParser* args,std::shared_ptr<spdlog::log
     std::string output_filepath = args->get<std::string>("output_imgpath");
     double stretch_rate = args->get<double>("stretch_rate");
 
-
-    if(input_filepath!= output_filepath){
-        fs::path src(input_filepath);
-        fs::path dst(output_filepath);
-        if(fs::exists(dst)){
-            PRINT_LOGGER(logger, warn,"input_file is existed, we will remove and copy input_file to output_file.");
-            fs::remove(dst);
-        }
-        fs::copy(src,dst);
-    }
-    PRINT_LOGGER(logger, info, "input_file has been copy to output_file.");
-
-    GDALDataset* ds = static_cast<GDALDataset*>(GDALOpen(output_filepath.c_str(), GA_Update));
-    if(ds == nullptr){
-        PRINT_LOGGER(logger, warn,"ds is nullptr. output_file is no-existed(when input_file==output_file), or cann't be create?");
+    GDALDataset* ds_in = static_cast<GDALDataset*>(GDALOpen(input_filepath.c_str(), GA_ReadOnly));
+    if(ds_in == nullptr){
+        PRINT_LOGGER(logger, error,"ds_in is nullptr.");
         return -1;
     }
-        
-    int xsize = ds->GetRasterXSize();
-    int ysize = ds->GetRasterYSize();
-    int bands = ds->GetRasterCount();
-    GDALDataType datatype = ds->GetRasterBand(1)->GetRasterDataType();
+
+    int bands = ds_in->GetRasterCount();
+    GDALDataType datatype = ds_in->GetRasterBand(1)->GetRasterDataType();
     if(datatype > GDT_Float64 /*cshort cint cfloat cdouble*/ || datatype == 0 /*unknown*/){
+        GDALClose(ds_in);
         PRINT_LOGGER(logger, error,"unsupported datatype, unsupport list: complex");
         return -1;
     }
 
-    for(int b = 1; b <= bands; b++)
-    {
-        GDALRasterBand* rb = ds->GetRasterBand(b);
-        funcrst rst;
-        switch (datatype)
-        {
-        case GDT_Byte:{
-            rst = rasterband_histogram_stretch<char>(rb, b, xsize, ysize, HISTOGRAM_SIZE, stretch_rate);
-        }break;
-        case GDT_Int16:{
-            rst = rasterband_histogram_stretch<short>(rb, b, xsize, ysize, HISTOGRAM_SIZE, stretch_rate);
-        }break;
-        case GDT_UInt16:{
-            rst = rasterband_histogram_stretch<unsigned short>(rb, b, xsize, ysize, HISTOGRAM_SIZE, stretch_rate);
-        }break;
-        case GDT_Int32:{
-            rst = rasterband_histogram_stretch<int>(rb, b, xsize, ysize, HISTOGRAM_SIZE, stretch_rate);
-        }break;
-        case GDT_UInt32:{
-            rst = rasterband_histogram_stretch<unsigned int>(rb, b, xsize, ysize, HISTOGRAM_SIZE, stretch_rate);
-        }break;
-        case GDT_Float32:{
-            rst = rasterband_histogram_stretch<float>(rb, b, xsize, ysize, HISTOGRAM_SIZE, stretch_rate);
-        }break;
-        case GDT_Float64:{
-            rst = rasterband_histogram_stretch<double>(rb, b, xsize, ysize, HISTOGRAM_SIZE, stretch_rate);
-        }break;
-        default:
-            break;
-        }
+    /// 并行遍历得到所有波段的最值与[min, max]内的精确直方图: 8/16位整数在同一次遍历中逐值计数, 浮点与32位整数再遍历一次
+    auto start_time = std::chrono::system_clock::now();
+    raster_statistics_options opt;
+    opt.histogram_size = HISTOGRAM_SIZE;
+    std::vector<band_statistics> stats;
+    funcrst rst = compute_raster_statistics(input_filepath, opt, stats);
+    if(!rst){
+        GDALClose(ds_in);
+        PRINT_LOGGER(logger, error, fmt::format("compute_raster_statistics failed. ({})", rst.explain));
+        return -2;
+    }
 
+    std::vector<stretch_range> ranges(bands);
+    for(int b = 1; b <= bands; b++){
+        stretch_range& range = ranges[b - 1];
+        range.has_nodata = stats[b - 1].has_nodata;
+        range.nodata = stats[b - 1].nodata;
+        rst = cal_stretched_minmax(stats[b - 1], HISTOGRAM_SIZE, stretch_rate, range.min, range.max);
         if(!rst){
-            PRINT_LOGGER(logger, error, fmt::format("band[{}] rasterband_histogram_stretch failed.", b));
+            /// 与之前一致, 失败的波段不拉伸
+            PRINT_LOGGER(logger, error, fmt::format("band[{}] cal_stretched_minmax failed. ({})", b, rst.explain));
+            range.min = stats[b - 1].min;
+            range.max = stats[b - 1].max;
         }
+        PRINT_LOGGER(logger, info, fmt::format("band[{}] min: {}, max: {}, stretched min: {}, stretched max: {}.", b, stats[b - 1].min, stats[b - 1].max, range.min, range.max));
+    }
+    PRINT_LOGGER(logger, info, fmt::format("histogram statistics finished, spend time {}s.", spend_time(start_time)));
+
+    /// 输入输出相同时原地处理, 否则以输入的驱动与创建参数新建输出数据集并直接写入, 不再复制输入文件
+    GDALDataset* ds_out = nullptr;
+    if(input_filepath == output_filepath){
+        GDALClose(ds_in);
+        ds_in = static_cast<GDALDataset*>(GDALOpen(input_filepath.c_str(), GA_Update));
+        if(ds_in == nullptr){
+            PRINT_LOGGER(logger, error,"ds_in is nullptr, open with GA_Update failed.");
+            return -1;
+        }
+        ds_out = ds_in;
+    }
+    else{
+        std::string err;
+        ds_out = create_like(ds_in, output_filepath, err);
+        if(ds_out == nullptr){
+            GDALClose(ds_in);
+            PRINT_LOGGER(logger, error, fmt::format("ds_out is nullptr, {}", err));
+            return -3;
+        }
+    }
+
+    switch (datatype)
+    {
+    case GDT_Byte:
+        rst = dataset_histogram_stretch<unsigned char>(ds_in, ds_out, ranges);
+        break;
+    case GDT_Int16:
+        rst = dataset_histogram_stretch<short>(ds_in, ds_out, ranges);
+        break;
+    case GDT_UInt16:
+        rst = dataset_histogram_stretch<unsigned short>(ds_in, ds_out, ranges);
+        break;
+    case GDT_Int32:
+        rst = dataset_histogram_stretch<int>(ds_in, ds_out, ranges);
+        break;
+    case GDT_UInt32:
+        rst = dataset_histogram_stretch<unsigned int>(ds_in, ds_out, ranges);
+        break;
+    case GDT_Float32:
+        rst = dataset_histogram_stretch<float>(ds_in, ds_out, ranges);
+        break;
+    case GDT_Float64:
+        rst = dataset_histogram_stretch<double>(ds_in, ds_out, ranges);
+        break;
+    default:
+        rst = funcrst(false, "unsupported datatype.");
+        break;
+    }
+
+    if(ds_out != ds_in)
+        GDALClose(ds_out);
+    GDALClose(ds_in);
+
+    if(!rst){
+        PRINT_LOGGER(logger, error, fmt::format("dataset_histogram_stretch failed. ({})", rst.explain));
+        return -4;
     }
 
+    PRINT_LOGGER(logger, info, fmt::format("histogram_stretch success, spend time {}s.", spend_time(start_time)));
     return 1;
-}
\ No newline at end of file
+}
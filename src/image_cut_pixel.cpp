@@ -1,4 +1,5 @@
 #include "raster_include.h"
+#include "raster_copy.h"
 
 /*
     sub_image_cut_pixel.add_argument("input_imgpath")
@@ -38,7 +39,6 @@ int image_cut_by_pixel(argparse::ArgumentParser* args,std::shared_ptr<spdlog::lo
     int height= ds->GetRasterYSize();
     int bands = ds->GetRasterCount();
     GDALDataType datatype = rb->GetRasterDataType();
-    int datasize = GDALGetDataTypeSize(datatype);
     double geotransform[6];
     auto cplerr = ds->GetGeoTransform(geotransform);
     bool has_geotransform = (cplerr == CE_Failure ? false : true);
@@ -57,17 +57,18 @@ int image_cut_by_pixel(argparse::ArgumentParser* args,std::shared_ptr<spdlog::lo
         return -1;
     }
 
-    for(int b = 1; b <= bands; b++)
-    {
-        GDALRasterBand* rb_in = ds->GetRasterBand(b);
-        GDALRasterBand* rb_out = ds_out->GetRasterBand(b);
-        void* arr = malloc(cutted_width * datasize);
-        for(int i=0; i< cutted_height; i++)
-        {
-            rb_in->RasterIO(GF_Read, start_x, i + start_y, cutted_width, 1, arr, cutted_width, 1, datatype, 0, 0);
-            rb_out->RasterIO(GF_Write, 0, i, cutted_width, 1, arr, cutted_width, 1, datatype, 0, 0);
-        }
-        free(arr);
+    vector<int> band_list;
+    vector<raster_copy_target> targets;
+    for(int b = 1; b <= bands; b++){
+        band_list.push_back(b);
+        targets.push_back({ds_out, b});
+    }
+    funcrst rst = raster_copy(input_img, start_x, start_y, cutted_width, cutted_height, band_list, targets);
+    if(!rst){
+        GDALClose(ds);
+        GDALClose(ds_out);
+        PRINT_LOGGER(logger, error, fmt::format("image_cut_by_pixel failed, {}", rst.explain));
+        return -2;
     }
 
     if(has_geotransform){
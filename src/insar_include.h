@@ -19,6 +19,11 @@
 #include <fftw3.h>
 #include <omp.h>
 
+#include "fft_plan_cache.h"
+#include "goldstein_engine.h"
+#include "goldstein_block.h"
+#include "smoothing.h"
+
 namespace fs = std::filesystem;
 using std::cout, std::cin, std::endl, std::string, std::vector, std::map;
 
@@ -28,7 +33,14 @@ using std::cout, std::cin, std::endl, std::string, std::vector, std::map;
     spdlog::TYPE(MASSAGE);                   
 #endif
 
-funcrst conv_2d(float* arr_in, int width, int height, float* arr_out, float* kernel, int size);
+/// @brief 按照--fft_plan与--wisdom参数配置fft_plan_cache, 并为size大小的block创建所有线程的plan
+void fft_plan_init(argparse::ArgumentParser* args, std::shared_ptr<spdlog::logger> logger, int size);
+
+/// @brief 如果使用了--wisdom参数, 将fftw wisdom保存到对应文件
+void fft_plan_finish(argparse::ArgumentParser* args, std::shared_ptr<spdlog::logger> logger);
+
+/// @brief 读取并检查--block, --overlap, --strip与--taper参数, 无效的参数替换为默认值
+goldstein_params goldstein_args(argparse::ArgumentParser* args, std::shared_ptr<spdlog::logger> logger);
 
 int filter_goldstein(argparse::ArgumentParser* args, std::shared_ptr<spdlog::logger> logger);
 
@@ -38,4 +50,8 @@ int filter_goldstein_baran(argparse::ArgumentParser* args, std::shared_ptr<spdlo
 
 int pseudo_correlation(argparse::ArgumentParser* args, std::shared_ptr<spdlog::logger> logger);
 
+int interf_generate(argparse::ArgumentParser* args, std::shared_ptr<spdlog::logger> logger);
+
+int create_8bitdata(argparse::ArgumentParser* args, std::shared_ptr<spdlog::logger> logger);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,426 @@
+#include "insar_include.h"
+#include <future>
+#include <memory>
+
+/*
+    argparse::ArgumentParser sub_interf("interf");
+    sub_interf.add_description("conjugate multiplication of data and filtering along azimuth and slant range direction.");
+    {
+        sub_interf.add_argument("master_data_path")
+            .help("master slc data, with fcomplex datatype.");
+
+        sub_interf.add_argument("slave_data_path")
+            .help("slave slc data (coregistered with master), with fcomplex datatype.");
+
+        sub_interf.add_argument("output_interf_path")
+            .help("output interf data (hase been conjugate multiplicated).");
+
+        sub_interf.add_argument("-a","--azimuth_pars")
+            .help("azimuth parameters in the following order: mas_az_bw mas_az_freq sla_az_bw sla_az_freq, in unit of --az_fs (default 1, i.e. normalized by prf).")
+            .scan<'g',double>()
+            .nargs(4);
+
+        sub_interf.add_argument("-r","--range_pars")
+            .help("slant-range parameters in the following order: mas_rg_bw mas_rg_freq sla_rg_bw sla_rg_freq, in unit of --rg_fs (default 1, i.e. normalized by range sampling rate).")
+            .scan<'g',double>()
+            .nargs(4);
+
+        sub_interf.add_argument("--az_fs")
+            .help("azimuth sampling frequency (prf) used to normalize --azimuth_pars, default is 1.")
+            .scan<'g',double>()
+            .default_value("1");
+
+        sub_interf.add_argument("--rg_fs")
+            .help("range sampling frequency used to normalize --range_pars, default is 1.")
+            .scan<'g',double>()
+            .default_value("1");
+
+        sub_interf.add_argument("-s","--strip")
+            .help("rows of each strip in streaming mode, default is 1024. peak memory depends on strip rows rather than image size.")
+            .scan<'i',int>()
+            .default_value("1024");
+
+        sub_interf.add_argument("--halo")
+            .help("half length of the hamming windowed azimuth band-pass filter (2 * halo + 1 taps), which is also the rows read above and below each strip, default is 64.")
+            .scan<'i',int>()
+            .default_value("64");
+    }
+*/
+
+/// @brief 主辅影像的公共频带, 频率均已按采样频率归一化(周期为1), center为公共频带中心, bandwidth为宽度
+struct common_band
+{
+	double center{ 0 };
+	double bandwidth{ 1 };
+
+	/// @brief 归一化频率f(已折叠到[-0.5,0.5))是否位于公共频带内
+	bool contains(double f) const;
+};
+
+/// @brief 计算主辅影像频谱的交集, 没有交集时返回false
+funcrst cal_common_band(double mas_bw, double mas_freq, double sla_bw, double sla_freq, common_band& band);
+
+/// @brief 条带式干涉图生成: 主辅影像按条带读取, 分别在距离向/方位向保留公共频带, 再逐像素共轭相乘 master * conj(slave)
+/// @param az_band, rg_band 为nullptr时不在对应方向滤波
+/// @param strip_height 每个条带写出的行数
+/// @param halo 方位向带通滤波器(FIR)的半长, 即条带上下额外读取的行数, 不进行方位向滤波时不读取
+funcrst interferogram(GDALRasterBand* rb_mas, GDALRasterBand* rb_sla, GDALRasterBand* rb_out,
+	const common_band* az_band, const common_band* rg_band, int strip_height, int halo);
+
+int interf_generate(argparse::ArgumentParser* args, std::shared_ptr<spdlog::logger> logger)
+{
+	std::string master_path = args->get<string>("master_data_path");
+	std::string slave_path  = args->get<string>("slave_data_path");
+	std::string output_path = args->get<string>("output_interf_path");
+	int strip_height = args->get<int>("--strip");
+	int halo = args->get<int>("--halo");
+
+	if(strip_height < 1){
+		PRINT_LOGGER(logger, warn, fmt::format("strip input is a invalid data ({}) which has been replaced by default ({})",strip_height, 1024));
+		strip_height = 1024;
+	}
+	if(halo < 1){
+		PRINT_LOGGER(logger, warn, fmt::format("halo input is a invalid data ({}) which has been replaced by default ({})",halo, 64));
+		halo = 64;
+	}
+
+	/// 公共频带
+	auto parse_band = [&](std::string name, std::string fs_name, common_band& band) -> funcrst
+	{
+		std::vector<double> pars = args->get<std::vector<double>>(name);
+		double fs = args->get<double>(fs_name);
+		if(pars.size() != 4)
+			return funcrst(false, fmt::format("{} needs 4 values, but got {}.", name, pars.size()));
+		if(fs <= 0)
+			return funcrst(false, fmt::format("{} ({}) should be positive.", fs_name, fs));
+		return cal_common_band(pars[0] / fs, pars[1] / fs, pars[2] / fs, pars[3] / fs, band);
+	};
+
+	common_band az_band, rg_band;
+	bool az_filter = args->is_used("--azimuth_pars");
+	bool rg_filter = args->is_used("--range_pars");
+	if(az_filter){
+		funcrst rst = parse_band("--azimuth_pars", "--az_fs", az_band);
+		if(!rst){
+			PRINT_LOGGER(logger, error, fmt::format("azimuth common band failed. ({})", rst.explain));
+			return -1;
+		}
+		PRINT_LOGGER(logger, info, fmt::format("azimuth common band, center: {}, bandwidth: {} (normalized).", az_band.center, az_band.bandwidth));
+	}
+	if(rg_filter){
+		funcrst rst = parse_band("--range_pars", "--rg_fs", rg_band);
+		if(!rst){
+			PRINT_LOGGER(logger, error, fmt::format("range common band failed. ({})", rst.explain));
+			return -1;
+		}
+		PRINT_LOGGER(logger, info, fmt::format("range common band, center: {}, bandwidth: {} (normalized).", rg_band.center, rg_band.bandwidth));
+	}
+
+	GDALAllRegister();
+    CPLSetConfigOption("GDAL_FILENAME_IS_UTF8", "NO");
+
+	GDALDataset* ds_mas = (GDALDataset*)GDALOpen(master_path.c_str(), GA_ReadOnly);
+	GDALDataset* ds_sla = (GDALDataset*)GDALOpen(slave_path.c_str(), GA_ReadOnly);
+	if(!ds_mas || !ds_sla){
+		if(ds_mas) GDALClose(ds_mas);
+		if(ds_sla) GDALClose(ds_sla);
+		PRINT_LOGGER(logger, error, "ds_mas or ds_sla is nullptr");
+		return -1;
+	}
+	GDALRasterBand* rb_mas = ds_mas->GetRasterBand(1);
+	GDALRasterBand* rb_sla = ds_sla->GetRasterBand(1);
+	int width = ds_mas->GetRasterXSize();
+	int height= ds_mas->GetRasterYSize();
+
+	if(rb_mas->GetRasterDataType() != GDT_CFloat32 || rb_sla->GetRasterDataType() != GDT_CFloat32){
+		GDALClose(ds_mas);
+		GDALClose(ds_sla);
+		PRINT_LOGGER(logger, error, "datatype of master or slave is not fcomplex.");
+		return -2;
+	}
+
+	if(ds_sla->GetRasterXSize() != width || ds_sla->GetRasterYSize() != height){
+		PRINT_LOGGER(logger, error, fmt::format("slave.size({}x{}) is diff with master.size({}x{}).", ds_sla->GetRasterXSize(), ds_sla->GetRasterYSize(), width, height));
+		GDALClose(ds_mas);
+		GDALClose(ds_sla);
+		return -2;
+	}
+
+	GDALDriver* dv = GetGDALDriverManager()->GetDriverByName("GTiff");
+	GDALDataset* ds_out = dv->Create(output_path.c_str(), width, height, 1, GDT_CFloat32, NULL);
+	if(!ds_out){
+		GDALClose(ds_mas);
+		GDALClose(ds_sla);
+		PRINT_LOGGER(logger, error, "ds_out is nullptr.");
+		return -3;
+	}
+	GDALRasterBand* rb_out = ds_out->GetRasterBand(1);
+
+	PRINT_LOGGER(logger, info, "Preparation completed, start interferogram generation.");
+
+	auto start_time = std::chrono::system_clock::now();
+	funcrst rst = interferogram(rb_mas, rb_sla, rb_out, az_filter ? &az_band : nullptr, rg_filter ? &rg_band : nullptr, strip_height, halo);
+
+	GDALClose(ds_mas);
+	GDALClose(ds_sla);
+	GDALClose(ds_out);
+
+	if(!rst){
+		PRINT_LOGGER(logger, error, fmt::format("interferogram failed. ({})", rst.explain));
+		return -3;
+	}
+
+	PRINT_LOGGER(logger, info, fmt::format("interf_generate finished, spend time {}s.", spend_time(start_time)));
+	return 1;
+}
+
+namespace {
+
+/// @brief 折叠到[-0.5,0.5)
+double wrap_freq(double f)
+{
+	return f - std::floor(f + 0.5);
+}
+
+/// @brief 长度为n的fft中第k个频点对应的归一化频率
+double fft_freq(int k, int n)
+{
+	return wrap_freq(double(k) / n);
+}
+
+/// @brief 频域掩膜, 公共频带内为1, 其余为0
+std::vector<float> band_mask(const common_band& band, int n)
+{
+	std::vector<float> mask(n);
+	for(int k = 0; k < n; k++)
+		mask[k] = band.contains(fft_freq(k, n)) ? 1.f : 0.f;
+	return mask;
+}
+
+/// @brief 加hamming窗的FIR带通滤波器(2 * half + 1个抽头)在长度为n的fft各频点上的响应
+/// h[m] = w[m] * B * sinc(B * m) * exp(j * 2pi * fc * m), |m| <= half, 低通部分为实偶函数, 所以响应为实数,
+/// 即 H(f) = h0[0] + 2 * sum(h0[m] * cos(2pi * (f - fc) * m)), 并归一化使中心频率处增益为1.
+/// 作为频域掩膜使用时等价于与h做循环卷积, 只要fft长度内首尾有不少于half行的halo或补零, 保留的行就与线性卷积完全一致(overlap-save).
+std::vector<float> fir_band_response(const common_band& band, int half, int n)
+{
+	const double pi = 3.14159265358979323846;
+	std::vector<double> taps(half + 1);
+	for(int m = 0; m <= half; m++){
+		double x = pi * band.bandwidth * m;
+		double sinc = m == 0 ? 1. : std::sin(x) / x;
+		double window = 0.54 + 0.46 * std::cos(pi * m / half);
+		taps[m] = band.bandwidth * sinc * window;
+	}
+	auto response = [&](double f){
+		double h = taps[0];
+		for(int m = 1; m <= half; m++)
+			h += 2 * taps[m] * std::cos(2 * pi * f * m);
+		return h;
+	};
+
+	double gain = response(0);
+	std::vector<float> mask(n);
+	for(int k = 0; k < n; k++)
+		mask[k] = float(response(wrap_freq(fft_freq(k, n) - band.center)) / gain);
+	return mask;
+}
+
+/// @brief 每个线程使用的fft缓冲区, 以fftwf_malloc申请, 保证与创建plan时的数组对齐方式一致
+struct fft_line
+{
+	fftwf_complex* data{ nullptr };
+
+	explicit fft_line(int n) { data = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * n); }
+	~fft_line() { fftwf_free(data); }
+	fft_line(const fft_line&) = delete;
+	fft_line& operator=(const fft_line&) = delete;
+};
+
+/// @brief 一维fft的正反变换plan, 在串行区内创建, 并行区内通过fftwf_execute_dft作用于各线程自己的缓冲区
+struct fft_line_plan
+{
+	int n{ 0 };
+	fftwf_plan forward{ nullptr };
+	fftwf_plan backward{ nullptr };
+
+	explicit fft_line_plan(int n_) : n(n_)
+	{
+		fft_line tmp(n);
+		unsigned flag = fft_plan_cache::instance().planning();
+		forward  = fftwf_plan_dft_1d(n, tmp.data, tmp.data, FFTW_FORWARD, flag);
+		backward = fftwf_plan_dft_1d(n, tmp.data, tmp.data, FFTW_BACKWARD, flag);
+	}
+	~fft_line_plan()
+	{
+		if(forward) fftwf_destroy_plan(forward);
+		if(backward) fftwf_destroy_plan(backward);
+	}
+	fft_line_plan(const fft_line_plan&) = delete;
+	fft_line_plan& operator=(const fft_line_plan&) = delete;
+};
+
+/// @brief 对缓冲区执行 fft -> 掩膜 -> ifft, 结果已除以n
+void band_pass(const fft_line_plan& plan, const std::vector<float>& mask, fftwf_complex* data)
+{
+	fftwf_execute_dft(plan.forward, data, data);
+	float scale = 1.f / plan.n;
+	for(int k = 0; k < plan.n; k++){
+		float w = mask[k] * scale;
+		data[k][0] *= w;
+		data[k][1] *= w;
+	}
+	fftwf_execute_dft(plan.backward, data, data);
+}
+
+/// @brief 距离向滤波, 对rows行数据逐行处理
+void range_filter(std::complex<float>* arr, int rows, int width, const fft_line_plan& plan, const std::vector<float>& mask)
+{
+#pragma omp parallel
+	{
+		fft_line line(width);
+#pragma omp for schedule(static)
+		for(int i = 0; i < rows; i++){
+			std::complex<float>* row = arr + size_t(i) * width;
+			std::copy(row, row + width, reinterpret_cast<std::complex<float>*>(line.data));
+			band_pass(plan, mask, line.data);
+			std::copy(reinterpret_cast<std::complex<float>*>(line.data), reinterpret_cast<std::complex<float>*>(line.data) + width, row);
+		}
+	}
+}
+
+/// @brief 方位向滤波, 对rows行数据逐列处理, 列长度不足plan.n的部分补零, 各列互相独立, 按列并行
+void azimuth_filter(std::complex<float>* arr, int rows, int width, const fft_line_plan& plan, const std::vector<float>& mask)
+{
+#pragma omp parallel
+	{
+		fft_line line(plan.n);
+		std::complex<float>* col = reinterpret_cast<std::complex<float>*>(line.data);
+#pragma omp for schedule(static)
+		for(int j = 0; j < width; j++){
+			for(int i = 0; i < rows; i++)
+				col[i] = arr[size_t(i) * width + j];
+			std::fill(col + rows, col + plan.n, std::complex<float>(0, 0));
+			band_pass(plan, mask, line.data);
+			for(int i = 0; i < rows; i++)
+				arr[size_t(i) * width + j] = col[i];
+		}
+	}
+}
+
+}
+
+bool common_band::contains(double f) const
+{
+	return std::abs(wrap_freq(f - center)) <= bandwidth / 2;
+}
+
+funcrst cal_common_band(double mas_bw, double mas_freq, double sla_bw, double sla_freq, common_band& band)
+{
+	if(mas_bw <= 0 || sla_bw <= 0)
+		return funcrst(false, fmt::format("cal_common_band, bandwidth should be positive (master: {}, slave: {}).", mas_bw, sla_bw));
+
+	/// 以主影像中心频率为参考, 辅影像中心频率折叠到其附近后再求区间交集
+	double diff = wrap_freq(sla_freq - mas_freq);
+	double low  = MAX(-mas_bw / 2, diff - sla_bw / 2);
+	double high = MIN( mas_bw / 2, diff + sla_bw / 2);
+	if(high <= low)
+		return funcrst(false, fmt::format("cal_common_band, no common band between master ({}, {}) and slave ({}, {}).", mas_bw, mas_freq, sla_bw, sla_freq));
+
+	band.center = wrap_freq(mas_freq + (low + high) / 2);
+	band.bandwidth = MIN(high - low, 1.);
+	return funcrst(true, "cal_common_band finished.");
+}
+
+funcrst interferogram(GDALRasterBand* rb_mas, GDALRasterBand* rb_sla, GDALRasterBand* rb_out,
+	const common_band* az_band, const common_band* rg_band, int strip_height, int halo)
+{
+	if(rb_mas == nullptr || rb_sla == nullptr || rb_out == nullptr)
+		return funcrst(false, "interferogram, rb_mas, rb_sla or rb_out is nullptr.");
+
+	int width = rb_mas->GetXSize();
+	int height = rb_mas->GetYSize();
+	strip_height = MIN(MAX(strip_height, 1), height);
+	if(az_band == nullptr)
+		halo = 0;
+
+	/// plan在串行区创建, 方位向fft长度固定为条带行数+上下halo, 边缘条带补零;
+	/// 方位向使用半长为halo的加窗FIR, 保留的行所需的输入都在halo内, 条带之间没有接缝
+	std::unique_ptr<fft_line_plan> rg_plan, az_plan;
+	std::vector<float> rg_mask, az_mask;
+	if(rg_band != nullptr){
+		rg_plan = std::make_unique<fft_line_plan>(width);
+		rg_mask = band_mask(*rg_band, width);
+	}
+	if(az_band != nullptr){
+		int az_len = strip_height + 2 * halo;
+		az_plan = std::make_unique<fft_line_plan>(az_len);
+		az_mask = fir_band_response(*az_band, halo, az_len);
+	}
+
+	struct strip_data{
+		int in_start{ 0 }, rows{ 0 };
+		std::vector<std::complex<float>> mas, sla;
+	};
+
+	auto read_strip = [&](int block_start, strip_data& data) -> CPLErr
+	{
+		data.in_start = MAX(0, block_start - halo);
+		int in_end = MIN(height, block_start + strip_height + halo);
+		data.rows = in_end - data.in_start;
+		data.mas.resize(size_t(data.rows) * width);
+		data.sla.resize(size_t(data.rows) * width);
+		CPLErr err = rb_mas->RasterIO(GF_Read, 0, data.in_start, width, data.rows, data.mas.data(), width, data.rows, GDT_CFloat32, 0, 0);
+		if(err != CE_None)
+			return err;
+		return rb_sla->RasterIO(GF_Read, 0, data.in_start, width, data.rows, data.sla.data(), width, data.rows, GDT_CFloat32, 0, 0);
+	};
+
+	int strips = (height + strip_height - 1) / strip_height;
+	std::vector<std::complex<float>> arr_out(size_t(strip_height) * width);
+
+	/// 双缓冲: 当前条带滤波与写出的同时, 在另一个线程中读取下一个条带
+	strip_data data_cur, data_next;
+	CPLErr read_err = read_strip(0, data_cur);
+	for(int s = 0; s < strips; s++)
+	{
+		int block_start = s * strip_height;
+		int rows = MIN(strip_height, height - block_start);
+
+		if(read_err != CE_None)
+			return funcrst(false, fmt::format("read strip [{},{}) failed. ({})", block_start, block_start + rows, CPLGetLastErrorMsg()));
+
+		std::future<CPLErr> next;
+		if(s + 1 < strips)
+			next = std::async(std::launch::async, [&, s]{ return read_strip((s + 1) * strip_height, data_next); });
+
+		for(auto* arr : {&data_cur.mas, &data_cur.sla}){
+			if(rg_plan)
+				range_filter(arr->data(), data_cur.rows, width, *rg_plan, rg_mask);
+			if(az_plan)
+				azimuth_filter(arr->data(), data_cur.rows, width, *az_plan, az_mask);
+		}
+
+		/// master * conj(slave), 只输出条带本身的行, halo部分丢弃
+		const std::complex<float>* mas = data_cur.mas.data() + size_t(block_start - data_cur.in_start) * width;
+		const std::complex<float>* sla = data_cur.sla.data() + size_t(block_start - data_cur.in_start) * width;
+		long long count = (long long)rows * width;
+#pragma omp parallel for
+		for(long long idx = 0; idx < count; idx++)
+			arr_out[idx] = mas[idx] * std::conj(sla[idx]);
+
+		CPLErr write_err = rb_out->RasterIO(GF_Write, 0, block_start, width, rows, arr_out.data(), width, rows, GDT_CFloat32, 0, 0);
+
+		if(next.valid()){
+			read_err = next.get();
+			std::swap(data_cur, data_next);
+		}
+
+		if(write_err != CE_None)
+			return funcrst(false, fmt::format("write strip [{},{}) failed. ({})", block_start, block_start + rows, CPLGetLastErrorMsg()));
+
+		std::cout<<fmt::format("\rstrip: {}/{}...", s + 1, strips);
+	}
+	std::cout<<std::endl;
+
+	return funcrst(true, "interferogram finished.");
+}
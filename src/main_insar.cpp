@@ -29,6 +29,34 @@ int main(int argc, char* argv[])
             .help("the power of window, within range [0,1], , default is 0.5. The higher the power, the more pronounced the filtering effect.")
             .scan<'g',double>()
             .default_value("0.5");   
+
+        sub_goldstein.add_argument("-s","--strip")
+            .help("rows of each strip in streaming mode, which will be rounded up to a multiple of step (block - overlap), default is 512. peak memory depends on strip rows rather than image size.")
+            .scan<'i',int>()
+            .default_value("512");
+
+        sub_goldstein.add_argument("-b","--block")
+            .help("block size of fft, within range [8,1024], default is 32.")
+            .scan<'i',int>()
+            .default_value("32");
+
+        sub_goldstein.add_argument("-o","--overlap")
+            .help("overlap between adjacent blocks, within range [0,block), default is 24. larger step (block - overlap) needs fewer fft, e.g. 64/16 needs about 6x fewer fft than 32/24.")
+            .scan<'i',int>()
+            .default_value("24");
+
+        sub_goldstein.add_argument("-t","--taper")
+            .help("how blocks are stitched: crop (keep the center of block), triangle or hann (weighted overlap-add), default is crop.")
+            .choices("crop","triangle","hann")
+            .default_value("crop");
+
+        sub_goldstein.add_argument("--fft_plan")
+            .help("fftw planning method: estimate, measure or patient, default is estimate. measure and patient take longer to plan but run faster, recommended with --wisdom.")
+            .choices("estimate","measure","patient")
+            .default_value("estimate");
+
+        sub_goldstein.add_argument("--wisdom")
+            .help("fftw wisdom filepath, loaded before filtering (if existed) and saved after filtering.");
     }
 
     argparse::ArgumentParser sub_goldstein_zhao("zhao");
@@ -42,6 +70,34 @@ int main(int argc, char* argv[])
 
         sub_goldstein_zhao.add_argument("-a","--alpha_outpath")
             .help("optional output the alpha_output_path, with recorded the aplha used with goldstein in every window");   
+
+        sub_goldstein_zhao.add_argument("-s","--strip")
+            .help("rows of each strip in streaming mode, which will be rounded up to a multiple of step (block - overlap), default is 512.")
+            .scan<'i',int>()
+            .default_value("512");
+
+        sub_goldstein_zhao.add_argument("-b","--block")
+            .help("block size of fft, within range [8,1024], default is 32.")
+            .scan<'i',int>()
+            .default_value("32");
+
+        sub_goldstein_zhao.add_argument("-o","--overlap")
+            .help("overlap between adjacent blocks, within range [0,block), default is 24. larger step (block - overlap) needs fewer fft, e.g. 64/16 needs about 6x fewer fft than 32/24.")
+            .scan<'i',int>()
+            .default_value("24");
+
+        sub_goldstein_zhao.add_argument("-t","--taper")
+            .help("how blocks are stitched: crop (keep the center of block), triangle or hann (weighted overlap-add), default is crop.")
+            .choices("crop","triangle","hann")
+            .default_value("crop");
+
+        sub_goldstein_zhao.add_argument("--fft_plan")
+            .help("fftw planning method: estimate, measure or patient, default is estimate. measure and patient take longer to plan but run faster, recommended with --wisdom.")
+            .choices("estimate","measure","patient")
+            .default_value("estimate");
+
+        sub_goldstein_zhao.add_argument("--wisdom")
+            .help("fftw wisdom filepath, loaded before filtering (if existed) and saved after filtering.");
     }
 
     argparse::ArgumentParser sub_goldstein_baran("baran");
@@ -58,6 +114,34 @@ int main(int argc, char* argv[])
 
         sub_goldstein_baran.add_argument("-a","--alpha_outpath")
             .help("optional output the alpha_output_path, with recorded the aplha used with goldstein in every window");   
+
+        sub_goldstein_baran.add_argument("-s","--strip")
+            .help("rows of each strip in streaming mode, which will be rounded up to a multiple of step (block - overlap), default is 512.")
+            .scan<'i',int>()
+            .default_value("512");
+
+        sub_goldstein_baran.add_argument("-b","--block")
+            .help("block size of fft, within range [8,1024], default is 32.")
+            .scan<'i',int>()
+            .default_value("32");
+
+        sub_goldstein_baran.add_argument("-o","--overlap")
+            .help("overlap between adjacent blocks, within range [0,block), default is 24. larger step (block - overlap) needs fewer fft, e.g. 64/16 needs about 6x fewer fft than 32/24.")
+            .scan<'i',int>()
+            .default_value("24");
+
+        sub_goldstein_baran.add_argument("-t","--taper")
+            .help("how blocks are stitched: crop (keep the center of block), triangle or hann (weighted overlap-add), default is crop.")
+            .choices("crop","triangle","hann")
+            .default_value("crop");
+
+        sub_goldstein_baran.add_argument("--fft_plan")
+            .help("fftw planning method: estimate, measure or patient, default is estimate. measure and patient take longer to plan but run faster, recommended with --wisdom.")
+            .choices("estimate","measure","patient")
+            .default_value("estimate");
+
+        sub_goldstein_baran.add_argument("--wisdom")
+            .help("fftw wisdom filepath, loaded before filtering (if existed) and saved after filtering.");
     }
 
     argparse::ArgumentParser sub_pseudo_correlation("pseudo");
@@ -79,21 +163,43 @@ int main(int argc, char* argv[])
     sub_interf.add_description("conjugate multiplication of data and filtering along azimuth and slant range direction.");
     {
         sub_interf.add_argument("master_data_path")
-            .help("master fcomplex data, with fcomplex datatype.");
+            .help("master slc data, with fcomplex datatype.");
 
         sub_interf.add_argument("slave_data_path")
-            .help("slave fcomplex data, with float datatype.");
-        
+            .help("slave slc data (coregistered with master), with fcomplex datatype.");
+
         sub_interf.add_argument("output_interf_path")
-            .help("output interf data (hase been conjugate multiplicated)."); 
+            .help("output interf data (hase been conjugate multiplicated).");
 
         sub_interf.add_argument("-a","--azimuth_pars")
-            .help("azimuth parameters in the following order: mas_az_bw mas_az_freq sla_az_bw sla_az_freq.");
+            .help("azimuth parameters in the following order: mas_az_bw mas_az_freq sla_az_bw sla_az_freq, in unit of --az_fs (default 1, i.e. normalized by prf).")
+            .scan<'g',double>()
+            .nargs(4);
 
         sub_interf.add_argument("-r","--range_pars")
-            .help("slant-range parameters in the following order: mas_rg_bw mas_rg_freq sla_rg_bw sla_rg_freq.");
+            .help("slant-range parameters in the following order: mas_rg_bw mas_rg_freq sla_rg_bw sla_rg_freq, in unit of --rg_fs (default 1, i.e. normalized by range sampling rate).")
+            .scan<'g',double>()
+            .nargs(4);
 
-    /// TODO: 创建相关的函数
+        sub_interf.add_argument("--az_fs")
+            .help("azimuth sampling frequency (prf) used to normalize --azimuth_pars, default is 1.")
+            .scan<'g',double>()
+            .default_value("1");
+
+        sub_interf.add_argument("--rg_fs")
+            .help("range sampling frequency used to normalize --range_pars, default is 1.")
+            .scan<'g',double>()
+            .default_value("1");
+
+        sub_interf.add_argument("-s","--strip")
+            .help("rows of each strip in streaming mode, default is 1024. peak memory depends on strip rows rather than image size.")
+            .scan<'i',int>()
+            .default_value("1024");
+
+        sub_interf.add_argument("--halo")
+            .help("half length of the hamming windowed azimuth band-pass filter (2 * halo + 1 taps), which is also the rows read above and below each strip, default is 64.")
+            .scan<'i',int>()
+            .default_value("64");
     }
 
     argparse::ArgumentParser sub_8bitdata("8bitdata");
@@ -103,23 +209,32 @@ int main(int argc, char* argv[])
             .help("valid datatype include short, float, scomplex, fcomplex.");
 
         sub_8bitdata.add_argument("output_path")
-            .help(" valid extension include, .tif(1b+ct), .bmp(1b+ct), .jpg(4b), .png(4b)."); 
+            .help(" valid extension include, .tif(1b+ct), .bmp(1b+ct), .jpg(3b), .png(4b).");
 
         sub_8bitdata.add_argument("scale")
-            .help("dst_value = scale * (src_value - average)^ ex")
+            .help("dst_value = scale * (src_value / average)^ ex, the average is mapped to mid-gray. (only for power)")
             .scan<'g',double>()
             .default_value("1");
 
         sub_8bitdata.add_argument("ex")
-            .help("dst_value = scale * (src_value - average)^ ex")
+            .help("dst_value = scale * (src_value / average)^ ex, the average is mapped to mid-gray. (only for power)")
             .scan<'g',double>()
             .default_value("0.35");
 
         sub_8bitdata.add_argument("-t","--type")
-            .help("this parameter is useful, only when datatype of input_path is complex.")
-            .choices("power","phase");
+            .help("this parameter is useful, only when datatype of input_path is complex, default is power.")
+            .choices("power","phase")
+            .default_value("power");
+
+        sub_8bitdata.add_argument("-m","--max_size")
+            .help("maximum width or height of the quick-look, the input is decimated when larger, 0 means full resolution, default is 2048.")
+            .scan<'i',int>()
+            .default_value("2048");
 
-    /// TODO: 创建相关的函数
+        sub_8bitdata.add_argument("-r","--resample")
+            .help("resample method of decimated read: nearest (fastest, use overviews if existed) or average, default is nearest.")
+            .choices("nearest","average")
+            .default_value("nearest");
     }
 
 
@@ -130,6 +245,8 @@ int main(int argc, char* argv[])
         {&sub_goldstein_zhao,       filter_goldstein_zhao},
         {&sub_goldstein_baran,      filter_goldstein_baran},
         {&sub_pseudo_correlation,   pseudo_correlation},
+        {&sub_interf,               interf_generate},
+        {&sub_8bitdata,             create_8bitdata},
     };
 
     for(auto prog_map : parser_map_func){
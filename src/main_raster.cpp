@@ -64,15 +64,30 @@ int main(int argc, char* argv[])
     }
 
     argparse::ArgumentParser sub_statistics("stat_minmax", "", argparse::default_arguments::help);
-    sub_statistics.add_description("statistics min, max, ave, std of the specified band of a image.");
+    sub_statistics.add_description("statistics min, max, ave, std (and optional quantiles) of the specified band or all bands of a image.");
     {
         sub_statistics.add_argument("img_filepath")
             .help("raster image filepath.");
 
         sub_statistics.add_argument("band")
-            .help("band, default is 1.")
+            .help("band, default is 1, 0 means all bands (in one pass).")
             .scan<'i',int>()
             .default_value("1");
+
+        sub_statistics.add_argument("-q","--quantiles")
+            .help("optional quantiles within [0,1], e.g. '-q 0.02 0.5 0.98'.")
+            .scan<'g',double>()
+            .nargs(argparse::nargs_pattern::at_least_one);
+
+        sub_statistics.add_argument("--approx")
+            .help("approximate statistics, read overview if existed, otherwise read one of every 'sample_step' blocks.")
+            .implicit_value(true)
+            .default_value(false);
+
+        sub_statistics.add_argument("--sample_step")
+            .help("used with --approx when the image has no overview, default is 10.")
+            .scan<'i',int>()
+            .default_value("10");
     }
 
     argparse::ArgumentParser sub_histogram_stretch("stretch_hist", "", argparse::default_arguments::help);
@@ -110,6 +125,32 @@ int main(int argc, char* argv[])
 
         sub_vrt_to_tif.add_argument("tif")
             .help("output image filepath (*.tif)");    
+
+        sub_vrt_to_tif.add_argument("-b","--block")
+            .help("tile size of output tif, 0 means striped tif, default is 256.")
+            .scan<'i',int>()
+            .default_value("256");
+
+        sub_vrt_to_tif.add_argument("-c","--compress")
+            .help("compression of output tif: none, deflate, zstd or lzw, default is none.")
+            .choices("none","deflate","zstd","lzw")
+            .default_value("none");
+
+        sub_vrt_to_tif.add_argument("-p","--predictor")
+            .help("predictor used with compression, 0 means auto (2 for integer, 3 for float, 1 for complex), default is 0.")
+            .scan<'i',int>()
+            .choices("0","1","2","3")
+            .default_value("0");
+
+        sub_vrt_to_tif.add_argument("--bigtiff")
+            .help("BIGTIFF creation option: yes, no, if_needed or if_safer, default is if_safer.")
+            .choices("yes","no","if_needed","if_safer")
+            .default_value("if_safer");
+
+        sub_vrt_to_tif.add_argument("-t","--threads")
+            .help("threads for reading and compressing, 0 means all cpus, default is 0.")
+            .scan<'i',int>()
+            .default_value("0");
     }
 
     argparse::ArgumentParser sub_tif_to_vrt("tif2vrt", "", argparse::default_arguments::help);
@@ -124,10 +165,15 @@ int main(int argc, char* argv[])
         sub_tif_to_vrt.add_argument("ByteOrder")
             .help("MSB(Most Significant Bit) or LSB(Least Significant Bit)")
             .default_value("MSB");
+
+        sub_tif_to_vrt.add_argument("--direct_io")
+            .help("write binary with direct io (bypass the system cache), for data much larger than memory.")
+            .implicit_value(true)
+            .default_value(false);
     }
 
     argparse::ArgumentParser sub_over_resample("resample", "", argparse::default_arguments::help);
-    sub_over_resample.add_description("over resample by gdalwarp.");
+    sub_over_resample.add_description("over resample by gdalwarp, the output is split into tiles which are warped by multiple threads.");
     {
         sub_over_resample.add_argument("input_imgpath")
             .help("input image filepath");
@@ -143,7 +189,43 @@ int main(int argc, char* argv[])
             .help("over-resample method, use int to represent method : 0,nearst; 1,bilinear; 2,cubic; 3,cubicSpline; 4,lanczos(sinc).; 5,average.")
             .scan<'i',int>()
             .default_value("1")
-            .choices("0","1","2","3","4","5");       
+            .choices("0","1","2","3","4","5");
+
+        sub_over_resample.add_argument("--chunk")
+            .help("output is split into chunk * chunk tiles which are warped in parallel, should be a multiple of '--block' if tiled, default is 1024.")
+            .scan<'i',int>()
+            .default_value("1024");
+
+        sub_over_resample.add_argument("-m","--memory")
+            .help("warp memory limit (MB) shared by all threads, default is 512.")
+            .scan<'g',double>()
+            .default_value("512");
+
+        sub_over_resample.add_argument("-t","--threads")
+            .help("threads for warping tiles, 0 means all cpus, default is 0.")
+            .scan<'i',int>()
+            .default_value("0");
+
+        sub_over_resample.add_argument("-b","--block")
+            .help("tile size of output tif, 0 means striped tif, default is 0.")
+            .scan<'i',int>()
+            .default_value("0");
+
+        sub_over_resample.add_argument("-c","--compress")
+            .help("compression of output tif: none, deflate, zstd or lzw, default is none.")
+            .choices("none","deflate","zstd","lzw")
+            .default_value("none");
+
+        sub_over_resample.add_argument("-p","--predictor")
+            .help("predictor used with compression, 0 means auto (2 for integer, 3 for float, 1 for complex), default is 0.")
+            .scan<'i',int>()
+            .choices("0","1","2","3")
+            .default_value("0");
+
+        sub_over_resample.add_argument("--bigtiff")
+            .help("BIGTIFF creation option: yes, no, if_needed or if_safer, default is if_safer.")
+            .choices("yes","no","if_needed","if_safer")
+            .default_value("if_safer");
     }
 
     argparse::ArgumentParser sub_trans_geoinfo("trans_geo", "", argparse::default_arguments::help);
@@ -217,6 +299,20 @@ int main(int argc, char* argv[])
 
         sub_data_to_8bit.add_argument("extension")
             .help("extension, support jpg, png, bmp and tif");
+
+        sub_data_to_8bit.add_argument("-r","--range")
+            .help("value range used to map to [0,255]: band (min/max of each band) or global (min/max of all bands), default is band.")
+            .choices("band","global")
+            .default_value("band");
+
+        sub_data_to_8bit.add_argument("-s","--stretch_rate")
+            .help("optional, remove the extreme values at both ends by proportion before mapping, within (0,0.5), e.g. 0.02. byte data is copied unchanged without it.")
+            .scan<'g',double>();
+
+        sub_data_to_8bit.add_argument("--approx")
+            .help("approximate min/max (and stretch) from overviews if existed (see 'build_overviews'), otherwise from one of every 10 blocks.")
+            .implicit_value(true)
+            .default_value(false);
     }
 
     argparse::ArgumentParser sub_grid_interp("grid_interp", "", argparse::default_arguments::help);
@@ -302,6 +398,28 @@ int main(int argc, char* argv[])
        
     }
 
+    argparse::ArgumentParser sub_build_overviews("build_overviews", "", argparse::default_arguments::help);
+    sub_build_overviews.add_description("build internal or external overviews (pyramids) of all bands, each level is resampled from the previous level.");
+    {
+        sub_build_overviews.add_argument("img_path")
+            .help("image filepath, overviews of all bands will be rebuilt, complex bands are resampled as complex values.");
+
+        sub_build_overviews.add_argument("-l","--levels")
+            .help("overview levels, powers of 2 in ascending order, e.g. '-l 2 4 8 16', default is 2, 4, ... until the overview is smaller than 256 pixels.")
+            .scan<'i',int>()
+            .nargs(argparse::nargs_pattern::at_least_one);
+
+        sub_build_overviews.add_argument("-r","--resample")
+            .help("resampling kernel: nearest, average, gauss or mode, default is average.")
+            .choices("nearest","average","gauss","mode")
+            .default_value("average");
+
+        sub_build_overviews.add_argument("--external")
+            .help("write overviews into an external '.ovr' file, the image itself is opened read-only.")
+            .implicit_value(true)
+            .default_value(false);
+    }
+
     argparse::ArgumentParser sub_triangle("triangle", "", argparse::default_arguments::help);
     sub_triangle.add_description("input mask image to generate triangle, and output with specify format.");
     {
@@ -351,6 +469,7 @@ int main(int argc, char* argv[])
         {&sub_triangle,             triangle_network},
         {&sub_quadtree,             create_quadtree},
         {&sub_jpg2png,              jpg_to_png},
+        {&sub_build_overviews,      build_overviews},
     };
 
     for(auto prog_map : parser_map_func){
@@ -12,6 +12,7 @@
 #include <spdlog/sinks/basic_file_sink.h>
 
 #include "template_nan_convert_to.h"
+#include "raster_copy.h"
 
 using namespace std;
 namespace fs = std::filesystem;
@@ -72,47 +73,55 @@ int main(int argc, char* argv[])
     string input = program.get<string>("input_image");
     string output= program.get<string>("output_image");
 
-    /// 如果
-    if(input!= output){
-        fs::path src(input);
-        fs::path dst(output);
-        if(fs::exists(dst)){
-            msg = "output is existed, we will remove and copy input to output.";
+    /// 输入输出相同时原地处理, 否则只读打开输入, 以输入的驱动与创建参数新建输出并直接写入, 不再复制输入文件
+    bool in_place = input == output;
+    GDALDataset* ds_in = static_cast<GDALDataset*>(GDALOpen(input.c_str(), in_place ? GA_Update : GA_ReadOnly));
+    if(ds_in == nullptr)
+        return return_msg(-2,"ds_in is nullptr.");
+
+    GDALDataType datatype = ds_in->GetRasterBand(1)->GetRasterDataType();
+
+    GDALDataset* ds_out = ds_in;
+    if(!in_place){
+        if(fs::exists(output)){
+            msg = "output is existed, we will remove it.";
             return_msg(0,msg);
-            fs::remove(dst);
+            fs::remove(output);
+        }
+        string err;
+        ds_out = create_like(ds_in, output, err);
+        if(ds_out == nullptr){
+            GDALClose(ds_in);
+            return return_msg(-2,"ds_out is nullptr, " + err);
         }
-        fs::copy(src,dst);
     }
 
-    GDALDataset* ds = static_cast<GDALDataset*>(GDALOpen(output.c_str(), GA_Update));
-    if(ds == nullptr)
-        return return_msg(-2,"ds is nullptr. output is no-existed(when input==output), or cann't be create?");
-
-    int xsize = ds->GetRasterXSize();
-    int ysize = ds->GetRasterYSize();
-    int bands = ds->GetRasterCount();
-    GDALDataType datatype = ds->GetRasterBand(1)->GetRasterDataType();
-
-    tuple_bs rtn_msg;
+    funcrst rst;
     switch (datatype)
     {
     case GDT_Float32:
-        rtn_msg = nodata_transto(ds,float(val));
+        rst = nodata_transto(ds_in,ds_out,float(val));
         break;
     case GDT_Float64:
-        rtn_msg = nodata_transto(ds,val);
+        rst = nodata_transto(ds_in,ds_out,val);
         break;
     case GDT_Int16:
-        rtn_msg = value_transto(ds,short(-32767),short(val));
+        rst = value_transto(ds_in,ds_out,short(-32767),short(val));
         break;
     case GDT_Int32:
-        rtn_msg = value_transto(ds,-32767,int(val));
+        rst = value_transto(ds_in,ds_out,-32767,int(val));
         break;
     default:
-        return return_msg(-3,"unsupport datatype.");
+        rst = funcrst(false, "unsupport datatype.");
+        break;
     }
-    
-    GDALClose(ds);
+
+    if(ds_out != ds_in)
+        GDALClose(ds_out);
+    GDALClose(ds_in);
+    if(!rst)
+        return return_msg(-3,rst.explain);
+
     return return_msg(1,"\nnan_TransTo succeed.");
 
 }
@@ -4,13 +4,17 @@
 #include <gdal_priv.h>
 #include <ogrsf_frmts.h>
 #include <gdalwarper.h>
+
+#include <omp.h>
+#include <mutex>
+#include <atomic>
 /*
         sub_over_resample.add_argument("input_imgpath")
             .help("input image filepath");
 
         sub_over_resample.add_argument("output_imgpath")
             .help("output image filepath");
-            
+
         sub_over_resample.add_argument("scale")
             .help("scale of over-resample.")
             .scan<'g',double>();
@@ -18,41 +22,111 @@
          sub_over_resample.add_argument("method")
             .help("over-resample method, use int to represent method : 0,nearst; 1,bilinear; 2,cubic; 3,cubicSpline; 4,lanczos(sinc).; 5,average.")
             .scan<'i',int>()
-            .default_value("1");     
+            .default_value("1");
+
+        sub_over_resample.add_argument("--chunk")
+            .help("output is split into chunk * chunk tiles which are warped in parallel, should be a multiple of '--block' if tiled, default is 1024.")
+            .scan<'i',int>()
+            .default_value("1024");
+
+        sub_over_resample.add_argument("-m","--memory")
+            .help("warp memory limit (MB) shared by all threads, default is 512.")
+            .scan<'g',double>()
+            .default_value("512");
+
+        sub_over_resample.add_argument("-t","--threads")
+            .help("threads for warping tiles, 0 means all cpus, default is 0.")
+            .scan<'i',int>()
+            .default_value("0");
+
+        sub_over_resample.add_argument("-b","--block")
+            .help("tile size of output tif, 0 means striped tif, default is 0.")
+            .scan<'i',int>()
+            .default_value("0");
+
+        sub_over_resample.add_argument("-c","--compress")
+            .help("compression of output tif: none, deflate, zstd or lzw, default is none.")
+            .choices("none","deflate","zstd","lzw")
+            .default_value("none");
+
+        sub_over_resample.add_argument("-p","--predictor")
+            .help("predictor used with compression, 0 means auto (2 for integer, 3 for float, 1 for complex), default is 0.")
+            .scan<'i',int>()
+            .choices("0","1","2","3")
+            .default_value("0");
+
+        sub_over_resample.add_argument("--bigtiff")
+            .help("BIGTIFF creation option: yes, no, if_needed or if_safer, default is if_safer.")
+            .choices("yes","no","if_needed","if_safer")
+            .default_value("if_safer");
 */
 
-funcrst gdal_image_resample_warp(const char *pszSrcFile, const char *pszDstFile,
-                                                     double scale,
-                                                     GDALResampleAlg eResampleMethod = GRA_NearestNeighbour);
+struct resample_options{
+    double scale;
+    GDALResampleAlg method{ GRA_NearestNeighbour };
+    int chunk{ 1024 };              ///< 输出按chunk * chunk分块, 各块由线程池并行重采样
+    double memory_mb{ 512 };        ///< 所有线程共用的warp内存上限(MB)
+    int threads{ 0 };               ///< 0表示全部cpu
+    int block{ 0 };                 ///< 输出tif的分块大小, 0表示条带
+    std::string compress{ "NONE" };
+    int predictor{ 0 };
+    std::string bigtiff{ "IF_SAFER" };
+};
+
+funcrst gdal_image_resample_warp(const char *pszSrcFile, const char *pszDstFile, resample_options opt, double* megapixels);
 
 int over_resample(argparse::ArgumentParser* args,std::shared_ptr<spdlog::logger> logger)
 {
-    double scale = args->get<double>("scale");
-    int method_int = args->get<int>("method");
+    resample_options opt;
+    opt.scale = args->get<double>("scale");
+    opt.method = GDALResampleAlg(args->get<int>("method"));
+    opt.chunk = args->get<int>("--chunk");
+    opt.memory_mb = args->get<double>("--memory");
+    opt.threads = args->get<int>("--threads");
+    opt.block = args->get<int>("--block");
+    opt.compress = args->get<string>("--compress");
+    opt.predictor = args->get<int>("--predictor");
+    opt.bigtiff = args->get<string>("--bigtiff");
+    std::transform(opt.compress.begin(), opt.compress.end(), opt.compress.begin(), ::toupper);
+    std::transform(opt.bigtiff.begin(), opt.bigtiff.end(), opt.bigtiff.begin(), ::toupper);
     string input_filepath = args->get<string>("input_imgpath");
     string output_filepath = args->get<string>("output_imgpath");
-    GDALResampleAlg eResampleMethod = GDALResampleAlg(method_int);
 
-    auto rst = gdal_image_resample_warp(input_filepath.c_str(), output_filepath.c_str(), scale, eResampleMethod);
+    if(opt.scale <= 0){
+        PRINT_LOGGER(logger, error, fmt::format("scale ({}) should be positive.", opt.scale));
+        return -1;
+    }
+    if(opt.block < 0 || opt.block % 16 != 0){
+        PRINT_LOGGER(logger, error, fmt::format("block ({}) should be 0 or a multiple of 16.", opt.block));
+        return -1;
+    }
+    if(opt.chunk < 1 || (opt.block > 0 && opt.chunk % opt.block != 0)){
+        PRINT_LOGGER(logger, error, fmt::format("chunk ({}) should be positive and a multiple of block ({}).", opt.chunk, opt.block));
+        return -1;
+    }
+
+    auto start_time = std::chrono::system_clock::now();
+    double megapixels = 0;
+    auto rst = gdal_image_resample_warp(input_filepath.c_str(), output_filepath.c_str(), opt, &megapixels);
     if(!rst){
         PRINT_LOGGER(logger, error, fmt::format("gdal_image_resample_warp failed, cause : '{}'", rst.explain));
         return -1;
     }
+    double seconds = spend_time(start_time);
     PRINT_LOGGER(logger, info, rst.explain);
-    PRINT_LOGGER(logger, info, "over_resample success.");
+    PRINT_LOGGER(logger, info, fmt::format("over_resample success, {:.2f} Mpixels (output) in {:.3f}s, {:.2f} Mpixels/s.",
+        megapixels, seconds, megapixels / MAX(seconds, 1e-6)));
     return 1;
 }
 
-funcrst gdal_image_resample_warp(const char *pszSrcFile, const char *pszDstFile,
-                                                     double scale,
-                                                     GDALResampleAlg eResampleMethod)
-{    
+funcrst gdal_image_resample_warp(const char *pszSrcFile, const char *pszDstFile, resample_options opt, double* megapixels)
+{
 
     GDALAllRegister();
     CPLSetConfigOption("GDAL_FILENAME_IS_UTF8", "NO");
-    CPLErr cpl_err;
 
-    GDALDataset* pSrcDS = static_cast<GDALDataset*>(GDALOpen(pszSrcFile,/*GA_ReadOnly*/GA_Update));
+    /// 原始影像只读, 不再修改其地理变换参数
+    GDALDataset* pSrcDS = static_cast<GDALDataset*>(GDALOpen(pszSrcFile, GA_ReadOnly));
     if(pSrcDS == nullptr){
         return funcrst(false, "pSrcDS is nullptr");
     }
@@ -63,100 +137,188 @@ funcrst gdal_image_resample_warp(const char *pszSrcFile, const char *pszDstFile,
     int iSrcHeight = pSrcDS->GetRasterYSize();
 
     //根据采样比例计算重采样后的图像宽高
-    int iDstWidth = static_cast<int>(iSrcWidth * scale +0.5);
-    int iDstHeight = static_cast<int>(iSrcHeight * scale +0.5);
-
-    char *pszSrcWKT = nullptr;
-    pszSrcWKT = const_cast<char *>(pSrcDS->GetProjectionRef());
-
-    double adfGeoTransform[6]={0};
-    pSrcDS->GetGeoTransform(adfGeoTransform);
-    bool bNoGeoRef=false;
-    double dOldGeoTrans0 = adfGeoTransform[0];
-    cout<<"srcGT6:";
-    for(int i=0; i<6; i++){cout<<adfGeoTransform[i]<<", ";}
-    cout<<endl;
-    if(strlen(pszSrcWKT)<=0){
-        //如果没有投影坐标系则修改坐标系的一个值，使它不等于{0,1,0,0,0,1}，并在最后为重采样后的数据修改为原值
-        //修改的是X方向的起始偏移量
-
-        // adfGeoTransform[0]=1.0;
-        adfGeoTransform[5]=-1.0;
-        cpl_err = pSrcDS->SetGeoTransform(adfGeoTransform);
-        bNoGeoRef=true;
-    }
+    int iDstWidth = MAX(1, static_cast<int>(iSrcWidth * opt.scale +0.5));
+    int iDstHeight = MAX(1, static_cast<int>(iSrcHeight * opt.scale +0.5));
+
+    /// 没有地理变换参数时以像素坐标作为地理坐标({0,1,0,0,0,1}), 仅用于构建坐标转换, 不写入输出
+    double adfSrcGeoTransform[6] = {0, 1, 0, 0, 0, 1};
+    bool bGeoRef = pSrcDS->GetGeoTransform(adfSrcGeoTransform) == CE_None;
+    std::string src_wkt = pSrcDS->GetProjectionRef();
 
     //计算采样后的图像分辨率
-    double dOldGeoTrans1 = adfGeoTransform[1];
-    double dOldGeoTrans5 = adfGeoTransform[5];
-    adfGeoTransform[1] /= scale;
-    adfGeoTransform[5] /= scale;
+    double adfGeoTransform[6];
+    std::copy(adfSrcGeoTransform, adfSrcGeoTransform + 6, adfGeoTransform);
+    adfGeoTransform[1] = adfSrcGeoTransform[1] * iSrcWidth / iDstWidth;
+    adfGeoTransform[2] = adfSrcGeoTransform[2] * iSrcHeight / iDstHeight;
+    adfGeoTransform[4] = adfSrcGeoTransform[4] * iSrcWidth / iDstWidth;
+    adfGeoTransform[5] = adfSrcGeoTransform[5] * iSrcHeight / iDstHeight;
+
+    std::vector<int> has_nodata(iBandCount, 0);
+    std::vector<double> nodata(iBandCount, 0);
+    for(int b = 1; b <= iBandCount; b++)
+        nodata[b - 1] = pSrcDS->GetRasterBand(b)->GetNoDataValue(&has_nodata[b - 1]);
+    GDALClose((GDALDatasetH)pSrcDS);
 
     //创建输出文件并设置空间参考和坐标信息
-    GDALDriver* poDriver = GetGDALDriverManager()->GetDriverByName("GTiff");
-    GDALDataset* pDstDS = poDriver->Create(pszDstFile, iDstWidth, iDstHeight, iBandCount, eDT, NULL);
-    pDstDS->SetGeoTransform(adfGeoTransform);
-    pDstDS->SetProjection(pSrcDS->GetProjectionRef());
-
-    //构建坐标转换关系
-    void *hTransformArg = nullptr;
-    hTransformArg = GDALCreateGenImgProjTransformer2((GDALDatasetH)pSrcDS, (GDALDatasetH)pDstDS, NULL);
-    if(hTransformArg == nullptr){
-        GDALClose((GDALDatasetH)pSrcDS);
-        GDALClose((GDALDatasetH)pDstDS);
-        return funcrst(false, "GDALCreateGenImgProjTransformer2 error"); //Error -3, GDALCreateGenImgProjTransformer2 error
+    int threads = opt.threads > 0 ? opt.threads : omp_get_num_procs();
+    int predictor = opt.predictor;
+    if(predictor == 0)
+        predictor = GDALDataTypeIsComplex(eDT) ? 1 : (GDALDataTypeIsFloating(eDT) ? 3 : 2);
+    char** options = nullptr;
+    if(opt.block > 0){
+        options = CSLSetNameValue(options, "TILED", "YES");
+        options = CSLSetNameValue(options, "BLOCKXSIZE", std::to_string(opt.block).c_str());
+        options = CSLSetNameValue(options, "BLOCKYSIZE", std::to_string(opt.block).c_str());
     }
-
-    GDALTransformerFunc pfnTransformer = GDALGenImgProjTransform;
-
-    //构造GDALWarp的变换选项
-    GDALWarpOptions *psWO = GDALCreateWarpOptions();
-
-    psWO->papszWarpOptions = CSLDuplicate(NULL);
-    psWO->eWorkingDataType = eDT;
-    psWO->eResampleAlg = eResampleMethod;
-
-    psWO->hSrcDS = (GDALDatasetH)pSrcDS;
-    psWO->hDstDS = (GDALDatasetH)pDstDS;
-
-    psWO->pfnTransformer = pfnTransformer;
-    psWO->pTransformerArg = hTransformArg;
-
-//    psWO->pfnProgress = ALGTermProgress;
-//    psWO->pProgressArg = pProcess;
-
-    psWO->nBandCount = iBandCount;
-    psWO->panSrcBands = (int*) CPLMalloc(psWO->nBandCount * sizeof (int));
-    psWO->panDstBands = (int*) CPLMalloc(psWO->nBandCount * sizeof (int));
-    for(int i=0;i<iBandCount;i++){
-        psWO->panSrcBands[i] = i+1;
-        psWO->panDstBands[i] = i+1;
+    if(opt.compress != "NONE"){
+        options = CSLSetNameValue(options, "COMPRESS", opt.compress.c_str());
+        options = CSLSetNameValue(options, "PREDICTOR", std::to_string(predictor).c_str());
+        options = CSLSetNameValue(options, "NUM_THREADS", std::to_string(threads).c_str());
     }
+    options = CSLSetNameValue(options, "BIGTIFF", opt.bigtiff.c_str());
 
-    //创建GDALWarp执行对象并使用GDALWarpOptions来进行初始化
-    GDALWarpOperation oWO;
-    oWO.Initialize(psWO);
-
-    //执行处理
-    oWO.ChunkAndWarpImage(0, 0, iDstWidth, iDstHeight);
-
-    //释放资源和关闭文件
-    GDALDestroyGenImgProjTransformer(psWO->pTransformerArg);
-    GDALDestroyWarpOptions(psWO);
-
-    if(bNoGeoRef){
-        adfGeoTransform[0] = dOldGeoTrans0;
+    GDALDriver* poDriver = GetGDALDriverManager()->GetDriverByName("GTiff");
+    GDALDataset* pDstDS = poDriver->Create(pszDstFile, iDstWidth, iDstHeight, iBandCount, eDT, options);
+    CSLDestroy(options);
+    if(pDstDS == nullptr){
+        return funcrst(false, fmt::format("pDstDS is nullptr, {}", CPLGetLastErrorMsg()));
+    }
+    if(bGeoRef)
         pDstDS->SetGeoTransform(adfGeoTransform);
+    pDstDS->SetProjection(src_wkt.c_str());
+    for(int b = 1; b <= iBandCount; b++){
+        if(has_nodata[b - 1])
+            pDstDS->GetRasterBand(b)->SetNoDataValue(nodata[b - 1]);
+    }
 
-        adfGeoTransform[1] = dOldGeoTrans1;
-        adfGeoTransform[5] = dOldGeoTrans5;
-        pSrcDS->SetGeoTransform(adfGeoTransform);
+    /// 输出按chunk分块, 各线程使用独立的源数据集句柄与GDALWarpOperation, 把块重采样到内存数据集后再写出;
+    /// 线程数少于块数时, 剩余的线程由GDAL warp内部的NUM_THREADS使用
+    int tiles_x = (iDstWidth + opt.chunk - 1) / opt.chunk;
+    int tiles_y = (iDstHeight + opt.chunk - 1) / opt.chunk;
+    int num = tiles_x * tiles_y;
+    int workers = MAX(1, MIN(threads, num));
+    int warp_threads = MAX(1, threads / workers);
+    double memory_limit = opt.memory_mb * 1024 * 1024 / workers;
+    int datasize = GDALGetDataTypeSizeBytes(eDT);
+
+    GDALDriver* dri_mem = GetGDALDriverManager()->GetDriverByName("MEM");
+    std::mutex mutex_write;
+    std::atomic<bool> failed(false);
+    std::atomic<int> finished(0);
+    std::string err_msg;
+    auto set_failed = [&](std::string msg){
+        std::lock_guard<std::mutex> lock(mutex_write);
+        if(!failed.exchange(true))
+            err_msg = msg;
+    };
+
+#pragma omp parallel num_threads(workers)
+    {
+        GDALDataset* ds_thread = static_cast<GDALDataset*>(GDALOpen(pszSrcFile, GA_ReadOnly));
+        if(ds_thread == nullptr)
+            set_failed("open source image failed in thread.");
+        std::vector<unsigned char> arr;
+
+#pragma omp for schedule(dynamic)
+        for(int t = 0; t < num; t++)
+        {
+            if(failed)
+                continue;
+            int x0 = (t % tiles_x) * opt.chunk, y0 = (t / tiles_x) * opt.chunk;
+            int xsize = MIN(opt.chunk, iDstWidth - x0), ysize = MIN(opt.chunk, iDstHeight - y0);
+
+            /// 块的地理变换参数: 输出的地理变换平移到块的左上角
+            double adfTileGeoTransform[6];
+            std::copy(adfGeoTransform, adfGeoTransform + 6, adfTileGeoTransform);
+            adfTileGeoTransform[0] += x0 * adfGeoTransform[1] + y0 * adfGeoTransform[2];
+            adfTileGeoTransform[3] += x0 * adfGeoTransform[4] + y0 * adfGeoTransform[5];
+
+            GDALDataset* ds_tile = dri_mem->Create("", xsize, ysize, iBandCount, eDT, nullptr);
+            //构建坐标转换关系, 只做重采样, 不做投影变换
+            void *hTransformArg = GDALCreateGenImgProjTransformer3(nullptr, adfSrcGeoTransform, nullptr, adfTileGeoTransform);
+            if(ds_tile == nullptr || hTransformArg == nullptr){
+                if(ds_tile)
+                    GDALClose((GDALDatasetH)ds_tile);
+                set_failed("create tile dataset or GDALCreateGenImgProjTransformer3 failed.");
+                continue;
+            }
+
+            //构造GDALWarp的变换选项, 是否使用nodata以第1个波段为准
+            GDALWarpOptions *psWO = GDALCreateWarpOptions();
+            psWO->papszWarpOptions = CSLSetNameValue(nullptr, "NUM_THREADS", std::to_string(warp_threads).c_str());
+            psWO->papszWarpOptions = CSLSetNameValue(psWO->papszWarpOptions, "INIT_DEST", has_nodata[0] ? "NO_DATA" : "0");
+            psWO->eWorkingDataType = eDT;
+            psWO->eResampleAlg = opt.method;
+            psWO->dfWarpMemoryLimit = memory_limit;
+
+            psWO->hSrcDS = (GDALDatasetH)ds_thread;
+            psWO->hDstDS = (GDALDatasetH)ds_tile;
+
+            psWO->pfnTransformer = GDALGenImgProjTransform;
+            psWO->pTransformerArg = hTransformArg;
+
+            psWO->nBandCount = iBandCount;
+            psWO->panSrcBands = (int*) CPLMalloc(psWO->nBandCount * sizeof (int));
+            psWO->panDstBands = (int*) CPLMalloc(psWO->nBandCount * sizeof (int));
+            for(int i=0;i<iBandCount;i++){
+                psWO->panSrcBands[i] = i+1;
+                psWO->panDstBands[i] = i+1;
+            }
+            if(has_nodata[0]){
+                psWO->padfSrcNoDataReal = (double*) CPLMalloc(psWO->nBandCount * sizeof (double));
+                psWO->padfDstNoDataReal = (double*) CPLMalloc(psWO->nBandCount * sizeof (double));
+                for(int i=0;i<iBandCount;i++){
+                    psWO->padfSrcNoDataReal[i] = nodata[i];
+                    psWO->padfDstNoDataReal[i] = nodata[i];
+                }
+            }
+
+            //创建GDALWarp执行对象并使用GDALWarpOptions来进行初始化, 块内再按内存上限分块执行
+            GDALWarpOperation oWO;
+            CPLErr err = oWO.Initialize(psWO);
+            if(err == CE_None)
+                err = oWO.ChunkAndWarpImage(0, 0, xsize, ysize);
+
+            GSpacing band_space = GSpacing(xsize) * ysize * datasize;
+            if(err == CE_None){
+                arr.resize(size_t(band_space) * iBandCount);
+                err = ds_tile->RasterIO(GF_Read, 0, 0, xsize, ysize, arr.data(), xsize, ysize, eDT,
+                    iBandCount, nullptr, datasize, GSpacing(xsize) * datasize, band_space, nullptr);
+            }
+
+            //释放资源
+            GDALDestroyGenImgProjTransformer(psWO->pTransformerArg);
+            GDALDestroyWarpOptions(psWO);
+            GDALClose((GDALDatasetH)ds_tile);
+
+            if(err != CE_None){
+                set_failed(fmt::format("warp tile [{},{},{},{}] failed, {}", x0, y0, xsize, ysize, CPLGetLastErrorMsg()));
+                continue;
+            }
+
+            /// 输出数据集不是线程安全的, 写入在锁内执行; chunk为block的整数倍, 每次写入的都是完整的分块
+            std::lock_guard<std::mutex> lock(mutex_write);
+            err = pDstDS->RasterIO(GF_Write, x0, y0, xsize, ysize, arr.data(), xsize, ysize, eDT,
+                iBandCount, nullptr, datasize, GSpacing(xsize) * datasize, band_space, nullptr);
+            if(err != CE_None){
+                if(!failed.exchange(true))
+                    err_msg = fmt::format("write tile [{},{},{},{}] failed, {}", x0, y0, xsize, ysize, CPLGetLastErrorMsg());
+                continue;
+            }
+            GDALTermProgress(double(++finished) / num, nullptr, nullptr);
+        }
+
+        if(ds_thread)
+            GDALClose((GDALDatasetH)ds_thread);
     }
-    GDALFlushCache(pDstDS);
 
-    GDALClose((GDALDatasetH)pSrcDS);
     GDALClose((GDALDatasetH)pDstDS);
+    if(failed)
+        return funcrst(false, err_msg);
 
-    return funcrst(true,"gdal_image_resample_warp success."); //INFO, function \"gdal_image_resample_warp(const char* version)\" ends normally
+    if(megapixels)
+        *megapixels = double(iDstWidth) * iDstHeight / 1e6;
+    return funcrst(true, fmt::format("gdal_image_resample_warp success, {}x{} -> {}x{}, {} tiles, {} threads.",
+        iSrcWidth, iSrcHeight, iDstWidth, iDstHeight, num, workers)); //INFO, function \"gdal_image_resample_warp(const char* version)\" ends normally
 
-}
\ No newline at end of file
+}
@@ -1,4 +1,5 @@
 #include "insar_include.h"
+#include <atomic>
 
 float warp(float src)
 {
@@ -136,80 +137,92 @@ double class_pseudo_correlation(complex<float>* arr, float* arr_out, int height,
 double my_pseudo_correlation(complex<float>* arr, float* arr_out, int height, int width, int size)
 {
     auto st = chrono::system_clock::now();
-    int num=0;
-#pragma omp parallel for
-    for(int i=0; i<height; i++)
+
+    /// 按tile_rows * tile_cols的二维分块并行, 每个分块内维护窗口高度的列和(col_sum, col_abs),
+    /// 逐行向下滑动时每列只需加入新行/移除旧行, 再在行内水平滑动求窗口和, 每个像素的计算量与size无关.
+    /// 超界部分不参与计算, 与原先按行滑动的结果一致; 累加使用double, 避免长距离滑动时的误差积累
+    const int r = size / 2;
+    const int tile_rows = 128;
+    const int tile_cols = 512;
+    int tiles_y = (height + tile_rows - 1) / tile_rows;
+    int tiles_x = (width + tile_cols - 1) / tile_cols;
+    int tiles = tiles_y * tiles_x;
+
+    /// 只由0号线程输出进度, 其余线程仅累加计数, 不会因cout互相阻塞
+    std::atomic<int> tiles_done(0);
+
+#pragma omp parallel
     {
-        cout<<fmt::format("\rpercentage: {}/{}...",num++,height);
-        int start_row = MAX(0,i-size/2);
-        int end_row = MIN(i+size/2,height-1);
-        int win_height= end_row - start_row + 1;
-        /// sum 即总和, abs_sum即模长的总和, left即最左侧一列的总和, abs_left即最左侧一列绝对值的总和, right与abs_right同理
-        complex<float> sum(0,0), left(0,0), right(0,0);
-        float abs_sum=0,abs_left=0, abs_right=0;
+        std::vector<complex<double>> col_sum;
+        std::vector<double> col_abs;
 
-        /// j=0
-        for(int k = start_row; k<= end_row; k++)
+#pragma omp for schedule(dynamic)
+        for(int t = 0; t < tiles; t++)
         {
-            for(int j=0; j<size/2+1; j++){
-                sum += arr[k * width + j];
-                abs_sum += abs(arr[k * width + j]);
-            }
-        }
-        arr_out[i*width + 0] = (abs_sum == 0) ? 0 : abs(sum)/abs_sum;
+            int row_start = (t / tiles_x) * tile_rows;
+            int row_end = MIN(row_start + tile_rows, height);
+            int col_start = (t % tiles_x) * tile_cols;
+            int col_end = MIN(col_start + tile_cols, width);
+
+            /// 列和覆盖分块左右各r列的范围
+            int halo_start = MAX(0, col_start - r);
+            int halo_end = MIN(width, col_end + r);
+            int halo_width = halo_end - halo_start;
+            col_sum.assign(halo_width, complex<double>(0, 0));
+            col_abs.assign(halo_width, 0);
+
+            auto add_row = [&](int k, double sign){
+                const complex<float>* src = arr + size_t(k) * width + halo_start;
+                for(int n = 0; n < halo_width; n++){
+                    col_sum[n] += sign * complex<double>(src[n]);
+                    col_abs[n] += sign * abs(src[n]);
+                }
+            };
 
-        /// j=1~size/2
-        for(int j=1; j<=size/2; j++)
-        {
-            right=0;
-            abs_right=0;
-            int j_r=j + size / 2;
-            for(int k = start_row; k<= end_row; k++){
-                right += arr[k * width + j_r];
-                abs_right += abs(arr[k * width + j_r]);
-            }
-            sum += right;
-            abs_sum += abs_right;
-            arr_out[i*width + j] = abs_sum == 0 ? 0 : abs(sum)/abs_sum;
-        }
+            /// 分块首行的窗口
+            for(int k = MAX(0, row_start - r); k <= MIN(height - 1, row_start + r); k++)
+                add_row(k, 1);
 
-        /// j=size/2~width-size/2
-        for(int j=size/2+1; j<width-size/2; j++)
-        {
-            right=0;
-            abs_right=0;
-            left=0;
-            abs_left=0;
-            int j_r=j + size / 2;
-            int j_l=j - size / 2 - 1;
-            for(int k = start_row; k<= end_row; k++)
+            for(int i = row_start; i < row_end; i++)
             {
-                right += arr[k * width + j_r];
-                abs_right += abs(arr[k * width + j_r]);
-                left += arr[k * width + j_l];
-                abs_left += abs(arr[k * width + j_l]);
-            }
-            sum += right - left;
-            abs_sum += abs_right - abs_left;
-            arr_out[i*width + j] = abs_sum == 0 ? 0 : abs(sum)/abs_sum;
-        }
+                if(i > row_start){
+                    if(i + r < height) add_row(i + r, 1);
+                    if(i - r - 1 >= 0) add_row(i - r - 1, -1);
+                }
 
-        /// j=width-size/2 ~ width-1
-        for(int j=width-size/2; j<width; j++){
-            left=0;
-            abs_left=0;
-            int j_l=j - size / 2 - 1;
-            for(int k = start_row; k<= end_row; k++)
-            {
-                left += arr[k * width + j_l];
-                abs_left += abs(arr[k * width + j_l]);
+                /// 水平滑动, j为全图列号, 列和数组中对应的下标为 j - halo_start
+                complex<double> sum(0, 0);
+                double abs_sum = 0;
+                for(int jj = MAX(0, col_start - r); jj <= MIN(width - 1, col_start + r); jj++){
+                    sum += col_sum[jj - halo_start];
+                    abs_sum += col_abs[jj - halo_start];
+                }
+
+                float* dst = arr_out + size_t(i) * width;
+                for(int j = col_start; j < col_end; j++)
+                {
+                    if(j > col_start){
+                        int j_r = j + r;
+                        int j_l = j - r - 1;
+                        if(j_r < width){
+                            sum += col_sum[j_r - halo_start];
+                            abs_sum += col_abs[j_r - halo_start];
+                        }
+                        if(j_l >= 0){
+                            sum -= col_sum[j_l - halo_start];
+                            abs_sum -= col_abs[j_l - halo_start];
+                        }
+                    }
+                    dst[j] = abs_sum <= 0 ? 0 : float(abs(sum) / abs_sum);
+                }
             }
-            sum -= left;
-            abs_sum -= abs_left;
-            arr_out[i*width + j] = abs_sum == 0 ? 0 : abs(sum)/abs_sum;
+
+            int done = ++tiles_done;
+            if(omp_get_thread_num() == 0)
+                cout<<fmt::format("\rpercentage: {}/{}...", done, tiles);
         }
     }
-    cout<<endl;
+    cout<<fmt::format("\rpercentage: {}/{}...", tiles, tiles)<<endl;
 
     return spend_time(st);
-}
\ No newline at end of file
+}
@@ -0,0 +1,319 @@
+#include "insar_include.h"
+#include <atomic>
+
+/*
+    argparse::ArgumentParser sub_8bitdata("8bitdata");
+    sub_8bitdata.add_description("create 8-bit data, base on slc or mli data.");
+    {
+        sub_8bitdata.add_argument("input_path")
+            .help("valid datatype include short, float, scomplex, fcomplex.");
+
+        sub_8bitdata.add_argument("output_path")
+            .help(" valid extension include, .tif(1b+ct), .bmp(1b+ct), .jpg(3b), .png(4b).");
+
+        sub_8bitdata.add_argument("scale")
+            .help("dst_value = scale * (src_value / average)^ ex, the average is mapped to mid-gray. (only for power)")
+            .scan<'g',double>()
+            .default_value("1");
+
+        sub_8bitdata.add_argument("ex")
+            .help("dst_value = scale * (src_value / average)^ ex, the average is mapped to mid-gray. (only for power)")
+            .scan<'g',double>()
+            .default_value("0.35");
+
+        sub_8bitdata.add_argument("-t","--type")
+            .help("this parameter is useful, only when datatype of input_path is complex, default is power.")
+            .choices("power","phase")
+            .default_value("power");
+
+        sub_8bitdata.add_argument("-m","--max_size")
+            .help("maximum width or height of the quick-look, the input is decimated when larger, 0 means full resolution, default is 2048.")
+            .scan<'i',int>()
+            .default_value("2048");
+
+        sub_8bitdata.add_argument("-r","--resample")
+            .help("resample method of decimated read: nearest (fastest, use overviews if existed) or average, default is nearest.")
+            .choices("nearest","average")
+            .default_value("nearest");
+    }
+*/
+
+namespace {
+
+enum class quicklook_type{ power, phase };
+
+/// @brief 平均值估计最多使用的采样点数
+constexpr size_t quicklook_samples = 1 << 20;
+
+/// @brief 以降采样的分辨率读取影像, 输出数组为out_width*out_height, 复数读取为fcomplex, 实数读取为float.
+/// 按输出行划分为若干条带, 每个线程独立打开数据集读取自己的条带(GDALDataset不是线程安全的),
+/// 条带的源窗口使用浮点坐标, 保证与整幅读取时的采样位置一致
+template<typename _Ty>
+funcrst decimated_read(std::string path, int width, int height, int out_width, int out_height, GDALRIOResampleAlg alg, _Ty* arr)
+{
+	GDALDataType datatype = std::is_same<_Ty, float>::value ? GDT_Float32 : GDT_CFloat32;
+	int threads = MAX(1, MIN(omp_get_max_threads(), out_height / 16));
+	int rows_per_thread = (out_height + threads - 1) / threads;
+	double y_ratio = double(height) / out_height;
+	std::atomic<bool> failed(false);
+
+#pragma omp parallel for num_threads(threads) schedule(static, 1)
+	for(int t = 0; t < threads; t++)
+	{
+		int row_start = t * rows_per_thread;
+		int row_end = MIN(row_start + rows_per_thread, out_height);
+		if(row_start >= row_end)
+			continue;
+
+		GDALDataset* ds = (GDALDataset*)GDALOpen(path.c_str(), GA_ReadOnly);
+		if(!ds){
+			failed = true;
+			continue;
+		}
+
+		GDALRasterIOExtraArg extra;
+		INIT_RASTERIO_EXTRA_ARG(extra);
+		extra.eResampleAlg = alg;
+		extra.bFloatingPointWindowValidity = TRUE;
+		extra.dfXOff = 0;
+		extra.dfXSize = width;
+		extra.dfYOff = row_start * y_ratio;
+		extra.dfYSize = (row_end - row_start) * y_ratio;
+
+		int y_off = int(extra.dfYOff);
+		int y_size = MIN(height - y_off, MAX(1, int(std::ceil(extra.dfYOff + extra.dfYSize)) - y_off));
+		int rows = row_end - row_start;
+		CPLErr err = ds->GetRasterBand(1)->RasterIO(GF_Read, 0, y_off, width, y_size, arr + size_t(row_start) * out_width,
+			out_width, rows, datatype, 0, 0, &extra);
+		if(err != CE_None)
+			failed = true;
+		GDALClose(ds);
+	}
+
+	if(failed)
+		return funcrst(false, fmt::format("decimated_read, read '{}' failed. ({})", path, CPLGetLastErrorMsg()));
+	return funcrst(true, "decimated_read finished.");
+}
+
+/// @brief 有效值(非0且非nan)的平均值, 最多均匀采样quicklook_samples个点
+double sampled_average(const float* arr, size_t count)
+{
+	size_t stride = MAX(size_t(1), count / quicklook_samples);
+	long long samples = (long long)((count + stride - 1) / stride);
+	double sum = 0;
+	long long num = 0;
+#pragma omp parallel for reduction(+:sum,num)
+	for(long long k = 0; k < samples; k++){
+		float val = arr[k * stride];
+		if(val != 0 && !std::isnan(val)){
+			sum += val;
+			num++;
+		}
+	}
+	return num == 0 ? 0 : sum / num;
+}
+
+/// @brief 功率/幅值 -> 8bit, 255 * scale * (v / avg)^ex / 2, 即平均值对应中灰, 无效值为0
+void power_to_byte(const float* arr, size_t count, double avg, double scale, double ex, unsigned char* out)
+{
+	float inv_avg = avg == 0 ? 0.f : float(1 / avg);
+	float k = float(127.5 * scale);
+	float e = float(ex);
+#pragma omp parallel for simd
+	for(long long idx = 0; idx < (long long)count; idx++){
+		float val = arr[idx] * inv_avg;
+		float dst = val > 0 ? k * powf(val, e) : 0.f;
+		dst = dst > 255.f ? 255.f : dst;
+		out[idx] = (unsigned char)(dst);
+	}
+}
+
+/// @brief 相位 -> 8bit, [-pi, pi]线性映射到[1, 255], 0保留给无效值(nan, 即计算相位时幅值为0或nan的像素);
+/// 相位恰好为0(虚部为0, 实部为正)是有效值
+void phase_to_byte(const float* arr, size_t count, unsigned char* out)
+{
+	const float k = float(254 / (2 * M_PI));
+#pragma omp parallel for simd
+	for(long long idx = 0; idx < (long long)count; idx++){
+		float val = arr[idx];
+		out[idx] = std::isnan(val) ? 0 : (unsigned char)(1 + (val + float(M_PI)) * k);
+	}
+}
+
+/// @brief 功率为灰度, 相位为hsv色环, 0号颜色为无效值(透明黑)
+std::vector<rgba> quicklook_palette(quicklook_type type)
+{
+	std::vector<rgba> palette(256);
+	for(int i = 0; i < 256; i++){
+		if(type == quicklook_type::power)
+			palette[i] = rgba(i, i, i, 255);
+		else{
+			palette[i] = hsv_to_rgb(hsv((i - 1) / 254.0 * 360, 1, 1));
+			palette[i].alpha = 255;
+		}
+	}
+	palette[0] = rgba(0, 0, 0, 0);
+	return palette;
+}
+
+}
+
+int create_8bitdata(argparse::ArgumentParser* args, std::shared_ptr<spdlog::logger> logger)
+{
+	std::string input_path  = args->get<string>("input_path");
+	std::string output_path = args->get<string>("output_path");
+	double scale = args->get<double>("scale");
+	double ex = args->get<double>("ex");
+	std::string type_str = args->get<string>("--type");
+	int max_size = args->get<int>("--max_size");
+	GDALRIOResampleAlg alg = args->get<string>("--resample") == "average" ? GRIORA_Average : GRIORA_NearestNeighbour;
+
+	std::string extension = fs::path(output_path).extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	std::string driver_name;
+	int bands = 1;
+	if(extension == ".tif")
+		driver_name = "GTiff";
+	else if(extension == ".bmp")
+		driver_name = "BMP";
+	else if(extension == ".jpg"){
+		driver_name = "JPEG"; bands = 3;
+	}
+	else if(extension == ".png"){
+		driver_name = "PNG"; bands = 4;
+	}
+	else{
+		PRINT_LOGGER(logger, error, fmt::format("un-supported extension '{}'", extension));
+		return -1;
+	}
+
+	if(max_size < 0){
+		PRINT_LOGGER(logger, warn, fmt::format("max_size input is a invalid data ({}) which has been replaced by default ({})", max_size, 2048));
+		max_size = 2048;
+	}
+
+	GDALAllRegister();
+    CPLSetConfigOption("GDAL_FILENAME_IS_UTF8", "NO");
+
+	GDALDriver* dv_out = GetGDALDriverManager()->GetDriverByName(driver_name.c_str());
+	if(!dv_out){
+		PRINT_LOGGER(logger, error, fmt::format("un-supported driver '{}'", driver_name));
+		return -1;
+	}
+
+    GDALDataset* ds = (GDALDataset*)GDALOpen(input_path.c_str(), GA_ReadOnly);
+    if(!ds){
+        PRINT_LOGGER(logger, error, "ds is nullptr");
+		return -1;
+    }
+	int width = ds->GetRasterXSize();
+    int height= ds->GetRasterYSize();
+    GDALDataType datatype = ds->GetRasterBand(1)->GetRasterDataType();
+	GDALClose(ds);
+
+	bool is_complex = (datatype == GDT_CInt16 || datatype == GDT_CFloat32);
+	if(!is_complex && datatype != GDT_Int16 && datatype != GDT_Float32){
+		PRINT_LOGGER(logger, error, fmt::format("datatype ({}) is diff with short, float, scomplex and fcomplex.", GDALGetDataTypeName(datatype)));
+		return -2;
+	}
+	quicklook_type type = (is_complex && type_str == "phase") ? quicklook_type::phase : quicklook_type::power;
+
+	/// 降采样后的尺寸, 保持长宽比
+	int out_width = width, out_height = height;
+	if(max_size > 0 && MAX(width, height) > max_size){
+		double ratio = double(max_size) / MAX(width, height);
+		out_width  = MAX(1, int(width * ratio + 0.5));
+		out_height = MAX(1, int(height * ratio + 0.5));
+	}
+	size_t count = size_t(out_width) * out_height;
+	PRINT_LOGGER(logger, info, fmt::format("quick-look size: {}x{} (input {}x{}), type: {}.", out_width, out_height, width, height, type == quicklook_type::power ? "power" : "phase"));
+
+	/// 读取 -> 功率/相位(float)
+	auto start_time = std::chrono::system_clock::now();
+	std::vector<float> arr(count);
+	funcrst rst;
+	if(is_complex){
+		std::vector<std::complex<float>> arr_cpx(count);
+		rst = decimated_read(input_path, width, height, out_width, out_height, alg, arr_cpx.data());
+		const std::complex<float>* src = arr_cpx.data();
+		if(type == quicklook_type::power){
+#pragma omp parallel for simd
+			for(long long idx = 0; idx < (long long)count; idx++)
+				arr[idx] = src[idx].real() * src[idx].real() + src[idx].imag() * src[idx].imag();
+		}
+		else{
+			/// 幅值为0(如整数SLC的无效区域)时相位无定义, 记为nan; 实部或虚部为nan时atan2f也返回nan
+#pragma omp parallel for
+			for(long long idx = 0; idx < (long long)count; idx++){
+				float re = src[idx].real(), im = src[idx].imag();
+				arr[idx] = (re == 0 && im == 0) ? NAN : atan2f(im, re);
+			}
+		}
+	}
+	else{
+		rst = decimated_read(input_path, width, height, out_width, out_height, alg, arr.data());
+	}
+	if(!rst){
+		PRINT_LOGGER(logger, error, rst.explain);
+		return -3;
+	}
+	PRINT_LOGGER(logger, info, fmt::format("decimated read finished, spend time {}s.", spend_time(start_time)));
+
+	/// float -> 8bit
+	std::vector<unsigned char> arr_byte(count);
+	if(type == quicklook_type::power){
+		double avg = sampled_average(arr.data(), count);
+		PRINT_LOGGER(logger, info, fmt::format("sampled average: {}.", avg));
+		power_to_byte(arr.data(), count, avg, scale, ex, arr_byte.data());
+	}
+	else{
+		phase_to_byte(arr.data(), count, arr_byte.data());
+	}
+	std::vector<float>().swap(arr);
+
+	/// 8bit -> 输出, tif与bmp为单波段+颜色表, jpg与png按颜色表展开为rgb(a)
+	std::vector<rgba> palette = quicklook_palette(type);
+	GDALDriver* dv_mem = GetGDALDriverManager()->GetDriverByName("MEM");
+	GDALDataset* ds_mem = dv_mem->Create("", out_width, out_height, bands, GDT_Byte, NULL);
+	if(!ds_mem){
+		PRINT_LOGGER(logger, error, "ds_mem is nullptr.");
+		return -3;
+	}
+
+	if(bands == 1){
+		GDALColorTable ct;
+		for(int i = 0; i < 256; i++){
+			GDALColorEntry ce;
+			ce.c1 = palette[i].red;
+			ce.c2 = palette[i].green;
+			ce.c3 = palette[i].blue;
+			ce.c4 = palette[i].alpha;
+			ct.SetColorEntry(i, &ce);
+		}
+		ds_mem->GetRasterBand(1)->RasterIO(GF_Write, 0, 0, out_width, out_height, arr_byte.data(), out_width, out_height, GDT_Byte, 0, 0);
+		ds_mem->GetRasterBand(1)->SetColorTable(&ct);
+	}
+	else{
+		std::vector<unsigned char> arr_band(count);
+		for(int b = 0; b < bands; b++){
+			unsigned char lut[256];
+			for(int i = 0; i < 256; i++)
+				lut[i] = (unsigned char)(b == 0 ? palette[i].red : b == 1 ? palette[i].green : b == 2 ? palette[i].blue : palette[i].alpha);
+#pragma omp parallel for
+			for(long long idx = 0; idx < (long long)count; idx++)
+				arr_band[idx] = lut[arr_byte[idx]];
+			ds_mem->GetRasterBand(b + 1)->RasterIO(GF_Write, 0, 0, out_width, out_height, arr_band.data(), out_width, out_height, GDT_Byte, 0, 0);
+		}
+	}
+
+	GDALDataset* ds_out = dv_out->CreateCopy(output_path.c_str(), ds_mem, FALSE, NULL, NULL, NULL);
+	GDALClose(ds_mem);
+	if(!ds_out){
+		PRINT_LOGGER(logger, error, "ds_out is nullptr.");
+		return -3;
+	}
+	GDALClose(ds_out);
+
+	PRINT_LOGGER(logger, info, fmt::format("create_8bitdata finished, spend time {}s.", spend_time(start_time)));
+	return 1;
+}
@@ -0,0 +1,234 @@
+#include "raster_copy.h"
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <omp.h>
+
+#include <gdal_priv.h>
+#include <fmt/format.h>
+
+#include "block_window.h"
+
+namespace {
+
+/// @brief 同一个输出数据集的所有目标波段, indices为其在bands(即读取缓存)中的序号
+struct copy_group
+{
+	GDALDataset* ds;
+	std::vector<int> indices;
+	std::vector<int> out_bands;
+	std::unique_ptr<std::mutex> mutex;
+
+	/// @brief indices是否连续递增, 连续时缓存中的对应波段相邻, 可以一次写出
+	bool contiguous() const
+	{
+		for(size_t k = 1; k < indices.size(); k++)
+			if(indices[k] != indices[k - 1] + 1)
+				return false;
+		return true;
+	}
+};
+
+/// @brief 源数据是否为无压缩的GTiff
+bool is_uncompressed_gtiff(GDALDataset* ds)
+{
+	GDALDriver* driver = ds->GetDriver();
+	if(driver == nullptr || std::string(driver->GetDescription()) != "GTiff")
+		return false;
+	return ds->GetMetadataItem("COMPRESSION", "IMAGE_STRUCTURE") == nullptr;
+}
+
+}
+
+funcrst raster_copy(std::string src_path, int x, int y, int xsize, int ysize,
+	const std::vector<int>& bands, const std::vector<raster_copy_target>& targets, GDALProgressFunc progress)
+{
+	if(bands.empty() || bands.size() != targets.size())
+		return funcrst(false, fmt::format("raster_copy, bands.size({}) is empty or diff with targets.size({}).", bands.size(), targets.size()));
+
+	GDALDataset* ds = (GDALDataset*)GDALOpen(src_path.c_str(), GA_ReadOnly);
+	if(!ds)
+		return funcrst(false, fmt::format("raster_copy, open '{}' failed.", src_path));
+
+	for(int b : bands){
+		if(b < 1 || b > ds->GetRasterCount()){
+			GDALClose(ds);
+			return funcrst(false, fmt::format("raster_copy, band({}) is out of range [1,{}].", b, ds->GetRasterCount()));
+		}
+	}
+	if(x < 0 || y < 0 || xsize < 1 || ysize < 1 || x + xsize > ds->GetRasterXSize() || y + ysize > ds->GetRasterYSize()){
+		GDALClose(ds);
+		return funcrst(false, fmt::format("raster_copy, window [{},{},{},{}] is out of image.", x, y, xsize, ysize));
+	}
+
+	GDALDataType datatype = ds->GetRasterBand(bands[0])->GetRasterDataType();
+	int datasize = GDALGetDataTypeSizeBytes(datatype);
+	int num_bands = int(bands.size());
+	bool direct_io = is_uncompressed_gtiff(ds);
+
+	/// 所有波段使用同一个窗口划分, 按第一个波段的block对齐
+	std::vector<block_window> windows = split_block_windows(ds->GetRasterBand(bands[0]), x, y, xsize, ysize, 1);
+	GDALClose(ds);
+
+	std::vector<copy_group> groups;
+	std::map<GDALDataset*, size_t> group_of;
+	for(int k = 0; k < num_bands; k++){
+		const raster_copy_target& tg = targets[k];
+		if(tg.ds == nullptr || tg.band < 1 || tg.band > tg.ds->GetRasterCount())
+			return funcrst(false, fmt::format("raster_copy, target of band({}) is invalid.", bands[k]));
+		if(tg.ds->GetRasterXSize() < xsize || tg.ds->GetRasterYSize() < ysize)
+			return funcrst(false, fmt::format("raster_copy, target of band({}) is smaller than window.", bands[k]));
+		auto iter = group_of.find(tg.ds);
+		if(iter == group_of.end()){
+			iter = group_of.emplace(tg.ds, groups.size()).first;
+			groups.push_back({tg.ds, {}, {}, std::make_unique<std::mutex>()});
+		}
+		groups[iter->second].indices.push_back(k);
+		groups[iter->second].out_bands.push_back(tg.band);
+	}
+
+	int num = int(windows.size());
+	int done = 0;
+	std::atomic<bool> failed(false);
+	std::string err_msg;
+	std::mutex mutex_state;
+
+	auto set_failed = [&](std::string msg){
+		std::lock_guard<std::mutex> lock(mutex_state);
+		if(!failed.exchange(true))
+			err_msg = msg;
+	};
+
+#pragma omp parallel
+	{
+		/// 仅对当前线程生效: raw格式(含raw VRT)与无压缩GTiff的大窗口直接按字节范围读取
+		CPLSetThreadLocalConfigOption("GDAL_ONE_BIG_READ", "YES");
+		if(direct_io)
+			CPLSetThreadLocalConfigOption("GTIFF_DIRECT_IO", "YES");
+
+		GDALDataset* ds_thread = (GDALDataset*)GDALOpen(src_path.c_str(), GA_ReadOnly);
+		if(ds_thread == nullptr)
+			set_failed(fmt::format("open '{}' failed.", src_path));
+		std::vector<unsigned char> arr;
+		std::vector<int> band_map(bands);
+
+#pragma omp for schedule(dynamic)
+		for(int w = 0; w < num; w++)
+		{
+			if(failed)
+				continue;
+			const block_window& win = windows[w];
+			GSpacing line_space = GSpacing(win.xsize) * datasize;
+			GSpacing band_space = line_space * win.ysize;
+			arr.resize(size_t(band_space) * num_bands);
+
+			/// 波段顺序存放(band sequential), 一次读取所有波段
+			CPLErr err = ds_thread->RasterIO(GF_Read, win.x, win.y, win.xsize, win.ysize, arr.data(), win.xsize, win.ysize,
+				datatype, num_bands, band_map.data(), datasize, line_space, band_space, nullptr);
+			if(err != CE_None){
+				set_failed(CPLGetLastErrorMsg());
+				continue;
+			}
+
+			for(copy_group& group : groups){
+				std::lock_guard<std::mutex> lock(*group.mutex);
+				if(group.contiguous()){
+					err = group.ds->RasterIO(GF_Write, win.x - x, win.y - y, win.xsize, win.ysize, arr.data() + band_space * group.indices[0],
+						win.xsize, win.ysize, datatype, int(group.out_bands.size()), group.out_bands.data(), datasize, line_space, band_space, nullptr);
+				}
+				else{
+					for(size_t k = 0; k < group.indices.size() && err == CE_None; k++)
+						err = group.ds->GetRasterBand(group.out_bands[k])->RasterIO(GF_Write, win.x - x, win.y - y, win.xsize, win.ysize,
+							arr.data() + band_space * group.indices[k], win.xsize, win.ysize, datatype, datasize, line_space, nullptr);
+				}
+				if(err != CE_None)
+					break;
+			}
+			if(err != CE_None){
+				set_failed(CPLGetLastErrorMsg());
+				continue;
+			}
+
+			std::lock_guard<std::mutex> lock(mutex_state);
+			++done;
+			if(progress)
+				progress(double(done) / num, nullptr, nullptr);
+		}
+
+		if(ds_thread)
+			GDALClose(ds_thread);
+		CPLSetThreadLocalConfigOption("GDAL_ONE_BIG_READ", nullptr);
+		CPLSetThreadLocalConfigOption("GTIFF_DIRECT_IO", nullptr);
+	}
+
+	if(failed || done != num)
+		return funcrst(false, fmt::format("raster_copy, RasterIO failed. ({})", err_msg));
+
+	return funcrst(true, "raster_copy finished.");
+}
+
+GDALDataset* create_like(GDALDataset* ds_in, std::string path, std::string& err)
+{
+	GDALDriver* dv = ds_in->GetDriver();
+	if(dv == nullptr || !CPLFetchBool(dv->GetMetadata(), GDAL_DCAP_CREATE, false)){
+		err = fmt::format("driver '{}' doesn't support Create, process the input in place (output == input) or convert it to tif first.",
+			dv ? dv->GetDescription() : "unknown");
+		return nullptr;
+	}
+
+	int xsize = ds_in->GetRasterXSize();
+	int ysize = ds_in->GetRasterYSize();
+	int bands = ds_in->GetRasterCount();
+	GDALDataType datatype = ds_in->GetRasterBand(1)->GetRasterDataType();
+
+	char** options = nullptr;
+	if(EQUAL(dv->GetDescription(), "GTiff")){
+		int block_x = 0, block_y = 0;
+		ds_in->GetRasterBand(1)->GetBlockSize(&block_x, &block_y);
+		if(block_x < xsize){
+			options = CSLSetNameValue(options, "TILED", "YES");
+			options = CSLSetNameValue(options, "BLOCKXSIZE", std::to_string(block_x).c_str());
+		}
+		options = CSLSetNameValue(options, "BLOCKYSIZE", std::to_string(block_y).c_str());
+		const char* compress = ds_in->GetMetadataItem("COMPRESSION", "IMAGE_STRUCTURE");
+		if(compress)
+			options = CSLSetNameValue(options, "COMPRESS", compress);
+		const char* predictor = ds_in->GetMetadataItem("PREDICTOR", "IMAGE_STRUCTURE");
+		if(compress && predictor)
+			options = CSLSetNameValue(options, "PREDICTOR", predictor);
+		const char* interleave = ds_in->GetMetadataItem("INTERLEAVE", "IMAGE_STRUCTURE");
+		if(interleave)
+			options = CSLSetNameValue(options, "INTERLEAVE", interleave);
+		options = CSLSetNameValue(options, "BIGTIFF", "IF_SAFER");
+	}
+	GDALDataset* ds_out = dv->Create(path.c_str(), xsize, ysize, bands, datatype, options);
+	CSLDestroy(options);
+	if(ds_out == nullptr){
+		err = fmt::format("create '{}' with driver '{}' failed, {}", path, dv->GetDescription(), CPLGetLastErrorMsg());
+		return nullptr;
+	}
+
+	double gt[6];
+	if(ds_in->GetGeoTransform(gt) == CE_None)
+		ds_out->SetGeoTransform(gt);
+	ds_out->SetProjection(ds_in->GetProjectionRef());
+	if(ds_in->GetMetadata())
+		ds_out->SetMetadata(ds_in->GetMetadata());
+	for(int b = 1; b <= bands; b++){
+		GDALRasterBand* rb_in = ds_in->GetRasterBand(b);
+		GDALRasterBand* rb_out = ds_out->GetRasterBand(b);
+		rb_out->SetDescription(rb_in->GetDescription());
+		if(rb_in->GetMetadata())
+			rb_out->SetMetadata(rb_in->GetMetadata());
+		rb_out->SetColorInterpretation(rb_in->GetColorInterpretation());
+		if(rb_in->GetColorTable())
+			rb_out->SetColorTable(rb_in->GetColorTable());
+		int has_nodata = 0;
+		double nodata = rb_in->GetNoDataValue(&has_nodata);
+		if(has_nodata)
+			rb_out->SetNoDataValue(nodata);
+	}
+	return ds_out;
+}
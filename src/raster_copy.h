@@ -0,0 +1,34 @@
+#ifndef RASTER_COPY_H
+#define RASTER_COPY_H
+
+#include <vector>
+#include <string>
+
+#include <gdal_priv.h>
+
+#include "datatype.h"
+
+/// 栅格拷贝引擎: 按源数据block对齐的窗口并行拷贝若干波段, 用于波段提取与按像素裁剪.
+/// 每个线程独立打开源数据(只读), 每个窗口用一次GDALDataset::RasterIO(band map)读取所有波段, 而不是逐行逐波段读取;
+/// 输出数据集在各自的互斥锁内写出, 不同输出数据集之间的写出可以并行.
+/// 源数据为无压缩的GTiff或raw格式(包括VRTRawRasterBand)时, 开启GDAL的direct io, 直接按字节范围读取, 不经过block cache.
+
+/// @brief 拷贝的目标波段
+struct raster_copy_target
+{
+	GDALDataset* ds;
+	int band;			///< ds中的波段号(从1开始)
+};
+
+/// @brief 将src_path中窗口[x, x+xsize) x [y, y+ysize)内的波段bands拷贝到targets(与bands一一对应)的(0,0)处
+/// @param bands 源数据的波段号(从1开始), 所有波段按第一个波段的数据类型读写
+/// @param targets 输出数据集需要已创建且尺寸不小于窗口, 多个target可以属于同一个数据集, 此时写出时使用一次RasterIO
+/// @param progress 进度回调, 在锁内调用, 可以为nullptr
+funcrst raster_copy(std::string src_path, int x, int y, int xsize, int ysize,
+	const std::vector<int>& bands, const std::vector<raster_copy_target>& targets, GDALProgressFunc progress = GDALTermProgress);
+
+/// @brief 以ds_in的驱动创建尺寸, 波段数与数据类型相同的数据集, 并复制地理信息, 元数据, 波段描述, 颜色解释, 颜色表与nodata;
+/// GTiff还沿用输入的分块, 压缩与交错方式. 驱动不支持Create(如PNG, JPEG)时返回nullptr, err为原因
+GDALDataset* create_like(GDALDataset* ds_in, std::string path, std::string& err);
+
+#endif // RASTER_COPY_H
@@ -58,4 +58,6 @@ int create_quadtree(argparse::ArgumentParser* args, std::shared_ptr<spdlog::logg
 
 int jpg_to_png(argparse::ArgumentParser* args, std::shared_ptr<spdlog::logger> logger);
 
+int build_overviews(argparse::ArgumentParser* args, std::shared_ptr<spdlog::logger> logger);
+
 int triangle_network(argparse::ArgumentParser* args, std::shared_ptr<spdlog::logger> logger);
\ No newline at end of file
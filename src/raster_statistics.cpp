@@ -0,0 +1,560 @@
+#include "raster_statistics.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <atomic>
+#include <omp.h>
+
+#include <gdal_priv.h>
+#include <fmt/format.h>
+
+#include "block_window.h"
+
+/// quantile_sketch
+
+uint32_t quantile_sketch::bin_of(double value)
+{
+	float f = float(value);
+	uint32_t u;
+	std::memcpy(&u, &f, sizeof(u));
+	/// 负数取反, 正数置最高位, 使整数的大小顺序与浮点数一致
+	u = (u & 0x80000000u) ? ~u : (u | 0x80000000u);
+	return u >> 16;
+}
+
+double quantile_sketch::bin_lower(uint32_t bin)
+{
+	uint32_t u = bin << 16;
+	u = (u & 0x80000000u) ? (u & 0x7fffffffu) : ~u;
+	float f;
+	std::memcpy(&f, &u, sizeof(f));
+	return f;
+}
+
+double quantile_sketch::bin_upper(uint32_t bin)
+{
+	uint32_t u = (bin << 16) | 0xffffu;
+	u = (u & 0x80000000u) ? (u & 0x7fffffffu) : ~u;
+	float f;
+	std::memcpy(&f, &u, sizeof(f));
+	return f;
+}
+
+void quantile_sketch::add(double value)
+{
+	if(m_bins.empty())
+		m_bins.assign(bins, 0);
+	m_bins[bin_of(value)]++;
+	m_count++;
+}
+
+void quantile_sketch::merge(const quantile_sketch& other)
+{
+	if(other.m_count == 0)
+		return;
+	if(m_bins.empty())
+		m_bins.assign(bins, 0);
+	for(int i = 0; i < bins; i++)
+		m_bins[i] += other.m_bins[i];
+	m_count += other.m_count;
+}
+
+double quantile_sketch::quantile(double p, double min, double max) const
+{
+	if(m_count == 0)
+		return std::numeric_limits<double>::quiet_NaN();
+	if(p <= 0)
+		return min;
+	if(p >= 1)
+		return max;
+
+	/// 第rank个值(从0开始)所在的箱, 在箱内按线性插值
+	double rank = p * double(m_count - 1);
+	uint64_t cum = 0;
+	for(int i = 0; i < bins; i++){
+		if(m_bins[i] == 0)
+			continue;
+		if(double(cum + m_bins[i]) > rank){
+			double lower = MAX(bin_lower(i), min);
+			double upper = MIN(bin_upper(i), max);
+			double t = m_bins[i] == 1 ? 0.5 : (rank - double(cum)) / double(m_bins[i] - 1);
+			return lower + (upper - lower) * t;
+		}
+		cum += m_bins[i];
+	}
+	return max;
+}
+
+std::vector<uint64_t> quantile_sketch::histogram(double min, double max, int size) const
+{
+	std::vector<uint64_t> hist(MAX(size, 0), 0);
+	if(m_count == 0 || size < 1)
+		return hist;
+
+	/// 草图的每个箱视为均匀分布, 计数按与各直方图箱的重叠长度分摊
+	double delta = (max - min) / size;
+	auto index_of = [&](double value){
+		int idx = delta <= 0 ? 0 : int((value - min) / delta);
+		return MAX(0, MIN(size - 1, idx));
+	};
+	std::vector<double> weights(size, 0);
+	for(int i = 0; i < bins; i++){
+		if(m_bins[i] == 0)
+			continue;
+		double lower = MAX(bin_lower(i), min);
+		double upper = MIN(bin_upper(i), max);
+		int first = index_of(lower), last = index_of(upper);
+		if(upper <= lower || first == last){
+			weights[first] += double(m_bins[i]);
+			continue;
+		}
+		for(int k = first; k <= last; k++){
+			double overlap = MIN(upper, min + (k + 1) * delta) - MAX(lower, min + k * delta);
+			if(overlap > 0)
+				weights[k] += double(m_bins[i]) * overlap / (upper - lower);
+		}
+	}
+
+	/// 按累计值取整, 保证总数不变
+	double cum = 0;
+	uint64_t cum_rounded = 0;
+	for(int k = 0; k < size; k++){
+		cum += weights[k];
+		uint64_t rounded = uint64_t(std::llround(cum));
+		hist[k] = rounded > cum_rounded ? rounded - cum_rounded : 0;
+		cum_rounded = MAX(cum_rounded, rounded);
+	}
+	return hist;
+}
+
+/// band_statistics
+
+void band_statistics::add(double value)
+{
+	if(std::isnan(value)){
+		nan_count++;
+		return;
+	}
+	if(has_nodata && value == nodata){
+		nodata_count++;
+		return;
+	}
+	if(count == 0){
+		min = max = value;
+	}
+	else{
+		min = MIN(min, value);
+		max = MAX(max, value);
+	}
+	count++;
+	double delta = value - mean;
+	mean += delta / count;
+	m2 += delta * (value - mean);
+	if(use_sketch)
+		sketch.add(value);
+}
+
+void band_statistics::merge(const band_statistics& other)
+{
+	nodata_count += other.nodata_count;
+	nan_count += other.nan_count;
+	if(use_sketch)
+		sketch.merge(other.sketch);
+	if(other.count == 0)
+		return;
+	if(count == 0){
+		count = other.count;
+		min = other.min;
+		max = other.max;
+		mean = other.mean;
+		m2 = other.m2;
+		return;
+	}
+
+	/// Chan et al. 的并行方差合并公式
+	double n_a = double(count), n_b = double(other.count);
+	double n = n_a + n_b;
+	double delta = other.mean - mean;
+	mean += delta * n_b / n;
+	m2 += other.m2 + delta * delta * n_a * n_b / n;
+	count += other.count;
+	min = MIN(min, other.min);
+	max = MAX(max, other.max);
+}
+
+double band_statistics::stddev() const
+{
+	return std::sqrt(variance());
+}
+
+namespace {
+
+/// @brief 统计一个窗口: 先剔除nan/nodata并求和与最值, 再对缓存中的有效值求离差平方和, 最后合并到acc.
+/// 返回有效值的数量, 有效值被前移到arr[0, valid)
+size_t accumulate_window(double* arr, size_t count, band_statistics& acc)
+{
+	band_statistics win;
+	win.has_nodata = acc.has_nodata;
+	win.nodata = acc.nodata;
+
+	/// 将有效值前移压缩
+	size_t valid = 0;
+	for(size_t i = 0; i < count; i++){
+		double val = arr[i];
+		if(std::isnan(val))
+			win.nan_count++;
+		else if(win.has_nodata && val == win.nodata)
+			win.nodata_count++;
+		else
+			arr[valid++] = val;
+	}
+
+	if(valid > 0){
+		double sum = 0, min = arr[0], max = arr[0];
+#pragma omp simd reduction(+:sum) reduction(min:min) reduction(max:max)
+		for(size_t i = 0; i < valid; i++){
+			sum += arr[i];
+			min = arr[i] < min ? arr[i] : min;
+			max = arr[i] > max ? arr[i] : max;
+		}
+		double mean = sum / valid;
+		double m2 = 0;
+#pragma omp simd reduction(+:m2)
+		for(size_t i = 0; i < valid; i++)
+			m2 += (arr[i] - mean) * (arr[i] - mean);
+
+		win.count = valid;
+		win.min = min;
+		win.max = max;
+		win.mean = mean;
+		win.m2 = m2;
+	}
+
+	acc.merge(win);
+	if(acc.use_sketch){
+		for(size_t i = 0; i < valid; i++)
+			acc.sketch.add(arr[i]);
+	}
+	return valid;
+}
+
+/// @brief [st.min, st.max]内等间隔的size个直方图箱中val所在的箱, 等于max的值归入最后一箱; scale为size / (max - min)
+inline int histogram_bin(double val, const band_statistics& st, double scale, int size)
+{
+	return MIN(int((val - st.min) * scale), size - 1);
+}
+
+/// @brief 将窗口中的有效值按[st.min, st.max]等间隔统计到hist中, 等于max的值归入最后一箱
+void accumulate_histogram(const double* arr, size_t count, const band_statistics& st, std::vector<uint64_t>& hist)
+{
+	int size = int(hist.size());
+	double scale = st.max > st.min ? size / (st.max - st.min) : 0;
+	for(size_t i = 0; i < count; i++){
+		double val = arr[i];
+		if(std::isnan(val) || (st.has_nodata && val == st.nodata) || val < st.min || val > st.max)
+			continue;
+		hist[histogram_bin(val, st, scale, size)]++;
+	}
+}
+
+/// @brief 8/16位整数的逐值计数(至多65536个箱), 与最值在同一次遍历中统计;
+/// 得到最值后按[min, max]重新分箱即为精确直方图, 与accumulate_histogram的结果相同, 不需要再遍历一次
+struct value_counts
+{
+	double lowest{ 0 };
+	std::vector<uint64_t> counts;	///< 值v计入counts[v - lowest], 为空时不统计
+	bool out_of_range{ false };		///< 出现了范围外的值(不应发生), 此时改为再遍历一次
+
+	/// @brief datatype为8/16位整数时按其取值范围分配计数, 其他类型不统计
+	void init(GDALDataType datatype)
+	{
+		switch(datatype){
+		case GDT_Byte:		lowest = 0;			counts.assign(1 << 8, 0);	break;
+		case GDT_UInt16:	lowest = 0;			counts.assign(1 << 16, 0);	break;
+		case GDT_Int16:		lowest = -32768;	counts.assign(1 << 16, 0);	break;
+#if GDAL_VERSION_NUM >= 3070000
+		case GDT_Int8:		lowest = -128;		counts.assign(1 << 8, 0);	break;
+#endif
+		default:			counts.clear();		break;
+		}
+	}
+
+	bool valid() const { return !counts.empty() && !out_of_range; }
+
+	/// @brief arr为accumulate_window前移后的有效值
+	void add(const double* arr, size_t valid)
+	{
+		if(counts.empty())
+			return;
+		double size = double(counts.size());
+		for(size_t i = 0; i < valid; i++){
+			double idx = arr[i] - lowest;
+			if(idx >= 0 && idx < size)
+				counts[size_t(idx)]++;
+			else
+				out_of_range = true;
+		}
+	}
+
+	void merge(const value_counts& other)
+	{
+		out_of_range = out_of_range || other.out_of_range;
+		for(size_t i = 0; i < counts.size() && i < other.counts.size(); i++)
+			counts[i] += other.counts[i];
+	}
+
+	/// @brief 按[st.min, st.max]等间隔重新分为size个箱
+	std::vector<uint64_t> histogram(const band_statistics& st, int size) const
+	{
+		std::vector<uint64_t> hist(size, 0);
+		double scale = st.max > st.min ? size / (st.max - st.min) : 0;
+		for(size_t i = 0; i < counts.size(); i++){
+			double val = lowest + double(i);
+			if(counts[i] == 0 || val < st.min || val > st.max)
+				continue;
+			hist[histogram_bin(val, st, scale, size)] += counts[i];
+		}
+		return hist;
+	}
+};
+
+/// @brief 第一次遍历的累加器
+struct statistics_acc
+{
+	std::vector<band_statistics> stats;
+	std::vector<value_counts> counts;
+};
+
+/// @brief 近似统计时使用的band(概视图或band本身)
+GDALRasterBand* sample_band(GDALRasterBand* rb, const raster_statistics_options& opt)
+{
+	if(!opt.approx)
+		return rb;
+	GDALRasterBand* ov = rb->GetRasterSampleOverviewEx(opt.approx_pixels);
+	return ov ? ov : rb;
+}
+
+/// @brief 多线程遍历窗口, 每个线程独立打开数据集并维护自己的累加器(由init复制),
+/// 对每个窗口调用func(acc, win, arr, count), 遍历结束后在临界区中调用merge(acc)
+template<typename _Acc, typename _Func, typename _Merge>
+funcrst for_each_window(const std::string& img_path, const std::vector<int>& bands, const std::vector<block_window>& windows,
+	const raster_statistics_options& opt, const _Acc& init, _Func&& func, _Merge&& merge)
+{
+	int num = int(windows.size());
+	std::atomic<bool> failed(false);
+	std::string err_msg;
+
+#pragma omp parallel
+	{
+		/// GDALDataset不是线程安全的, 每个线程独立打开, 只读时互不影响
+		GDALDataset* ds_thread = (GDALDataset*)GDALOpen(img_path.c_str(), GA_ReadOnly);
+		_Acc acc(init);
+		std::vector<double> arr;
+
+#pragma omp for schedule(dynamic)
+		for(int w = 0; w < num; w++)
+		{
+			if(failed || ds_thread == nullptr){
+				failed = true;
+				continue;
+			}
+			const block_window& win = windows[w];
+			GDALRasterBand* rb = sample_band(ds_thread->GetRasterBand(bands[win.band - 1]), opt);
+			size_t count = size_t(win.xsize) * win.ysize;
+			arr.resize(count);
+			CPLErr err = rb->RasterIO(GF_Read, win.x, win.y, win.xsize, win.ysize, arr.data(), win.xsize, win.ysize, GDT_Float64, 0, 0);
+			if(err != CE_None){
+#pragma omp critical(compute_raster_statistics_err)
+				{
+					failed = true;
+					err_msg = CPLGetLastErrorMsg();
+				}
+				continue;
+			}
+			func(acc, win, arr.data(), count);
+		}
+
+#pragma omp critical(compute_raster_statistics_merge)
+		{
+			merge(acc);
+		}
+
+		if(ds_thread)
+			GDALClose(ds_thread);
+	}
+
+	if(failed)
+		return funcrst(false, fmt::format("compute_raster_statistics, read '{}' failed. ({})", img_path, err_msg));
+	return funcrst(true, "for_each_window finished.");
+}
+
+}
+
+funcrst compute_raster_statistics(std::string img_path, const raster_statistics_options& opt, std::vector<band_statistics>& stats)
+{
+	GDALDataset* ds = (GDALDataset*)GDALOpen(img_path.c_str(), GA_ReadOnly);
+	if(!ds)
+		return funcrst(false, fmt::format("compute_raster_statistics, open '{}' failed.", img_path));
+
+	std::vector<int> bands = opt.bands;
+	if(bands.empty()){
+		for(int b = 1; b <= ds->GetRasterCount(); b++)
+			bands.push_back(b);
+	}
+	for(int b : bands){
+		if(b < 1 || b > ds->GetRasterCount()){
+			GDALClose(ds);
+			return funcrst(false, fmt::format("compute_raster_statistics, band({}) is out of range [1,{}].", b, ds->GetRasterCount()));
+		}
+	}
+	int num_bands = int(bands.size());
+
+	/// 需要直方图时, 8/16位整数在统计最值的同时逐值计数, 其余类型在得到最值后再遍历一次
+	stats.assign(num_bands, band_statistics());
+	std::vector<value_counts> counts(num_bands);
+	for(int k = 0; k < num_bands; k++){
+		GDALRasterBand* rb = ds->GetRasterBand(bands[k]);
+		int has_nodata = 0;
+		double nodata = rb->GetNoDataValue(&has_nodata);
+		stats[k].band = bands[k];
+		stats[k].has_nodata = has_nodata != 0;
+		stats[k].nodata = nodata;
+		stats[k].use_sketch = opt.quantiles;
+		if(opt.histogram_size > 0)
+			counts[k].init(rb->GetRasterDataType());
+	}
+
+	/// 窗口按第一个波段(或其概视图)的block划分, window.band为bands中的序号(从1开始)
+	GDALRasterBand* rb_first = ds->GetRasterBand(bands[0]);
+	GDALRasterBand* rb_sample = sample_band(rb_first, opt);
+	bool use_overview = (rb_sample != rb_first);
+	std::vector<block_window> windows = split_block_windows(rb_sample, num_bands);
+	if(opt.approx && !use_overview && opt.sample_step > 1){
+		/// 每个波段的窗口数相同且连续存放, 在波段内每sample_step个窗口取一个, 保证每个波段都有采样
+		size_t per_band = windows.size() / num_bands;
+		std::vector<block_window> sampled;
+		for(size_t w = 0; w < windows.size(); w++)
+			if((w % per_band) % opt.sample_step == 0)
+				sampled.push_back(windows[w]);
+		windows.swap(sampled);
+	}
+	GDALClose(ds);
+
+	statistics_acc init{ stats, counts };
+	funcrst rst = for_each_window(img_path, bands, windows, opt, init,
+		[](statistics_acc& acc, const block_window& win, double* arr, size_t count){
+			size_t valid = accumulate_window(arr, count, acc.stats[win.band - 1]);
+			acc.counts[win.band - 1].add(arr, valid);
+		},
+		[&](const statistics_acc& acc){
+			for(int k = 0; k < num_bands; k++){
+				stats[k].merge(acc.stats[k]);
+				counts[k].merge(acc.counts[k]);
+			}
+		});
+	if(!rst)
+		return rst;
+
+	/// 逐值计数的波段直接重新分箱; 浮点与32位整数得到最值后只对这些波段再遍历一次, 统计精确直方图
+	std::vector<block_window> rest;
+	if(opt.histogram_size > 0){
+		for(int k = 0; k < num_bands; k++)
+			if(counts[k].valid())
+				stats[k].histogram = counts[k].histogram(stats[k], opt.histogram_size);
+		for(const block_window& win : windows)
+			if(!counts[win.band - 1].valid())
+				rest.push_back(win);
+	}
+
+	if(!rest.empty()){
+		std::vector<std::vector<uint64_t>> hists(num_bands, std::vector<uint64_t>(opt.histogram_size, 0));
+		rst = for_each_window(img_path, bands, rest, opt, hists,
+			[&](std::vector<std::vector<uint64_t>>& acc, const block_window& win, double* arr, size_t count){
+				accumulate_histogram(arr, count, stats[win.band - 1], acc[win.band - 1]);
+			},
+			[&](const std::vector<std::vector<uint64_t>>& acc){
+				for(int k = 0; k < num_bands; k++)
+					for(int i = 0; i < opt.histogram_size; i++)
+						hists[k][i] += acc[k][i];
+			});
+		if(!rst)
+			return rst;
+		for(int k = 0; k < num_bands; k++)
+			if(!counts[k].valid())
+				stats[k].histogram.swap(hists[k]);
+	}
+
+	return funcrst(true, "compute_raster_statistics finished.");
+}
+
+funcrst compute_band_statistics(GDALRasterBand* rb, bool quantiles, band_statistics& st, int histogram_size)
+{
+	if(rb == nullptr)
+		return funcrst(false, "compute_band_statistics, rb is nullptr.");
+
+	st = band_statistics();
+	int has_nodata = 0;
+	double nodata = rb->GetNoDataValue(&has_nodata);
+	st.band = rb->GetBand();
+	st.has_nodata = has_nodata != 0;
+	st.nodata = nodata;
+	st.use_sketch = quantiles;
+
+	value_counts counts;
+	if(histogram_size > 0)
+		counts.init(rb->GetRasterDataType());
+
+	std::vector<block_window> windows = split_block_windows(rb, 1);
+	std::vector<double> arr;
+	for(const block_window& win : windows){
+		size_t count = size_t(win.xsize) * win.ysize;
+		arr.resize(count);
+		CPLErr err = rb->RasterIO(GF_Read, win.x, win.y, win.xsize, win.ysize, arr.data(), win.xsize, win.ysize, GDT_Float64, 0, 0);
+		if(err != CE_None)
+			return funcrst(false, fmt::format("compute_band_statistics, RasterIO failed. ({})", CPLGetLastErrorMsg()));
+		size_t valid = accumulate_window(arr.data(), count, st);
+		counts.add(arr.data(), valid);
+	}
+
+	if(histogram_size > 0 && counts.valid()){
+		st.histogram = counts.histogram(st, histogram_size);
+	}
+	else if(histogram_size > 0){
+		std::vector<uint64_t> hist(histogram_size, 0);
+		for(const block_window& win : windows){
+			size_t count = size_t(win.xsize) * win.ysize;
+			arr.resize(count);
+			CPLErr err = rb->RasterIO(GF_Read, win.x, win.y, win.xsize, win.ysize, arr.data(), win.xsize, win.ysize, GDT_Float64, 0, 0);
+			if(err != CE_None)
+				return funcrst(false, fmt::format("compute_band_statistics, RasterIO failed. ({})", CPLGetLastErrorMsg()));
+			accumulate_histogram(arr.data(), count, st, hist);
+		}
+		st.histogram.swap(hist);
+	}
+	return funcrst(true, "compute_band_statistics finished.");
+}
+
+funcrst cal_stretched_minmax(const band_statistics& st, int histogram_size, double stretch_rate, double& min, double& max)
+{
+	if(st.count == 0)
+		return funcrst(false, "cal_stretched_minmax, band has no valid value.");
+
+	if(int(st.histogram.size()) == histogram_size)
+		return cal_stretched_minmax(st.histogram, st.min, st.max, stretch_rate, min, max);
+
+	if(!st.use_sketch)
+		return funcrst(false, fmt::format("cal_stretched_minmax, band_statistics has neither a histogram of size {} nor a quantile sketch.", histogram_size));
+	std::vector<uint64_t> histogram = st.sketch.histogram(st.min, st.max, histogram_size);
+	return cal_stretched_minmax(histogram, st.min, st.max, stretch_rate, min, max);
+}
+
+funcrst cal_stretched_minmax(GDALRasterBand* rb, int histogram_size, double stretch_rate, double& min, double& max)
+{
+	band_statistics st;
+	funcrst rst = compute_band_statistics(rb, false, st, histogram_size);
+	if(!rst)
+		return rst;
+	return cal_stretched_minmax(st, histogram_size, stretch_rate, min, max);
+}
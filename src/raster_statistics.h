@@ -0,0 +1,98 @@
+#ifndef RASTER_STATISTICS_H
+#define RASTER_STATISTICS_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include <gdal_priv.h>
+
+#include "datatype.h"
+
+/// 栅格统计模块: 一次并行遍历(按block对齐的窗口)统计所有波段的最值, 均值, 标准差, nodata与nan的数量, 以及可选的分位数.
+/// 每个线程独立打开数据集并维护自己的累加器, 遍历结束后合并; 均值与方差使用Welford算法, 合并时使用Chan的并行公式.
+/// 分位数基于固定分箱的草图(sketch): float的位模式映射为保序的32位整数, 取高16位为箱号,
+/// 即按符号+指数+7位尾数分箱, 共65536个箱, 与数值范围无关, 所以不需要预先知道最值; 插值后的相对误差不超过2^-8.
+/// 草图的箱宽与数值大小成正比(如1024~2048之间为8), 数值范围窄而量级大时不足以划分直方图,
+/// 所以拉伸所需的直方图按[min, max]等间隔精确统计(histogram_size): 8/16位整数在统计最值的同一次遍历中逐值计数(至多65536个箱),
+/// 得到最值后重新分箱; 浮点与32位整数的取值无法逐值计数, 得到最值后再遍历一次.
+
+/// @brief 固定分箱的分位数草图, 可合并
+class quantile_sketch
+{
+public:
+	static constexpr int bins = 1 << 16;
+
+	void add(double value);
+	void merge(const quantile_sketch& other);
+	bool empty() const { return m_count == 0; }
+	uint64_t count() const { return m_count; }
+
+	/// @brief p within [0,1], 箱内按线性插值, 并限制在[min, max]内
+	double quantile(double p, double min, double max) const;
+
+	/// @brief 将草图重新统计为[min, max]内等间隔的size个直方图箱(与GDALRasterBand::GetHistogram的划分方式一致),
+	/// 草图的每个箱视为均匀分布, 计数按重叠长度分摊到各直方图箱, 只是近似值
+	std::vector<uint64_t> histogram(double min, double max, int size) const;
+
+private:
+	static uint32_t bin_of(double value);
+	static double bin_lower(uint32_t bin);
+	static double bin_upper(uint32_t bin);
+
+	std::vector<uint64_t> m_bins;
+	uint64_t m_count{ 0 };
+};
+
+/// @brief 单个波段的统计结果/累加器
+struct band_statistics
+{
+	int band{ 0 };
+	uint64_t count{ 0 };		///< 有效值数量(不含nodata与nan)
+	uint64_t nodata_count{ 0 };
+	uint64_t nan_count{ 0 };
+	double min{ 0 }, max{ 0 };
+	double mean{ 0 };
+	double m2{ 0 };				///< 离差平方和, Welford
+	bool has_nodata{ false };
+	double nodata{ 0 };
+	bool use_sketch{ false };
+	quantile_sketch sketch;
+	std::vector<uint64_t> histogram;	///< [min, max]内等间隔的精确直方图, 等于max的值归入最后一箱, 未统计时为空
+
+	void add(double value);
+	void merge(const band_statistics& other);
+
+	double variance() const { return count == 0 ? 0 : m2 / count; }
+	double stddev() const;
+	double quantile(double p) const { return sketch.quantile(p, min, max); }
+};
+
+struct raster_statistics_options
+{
+	std::vector<int> bands;		///< 需要统计的波段(从1开始), 为空时统计所有波段
+	bool quantiles{ false };	///< 是否维护分位数草图
+	int histogram_size{ 0 };	///< 大于0时统计histogram_size个箱的精确直方图(浮点与32位整数需要再遍历一次)
+	bool approx{ false };		///< 近似统计: 优先读取概视图(overview), 没有概视图时每sample_step个窗口读取一个
+	int sample_step{ 10 };
+	size_t approx_pixels{ size_t(1) << 22 };	///< 近似统计时期望的概视图像素数
+};
+
+/// @brief 统计影像各波段的信息, 支持所有非复数类型, 复数按实部统计
+funcrst compute_raster_statistics(std::string img_path, const raster_statistics_options& opt, std::vector<band_statistics>& stats);
+
+/// @brief 单线程统计一个波段(rb所在数据集不能同时在其他线程中使用), 按block对齐的窗口读取
+/// @param histogram_size 大于0时统计精确直方图, 浮点与32位整数需要再遍历一次
+funcrst compute_band_statistics(GDALRasterBand* rb, bool quantiles, band_statistics& st, int histogram_size = 0);
+
+/// @brief 得到最值与精确直方图(8/16位整数一次遍历, 其余类型两次), 再按stretch_rate获取拉伸后的最值
+/// @param rb RasterBand, 图像的某个波段
+/// @param histogram_size 直方图长度, 通常为100~256
+/// @param stretch_rate 拉伸比例, 通常为 0.02
+funcrst cal_stretched_minmax(GDALRasterBand* rb, int histogram_size, double stretch_rate, double& min, double& max);
+
+/// @brief 由已统计的结果获取拉伸后的最值, 优先使用长度为histogram_size的精确直方图(与cal_stretched_minmax(rb, ...)的结果一致),
+/// 没有时由分位数草图近似重新统计
+funcrst cal_stretched_minmax(const band_statistics& st, int histogram_size, double stretch_rate, double& min, double& max);
+
+#endif // RASTER_STATISTICS_H
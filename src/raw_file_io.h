@@ -0,0 +1,393 @@
+#ifndef RAW_FILE_IO_H
+#define RAW_FILE_IO_H
+
+#include <string>
+#include <vector>
+#include <complex>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <type_traits>
+
+#include "datatype.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define RAW_IO_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+/// 原始二进制栅格(binary + vrt)的读写层:
+/// 1. swap_byte_order: 按块交换字节序, x86上使用ssse3的字节重排(pshufb), 复数按实部与虚部分别交换;
+/// 2. raw_file: 按偏移量读写(pread/pwrite, windows下为带OVERLAPPED偏移的ReadFile/WriteFile), 不依赖文件指针,
+///    所以多个线程可以同时写互不重叠的区间; 可选direct io(O_DIRECT / FILE_FLAG_NO_BUFFERING),
+///    此时按4096字节对齐的部分绕过系统缓存直接写入, 首尾不对齐的部分仍使用普通写入.
+
+/// ---------------------------------------- byte swap ----------------------------------------
+
+/// gcc/clang需要为单个函数开启指令集, msvc可以直接使用intrinsics
+#if defined(RAW_IO_X86) && defined(__GNUC__)
+#define RAW_IO_TARGET_SSSE3 __attribute__((target("ssse3")))
+#else
+#define RAW_IO_TARGET_SSSE3
+#endif
+
+namespace raw_io_detail {
+
+inline uint16_t bswap(uint16_t v) { return uint16_t((v >> 8) | (v << 8)); }
+inline uint32_t bswap(uint32_t v) { return (v >> 24) | ((v >> 8) & 0xff00u) | ((v << 8) & 0xff0000u) | (v << 24); }
+inline uint64_t bswap(uint64_t v) { return (uint64_t(bswap(uint32_t(v))) << 32) | bswap(uint32_t(v >> 32)); }
+
+template<typename _Uint>
+inline void swap_scalar(unsigned char* data, size_t count)
+{
+    for(size_t i = 0; i < count; i++){
+        _Uint v;
+        std::memcpy(&v, data + i * sizeof(_Uint), sizeof(_Uint));
+        v = bswap(v);
+        std::memcpy(data + i * sizeof(_Uint), &v, sizeof(_Uint));
+    }
+}
+
+#ifdef RAW_IO_X86
+/// @brief 每16字节一次pshufb, 返回已处理的元素数
+template<int _Width>
+RAW_IO_TARGET_SSSE3 inline size_t swap_ssse3(unsigned char* data, size_t count)
+{
+    alignas(16) unsigned char order[16];
+    for(int i = 0; i < 16; i++)
+        order[i] = (unsigned char)(i - i % _Width + (_Width - 1 - i % _Width));
+    __m128i mask = _mm_load_si128((const __m128i*)order);
+
+    size_t bytes = count * _Width;
+    size_t i = 0;
+    for(; i + 64 <= bytes; i += 64){
+        __m128i a = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(data + i + 16));
+        __m128i c = _mm_loadu_si128((const __m128i*)(data + i + 32));
+        __m128i d = _mm_loadu_si128((const __m128i*)(data + i + 48));
+        _mm_storeu_si128((__m128i*)(data + i), _mm_shuffle_epi8(a, mask));
+        _mm_storeu_si128((__m128i*)(data + i + 16), _mm_shuffle_epi8(b, mask));
+        _mm_storeu_si128((__m128i*)(data + i + 32), _mm_shuffle_epi8(c, mask));
+        _mm_storeu_si128((__m128i*)(data + i + 48), _mm_shuffle_epi8(d, mask));
+    }
+    for(; i + 16 <= bytes; i += 16)
+        _mm_storeu_si128((__m128i*)(data + i), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + i)), mask));
+    return i / _Width;
+}
+
+inline bool cpu_has_ssse3()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 9)) != 0;
+#elif defined(__GNUC__)
+    return __builtin_cpu_supports("ssse3");
+#else
+    return false;
+#endif
+}
+#endif
+
+/// @brief 交换count个宽度为width(1, 2, 4, 8)字节的元素
+inline void swap_elements(unsigned char* data, size_t count, int width)
+{
+    size_t done = 0;
+#ifdef RAW_IO_X86
+    static const bool ssse3 = cpu_has_ssse3();
+    if(ssse3){
+        switch (width)
+        {
+        case 2: done = swap_ssse3<2>(data, count); break;
+        case 4: done = swap_ssse3<4>(data, count); break;
+        case 8: done = swap_ssse3<8>(data, count); break;
+        default: break;
+        }
+    }
+#endif
+    data += done * width;
+    count -= done;
+    switch (width)
+    {
+    case 2: swap_scalar<uint16_t>(data, count); break;
+    case 4: swap_scalar<uint32_t>(data, count); break;
+    case 8: swap_scalar<uint64_t>(data, count); break;
+    default: break;
+    }
+}
+
+template<typename _Ty> struct component_of { using type = _Ty; };
+template<typename _Ty> struct component_of<std::complex<_Ty>> { using type = _Ty; };
+
+}
+
+/// @brief 原地交换数组的字节序(大端 <-> 小端), 复数类型按实部与虚部分别交换
+template<typename _Ty>
+inline void swap_byte_order(_Ty* arr, size_t length)
+{
+    using component = typename raw_io_detail::component_of<_Ty>::type;
+    static_assert(std::is_arithmetic<component>::value, "swap_byte_order, unsupported type.");
+    constexpr size_t per_element = sizeof(_Ty) / sizeof(component);
+    raw_io_detail::swap_elements((unsigned char*)arr, length * per_element, int(sizeof(component)));
+}
+
+/// @brief 原地交换count个datatype类型数据的字节序, 复数类型按实部与虚部分别交换
+inline void swap_byte_order(void* data, size_t count, GDALDataType datatype)
+{
+    int components = GDALDataTypeIsComplex(datatype) ? 2 : 1;
+    int width = GDALGetDataTypeSizeBytes(datatype) / components;
+    raw_io_detail::swap_elements((unsigned char*)data, count * components, width);
+}
+
+/// @brief 本机是否为小端存储
+inline bool machine_is_lsb()
+{
+    const uint16_t v = 1;
+    unsigned char c;
+    std::memcpy(&c, &v, 1);
+    return c == 1;
+}
+
+/// @brief 按byte_order存储的数据与本机字节序是否不同(需要交换)
+inline bool need_swap(ByteOrder_ byte_order)
+{
+    return (byte_order == ByteOrder_::LSB) != machine_is_lsb();
+}
+
+/// ---------------------------------------- raw file ----------------------------------------
+
+/// @brief 对齐的缓冲区, direct io要求内存地址对齐
+class aligned_buffer
+{
+public:
+    static constexpr size_t alignment = 4096;
+
+    aligned_buffer() {}
+    aligned_buffer(const aligned_buffer&) = delete;
+    aligned_buffer& operator=(const aligned_buffer&) = delete;
+    ~aligned_buffer() { release(); }
+
+    unsigned char* data() { return m_data; }
+    size_t size() const { return m_size; }
+
+    /// @brief 容量不足时重新申请, 不保留原有内容
+    unsigned char* reserve(size_t size)
+    {
+        if(size > m_size){
+            release();
+            size_t bytes = (size + alignment - 1) / alignment * alignment;
+#ifdef _WIN32
+            m_data = (unsigned char*)_aligned_malloc(bytes, alignment);
+#else
+            m_data = (unsigned char*)std::aligned_alloc(alignment, bytes);
+#endif
+            m_size = m_data ? bytes : 0;
+        }
+        return m_data;
+    }
+
+private:
+    void release()
+    {
+#ifdef _WIN32
+        _aligned_free(m_data);
+#else
+        std::free(m_data);
+#endif
+        m_data = nullptr;
+        m_size = 0;
+    }
+
+    unsigned char* m_data{ nullptr };
+    size_t m_size{ 0 };
+};
+
+/// @brief 按偏移量读写的原始文件, read_at与write_at可以在多个线程中同时调用(区间不重叠时)
+class raw_file
+{
+public:
+    static constexpr size_t alignment = aligned_buffer::alignment;
+
+    raw_file() {}
+    raw_file(const raw_file&) = delete;
+    raw_file& operator=(const raw_file&) = delete;
+    ~raw_file() { close(); }
+
+    /// @brief 打开文件
+    /// @param write true时创建(覆盖)文件, 并预分配为size字节
+    /// @param direct_io 写入时绕过系统缓存, 平台不支持时自动退化为普通写入
+    funcrst open(std::string path, bool write, uint64_t size = 0, bool direct_io = false)
+    {
+        close();
+        m_path = path;
+#ifdef _WIN32
+        DWORD access = write ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ;
+        DWORD share = FILE_SHARE_READ | FILE_SHARE_WRITE;
+        m_file = CreateFileA(path.c_str(), access, share, NULL, write ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if(m_file == INVALID_HANDLE_VALUE)
+            return funcrst(false, "raw_file::open, open '" + path + "' failed.");
+        if(write){
+            LARGE_INTEGER li; li.QuadPart = LONGLONG(size);
+            if(!SetFilePointerEx(m_file, li, NULL, FILE_BEGIN) || !SetEndOfFile(m_file)){
+                close();
+                return funcrst(false, "raw_file::open, resize '" + path + "' failed.");
+            }
+            if(direct_io)
+                m_direct = CreateFileA(path.c_str(), GENERIC_WRITE, share, NULL, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH, NULL);
+        }
+#else
+        m_file = ::open(path.c_str(), write ? (O_RDWR | O_CREAT | O_TRUNC) : O_RDONLY, 0644);
+        if(m_file < 0)
+            return funcrst(false, "raw_file::open, open '" + path + "' failed.");
+        if(write){
+            if(::ftruncate(m_file, off_t(size)) != 0){
+                close();
+                return funcrst(false, "raw_file::open, resize '" + path + "' failed.");
+            }
+#ifdef O_DIRECT
+            if(direct_io)
+                m_direct = ::open(path.c_str(), O_WRONLY | O_DIRECT);
+#endif
+        }
+#endif
+        m_write = write;
+        return funcrst(true, "raw_file::open success.");
+    }
+
+    bool is_open() const { return m_file != invalid_handle(); }
+    bool direct() const { return m_direct != invalid_handle(); }
+
+    /// @brief 在offset处写入size字节, 开启direct io时, 按alignment对齐的中间部分直接写入,
+    /// data的对应地址未对齐时先拷贝到线程内的对齐缓冲区
+    funcrst write_at(uint64_t offset, const void* data, size_t size)
+    {
+        if(!m_write)
+            return funcrst(false, "raw_file::write_at, file is not opened for writing.");
+        const unsigned char* ptr = (const unsigned char*)data;
+
+        if(direct()){
+            uint64_t begin = (offset + alignment - 1) / alignment * alignment;
+            uint64_t end = (offset + size) / alignment * alignment;
+            if(end > begin){
+                const unsigned char* mid = ptr + (begin - offset);
+                size_t mid_size = size_t(end - begin);
+                if(uintptr_t(mid) % alignment != 0){
+                    thread_local aligned_buffer buffer;
+                    unsigned char* aligned = buffer.reserve(mid_size);
+                    if(!aligned)
+                        return funcrst(false, "raw_file::write_at, aligned buffer alloc failed.");
+                    std::memcpy(aligned, mid, mid_size);
+                    mid = aligned;
+                }
+                if(!write_all(m_direct, mid, mid_size, begin))
+                    return funcrst(false, "raw_file::write_at, direct write '" + m_path + "' failed.");
+                if(!write_all(m_file, ptr, size_t(begin - offset), offset) ||
+                   !write_all(m_file, ptr + (end - offset), size_t(offset + size - end), end))
+                    return funcrst(false, "raw_file::write_at, write '" + m_path + "' failed.");
+                return funcrst(true, "raw_file::write_at success.");
+            }
+        }
+
+        if(!write_all(m_file, ptr, size, offset))
+            return funcrst(false, "raw_file::write_at, write '" + m_path + "' failed.");
+        return funcrst(true, "raw_file::write_at success.");
+    }
+
+    /// @brief 从offset处读取size字节, 文件长度不足时返回false
+    funcrst read_at(uint64_t offset, void* data, size_t size)
+    {
+        unsigned char* ptr = (unsigned char*)data;
+        while(size > 0){
+            size_t chunk = std::min(size, max_chunk);
+#ifdef _WIN32
+            OVERLAPPED ov{};
+            ov.Offset = DWORD(offset & 0xffffffffu);
+            ov.OffsetHigh = DWORD(offset >> 32);
+            DWORD got = 0;
+            if(!ReadFile(m_file, ptr, DWORD(chunk), &got, &ov) || got == 0)
+                return funcrst(false, "raw_file::read_at, read '" + m_path + "' failed.");
+#else
+            ssize_t got = ::pread(m_file, ptr, chunk, off_t(offset));
+            if(got <= 0)
+                return funcrst(false, "raw_file::read_at, read '" + m_path + "' failed.");
+#endif
+            ptr += got;
+            offset += uint64_t(got);
+            size -= size_t(got);
+        }
+        return funcrst(true, "raw_file::read_at success.");
+    }
+
+    void close()
+    {
+#ifdef _WIN32
+        if(m_direct != INVALID_HANDLE_VALUE)
+            CloseHandle(m_direct);
+        if(m_file != INVALID_HANDLE_VALUE)
+            CloseHandle(m_file);
+        m_direct = m_file = INVALID_HANDLE_VALUE;
+#else
+        if(m_direct >= 0)
+            ::close(m_direct);
+        if(m_file >= 0)
+            ::close(m_file);
+        m_direct = m_file = -1;
+#endif
+        m_write = false;
+    }
+
+private:
+#ifdef _WIN32
+    using handle = HANDLE;
+    static handle invalid_handle() { return INVALID_HANDLE_VALUE; }
+#else
+    using handle = int;
+    static handle invalid_handle() { return -1; }
+#endif
+    static constexpr size_t max_chunk = size_t(1) << 30;
+
+    static bool write_all(handle h, const unsigned char* ptr, size_t size, uint64_t offset)
+    {
+        while(size > 0){
+            size_t chunk = std::min(size, max_chunk);
+#ifdef _WIN32
+            OVERLAPPED ov{};
+            ov.Offset = DWORD(offset & 0xffffffffu);
+            ov.OffsetHigh = DWORD(offset >> 32);
+            DWORD put = 0;
+            if(!WriteFile(h, ptr, DWORD(chunk), &put, &ov) || put == 0)
+                return false;
+#else
+            ssize_t put = ::pwrite(h, ptr, chunk, off_t(offset));
+            if(put <= 0)
+                return false;
+#endif
+            ptr += put;
+            offset += uint64_t(put);
+            size -= size_t(put);
+        }
+        return true;
+    }
+
+    handle m_file{ invalid_handle() };
+    handle m_direct{ invalid_handle() };
+    bool m_write{ false };
+    std::string m_path;
+};
+
+#endif // RAW_FILE_IO_H
@@ -0,0 +1,192 @@
+/**
+ * @file raw_raster_benchmark.cpp
+ * @author li-tann (li-tann@github.com)
+ * @brief raw_raster_view(内存映射)与GDAL读取raw vrt的耗时对比(冷缓存与热缓存), 用法: raw_raster_benchmark [width] [height] [windows] [dir]
+ * @version 0.1
+ * @date 2024-07-10
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <complex>
+#include <functional>
+#include <filesystem>
+
+#include <fmt/format.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+#include "binary_write.h"
+#include "raw_raster_view.h"
+
+using namespace std;
+
+/// @brief 重复执行func共repeat次, 返回单次平均耗时(ms)
+double time_ms(std::function<void()> func, int repeat)
+{
+	auto start = chrono::system_clock::now();
+	for(int i = 0; i < repeat; i++)
+		func();
+	return spend_time(start) * 1000 / repeat;
+}
+
+/// @brief 将文件移出系统页缓存(posix_fadvise DONTNEED), 之后的读取为冷缓存; 不支持时返回false
+bool drop_page_cache(const string& path)
+{
+#ifdef _WIN32
+	return false;
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if(fd < 0)
+		return false;
+	fdatasync(fd);	/// 脏页不会被移出, 先写回
+	bool ok = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+	::close(fd);
+	return ok;
+#endif
+}
+
+int main(int argc, char* argv[])
+{
+	int width   = argc > 1 ? stoi(argv[1]) : 8192;
+	int height  = argc > 2 ? stoi(argv[2]) : 8192;
+	int windows = argc > 3 ? stoi(argv[3]) : 2000;
+	fs::path dir = argc > 4 ? fs::path(argv[4]) : fs::temp_directory_path();
+
+	GDALAllRegister();
+	std::mt19937 gen(0);
+	std::uniform_real_distribution<float> dist(-100.f, 100.f);
+
+	/// 生成大端存储的复数float数据(与SAR产品的常见格式一致)
+	string bin_path = (dir / "raw_raster_benchmark.bin").string();
+	{
+		binary_write<std::complex<float>> bw;
+		funcrst rst = bw.init(bin_path.c_str(), height, width, ByteOrder_::MSB);
+		if(!rst){
+			cout << rst.explain << endl;
+			return -1;
+		}
+		vector<std::complex<float>> row(width);
+		for(int i = 0; i < height; i++){
+			for(auto& v : row)
+				v = {dist(gen), dist(gen)};
+			bw.array_to_bin(row.data(), row.size());
+		}
+		bw.close();
+		bw.print_vrt();
+	}
+	string vrt_path = bin_path + ".vrt";
+
+	GDALDataset* ds = (GDALDataset*)GDALOpen(vrt_path.c_str(), GA_ReadOnly);
+	raw_raster_view view;
+	funcrst rst = view.open_vrt(vrt_path);
+	if(!ds || !rst){
+		cout << "open failed. " << rst.explain << endl;
+		return -2;
+	}
+	GDALRasterBand* rb = ds->GetRasterBand(1);
+
+	/// 冷缓存: 解除视图的映射(映射中的页不会被移出), 清空GDAL的block cache, 再将文件移出系统页缓存
+	bool cold = true;
+	auto drop_cache = [&]{
+		view.close();
+		rb->FlushCache();
+		cold = drop_page_cache(bin_path) && cold;
+		view.open_vrt(vrt_path);
+	};
+
+	/// 1. 按256行的条带顺序读取整幅影像, 视图在读取前按条带预读(与vrt_to_tif一致)
+	{
+		int strip = 256;
+		vector<std::complex<float>> a(size_t(strip) * width), b(a.size());
+		auto gdal_pass = [&]{
+			for(int row = 0; row < height; row += strip)
+				rb->RasterIO(GF_Read, 0, row, width, MIN(strip, height - row), a.data(), width, MIN(strip, height - row), GDT_CFloat32, 0, 0);
+		};
+		auto view_pass = [&]{
+			for(int row = 0; row < height; row += strip){
+				view.will_need(row, MIN(strip, height - row));
+				view.read(0, row, width, MIN(strip, height - row), b.data(), GDT_CFloat32);
+			}
+		};
+		drop_cache();
+		double c_gdal = time_ms(gdal_pass, 1);
+		drop_cache();
+		double c_view = time_ms(view_pass, 1);
+		double t_gdal = time_ms(gdal_pass, 3);
+		double t_view = time_ms(view_pass, 3);
+
+		bool same = true;
+		for(int row = 0; row < height && same; row += strip){
+			int rows = MIN(strip, height - row);
+			rb->RasterIO(GF_Read, 0, row, width, rows, a.data(), width, rows, GDT_CFloat32, 0, 0);
+			view.read(0, row, width, rows, b.data(), GDT_CFloat32);
+			same = std::equal(a.begin(), a.begin() + size_t(rows) * width, b.begin());
+		}
+
+		cout << fmt::format("{}x{} fcomplex (MSB), sequential strips of {} rows (time per pass), same result: {}\n", width, height, strip, same);
+		cout << fmt::format("  cold gdal RasterIO   : {:10.3f} ms\n", c_gdal);
+		cout << fmt::format("  cold raw_raster_view : {:10.3f} ms, x{:.1f}\n", c_view, c_gdal / c_view);
+		cout << fmt::format("  warm gdal RasterIO   : {:10.3f} ms\n", t_gdal);
+		cout << fmt::format("  warm raw_raster_view : {:10.3f} ms, x{:.1f}\n", t_view, t_gdal / t_view);
+	}
+
+	/// 2. 随机的512x512窗口(goldstein/快视图等按窗口访问的场景), 读取为fcomplex
+	{
+		int size = MIN(512, MIN(width, height));
+		std::uniform_int_distribution<int> dist_x(0, width - size), dist_y(0, height - size);
+		vector<pair<int, int>> origins(windows);
+		for(auto& o : origins)
+			o = {dist_x(gen), dist_y(gen)};
+		vector<std::complex<float>> a(size_t(size) * size), b(a.size());
+
+		auto gdal_pass = [&]{
+			for(auto& o : origins)
+				rb->RasterIO(GF_Read, o.first, o.second, size, size, a.data(), size, size, GDT_CFloat32, 0, 0);
+		};
+		auto view_pass = [&]{
+			for(auto& o : origins)
+				view.read(o.first, o.second, size, size, b.data(), GDT_CFloat32);
+		};
+		drop_cache();
+		double c_gdal = time_ms(gdal_pass, 1) / windows;
+		drop_cache();
+		double c_view = time_ms(view_pass, 1) / windows;
+		double t_gdal = time_ms(gdal_pass, 1) / windows;
+		double t_view = time_ms(view_pass, 1) / windows;
+
+		/// 逐个窗口比较
+		bool same = true;
+		for(size_t k = 0; k < origins.size() && same; k++){
+			rb->RasterIO(GF_Read, origins[k].first, origins[k].second, size, size, a.data(), size, size, GDT_CFloat32, 0, 0);
+			view.read(origins[k].first, origins[k].second, size, size, b.data(), GDT_CFloat32);
+			same = std::equal(a.begin(), a.end(), b.begin());
+		}
+
+		cout << fmt::format("{} random {}x{} windows (time per window), same result: {}\n", windows, size, size, same);
+		cout << fmt::format("  cold gdal RasterIO   : {:10.5f} ms\n", c_gdal);
+		cout << fmt::format("  cold raw_raster_view : {:10.5f} ms, x{:.1f}\n", c_view, c_gdal / c_view);
+		cout << fmt::format("  warm gdal RasterIO   : {:10.5f} ms\n", t_gdal);
+		cout << fmt::format("  warm raw_raster_view : {:10.5f} ms, x{:.1f}\n", t_view, t_gdal / t_view);
+	}
+
+	if(!cold)
+		cout << "page cache could not be dropped, 'cold' results above were measured with a warm page cache." << endl;
+
+	GDALClose(ds);
+	view.close();
+	fs::remove(bin_path);
+	fs::remove(vrt_path);
+	return 0;
+}
@@ -0,0 +1,186 @@
+#include "raw_raster_view.h"
+
+#include <vector>
+#include <filesystem>
+
+#include <cpl_minixml.h>
+#include <fmt/format.h>
+
+#include "raw_file_io.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+namespace fs = std::filesystem;
+
+funcrst raw_raster_view::open(std::string bin_path, int width, int height, GDALDataType datatype, ByteOrder_ byte_order,
+	uint64_t image_offset, int pixel_offset, int64_t line_offset)
+{
+	close();
+
+	int datasize = GDALGetDataTypeSizeBytes(datatype);
+	if(width < 1 || height < 1 || datasize < 1)
+		return funcrst(false, fmt::format("raw_raster_view::open, invalid size ({}x{}) or datatype ({}).", width, height, GDALGetDataTypeName(datatype)));
+	if(pixel_offset == 0)
+		pixel_offset = datasize;
+	if(line_offset == 0)
+		line_offset = int64_t(pixel_offset) * width;
+	if(pixel_offset < datasize || line_offset < int64_t(pixel_offset) * (width - 1) + datasize)
+		return funcrst(false, fmt::format("raw_raster_view::open, unsupported pixel_offset ({}) or line_offset ({}).", pixel_offset, line_offset));
+
+	uint64_t required = image_offset + uint64_t(line_offset) * (height - 1) + uint64_t(pixel_offset) * (width - 1) + datasize;
+	std::error_code ec;
+	uint64_t file_size = fs::file_size(bin_path, ec);
+	if(ec || file_size < required)
+		return funcrst(false, fmt::format("raw_raster_view::open, '{}' is smaller than {} bytes.", bin_path, required));
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(bin_path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+	if(file == INVALID_HANDLE_VALUE)
+		return funcrst(false, fmt::format("raw_raster_view::open, open '{}' failed.", bin_path));
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	void* base = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if(base == nullptr){
+		if(mapping)
+			CloseHandle(mapping);
+		CloseHandle(file);
+		return funcrst(false, fmt::format("raw_raster_view::open, map '{}' failed.", bin_path));
+	}
+	m_file = file;
+	m_mapping = mapping;
+#else
+	int fd = ::open(bin_path.c_str(), O_RDONLY);
+	if(fd < 0)
+		return funcrst(false, fmt::format("raw_raster_view::open, open '{}' failed.", bin_path));
+	void* base = mmap(nullptr, size_t(file_size), PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);	/// 映射建立后即可关闭文件描述符
+	if(base == MAP_FAILED)
+		return funcrst(false, fmt::format("raw_raster_view::open, mmap '{}' failed.", bin_path));
+	/// 窗口读取的访问模式不固定, 关闭整文件的顺序预读, 需要时由will_need按窗口预读
+	madvise(base, size_t(file_size), MADV_RANDOM);
+#endif
+
+	m_base = (unsigned char*)base;
+	m_size = file_size;
+	m_width = width;
+	m_height = height;
+	m_datatype = datatype;
+	m_swap = need_swap(byte_order);
+	m_image_offset = image_offset;
+	m_pixel_offset = pixel_offset;
+	m_line_offset = line_offset;
+	return funcrst(true, "raw_raster_view::open success.");
+}
+
+funcrst raw_raster_view::open_vrt(std::string vrt_path, int band)
+{
+	CPLXMLNode* root = CPLParseXMLFile(vrt_path.c_str());
+	if(root == nullptr)
+		return funcrst(false, fmt::format("raw_raster_view::open_vrt, parse '{}' failed.", vrt_path));
+
+	funcrst rst(false, fmt::format("raw_raster_view::open_vrt, band {} of '{}' is not a VRTRawRasterBand.", band, vrt_path));
+	CPLXMLNode* ds_node = CPLGetXMLNode(root, "=VRTDataset");
+	int index = 0;
+	for(CPLXMLNode* node = ds_node ? ds_node->psChild : nullptr; node != nullptr; node = node->psNext)
+	{
+		if(node->eType != CXT_Element || std::string(node->pszValue) != "VRTRasterBand")
+			continue;
+		index++;
+		if(atoi(CPLGetXMLValue(node, "band", std::to_string(index).c_str())) != band)
+			continue;
+		if(!EQUAL(CPLGetXMLValue(node, "subClass", ""), "VRTRawRasterBand"))
+			break;
+
+		int width = atoi(CPLGetXMLValue(ds_node, "rasterXSize", "0"));
+		int height = atoi(CPLGetXMLValue(ds_node, "rasterYSize", "0"));
+		GDALDataType datatype = GDALGetDataTypeByName(CPLGetXMLValue(node, "dataType", "Byte"));
+
+		fs::path bin_path(CPLGetXMLValue(node, "SourceFilename", ""));
+		if(CPLTestBool(CPLGetXMLValue(node, "SourceFilename.relativeToVRT", "0")))
+			bin_path = fs::path(vrt_path).parent_path() / bin_path;
+
+		/// ByteOrder缺省时为本机字节序
+		std::string str_byteorder = CPLGetXMLValue(node, "ByteOrder", machine_is_lsb() ? "LSB" : "MSB");
+		ByteOrder_ byte_order = EQUAL(str_byteorder.c_str(), "MSB") ? ByteOrder_::MSB : ByteOrder_::LSB;
+
+		rst = open(bin_path.string(), width, height, datatype, byte_order,
+			std::stoull(CPLGetXMLValue(node, "ImageOffset", "0")),
+			atoi(CPLGetXMLValue(node, "PixelOffset", "0")),
+			std::stoll(CPLGetXMLValue(node, "LineOffset", "0")));
+		break;
+	}
+
+	CPLDestroyXMLNode(root);
+	return rst;
+}
+
+void raw_raster_view::close()
+{
+	if(m_base == nullptr)
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(m_base);
+	CloseHandle((HANDLE)m_mapping);
+	CloseHandle((HANDLE)m_file);
+	m_mapping = m_file = nullptr;
+#else
+	munmap(m_base, size_t(m_size));
+#endif
+	m_base = nullptr;
+	m_size = 0;
+}
+
+funcrst raw_raster_view::read(int x, int y, int xsize, int ysize, void* buf, GDALDataType buf_type, GSpacing buf_line_space) const
+{
+	if(!is_open())
+		return funcrst(false, "raw_raster_view::read, view is not opened.");
+	if(x < 0 || y < 0 || xsize < 1 || ysize < 1 || x + xsize > m_width || y + ysize > m_height)
+		return funcrst(false, fmt::format("raw_raster_view::read, window [{},{},{},{}] is out of image.", x, y, xsize, ysize));
+
+	int datasize = GDALGetDataTypeSizeBytes(m_datatype);
+	int buf_size = GDALGetDataTypeSizeBytes(buf_type);
+	if(buf_line_space == 0)
+		buf_line_space = GSpacing(xsize) * buf_size;
+
+	/// 需要交换字节序时, 先拷贝到线程内的缓冲区, 交换后再转换类型
+	thread_local std::vector<unsigned char> scratch;
+	if(m_swap)
+		scratch.resize(size_t(xsize) * datasize);
+
+	for(int i = 0; i < ysize; i++)
+	{
+		const unsigned char* src = pixel(x, y + i);
+		unsigned char* dst = (unsigned char*)buf + buf_line_space * i;
+		if(m_swap){
+			GDALCopyWords64(src, m_datatype, m_pixel_offset, scratch.data(), m_datatype, datasize, xsize);
+			swap_byte_order(scratch.data(), size_t(xsize), m_datatype);
+			GDALCopyWords64(scratch.data(), m_datatype, datasize, dst, buf_type, buf_size, xsize);
+		}
+		else{
+			GDALCopyWords64(src, m_datatype, m_pixel_offset, dst, buf_type, buf_size, xsize);
+		}
+	}
+	return funcrst(true, "raw_raster_view::read success.");
+}
+
+void raw_raster_view::will_need(int y, int ysize) const
+{
+#ifndef _WIN32
+	if(!is_open() || ysize < 1)
+		return;
+	y = MAX(0, y);
+	ysize = MIN(ysize, m_height - y);
+	if(ysize < 1)
+		return;
+	uint64_t begin = m_image_offset + uint64_t(y) * m_line_offset;
+	uint64_t end = MIN(m_size, m_image_offset + uint64_t(y + ysize) * m_line_offset);
+	uint64_t page = uint64_t(sysconf(_SC_PAGESIZE));
+	begin = begin / page * page;
+	if(end > begin)
+		madvise(m_base + begin, size_t(end - begin), MADV_WILLNEED);
+#else
+	(void)y;
+	(void)ysize;
+#endif
+}
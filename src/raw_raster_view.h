@@ -0,0 +1,70 @@
+#ifndef RAW_RASTER_VIEW_H
+#define RAW_RASTER_VIEW_H
+
+#include <string>
+#include <cstdint>
+
+#include <gdal_priv.h>
+
+#include "datatype.h"
+
+/// 原始二进制栅格(tif2vrt生成的binary + vrt, 或其他VRTRawRasterBand)的内存映射视图.
+/// 整个文件以只读方式映射到内存, 读取时直接从映射区拷贝(按需交换字节序, 转换数据类型), 不经过GDAL的block cache,
+/// 只有实际访问的窗口才会触发缺页读取. 视图本身只读且无内部状态, read可以在多个线程中同时调用.
+
+class raw_raster_view
+{
+public:
+	raw_raster_view() {}
+	raw_raster_view(const raw_raster_view&) = delete;
+	raw_raster_view& operator=(const raw_raster_view&) = delete;
+	~raw_raster_view() { close(); }
+
+	/// @brief 映射原始二进制文件
+	/// @param pixel_offset 相邻像素的字节间隔, 0表示数据类型的大小
+	/// @param line_offset 相邻行的字节间隔, 0表示pixel_offset * width
+	funcrst open(std::string bin_path, int width, int height, GDALDataType datatype, ByteOrder_ byte_order,
+		uint64_t image_offset = 0, int pixel_offset = 0, int64_t line_offset = 0);
+
+	/// @brief 解析vrt中的第band个波段(需要为VRTRawRasterBand), 并映射对应的二进制文件
+	funcrst open_vrt(std::string vrt_path, int band = 1);
+
+	void close();
+
+	bool is_open() const { return m_base != nullptr; }
+	int width() const { return m_width; }
+	int height() const { return m_height; }
+	GDALDataType datatype() const { return m_datatype; }
+	/// @brief 文件的字节序是否与本机不同
+	bool swapped() const { return m_swap; }
+
+	/// @brief 像素(x, y)在映射区中的地址(文件字节序)
+	const unsigned char* pixel(int x, int y) const
+	{
+		return m_base + m_image_offset + uint64_t(y) * m_line_offset + uint64_t(x) * m_pixel_offset;
+	}
+
+	/// @brief 读取窗口到buf, 转换为本机字节序与buf_type类型(与GDALRasterBand::RasterIO的读取结果一致, 不支持缩放)
+	/// @param buf_line_space buf中相邻行的字节间隔, 0表示xsize * buf_type的大小
+	funcrst read(int x, int y, int xsize, int ysize, void* buf, GDALDataType buf_type, GSpacing buf_line_space = 0) const;
+
+	/// @brief 提示系统预读[y, y+ysize)行, 后续read时减少缺页等待
+	void will_need(int y, int ysize) const;
+
+private:
+	unsigned char* m_base{ nullptr };
+	uint64_t m_size{ 0 };
+#ifdef _WIN32
+	void* m_file{ nullptr };
+	void* m_mapping{ nullptr };
+#endif
+
+	int m_width{ 0 }, m_height{ 0 };
+	GDALDataType m_datatype{ GDT_Unknown };
+	bool m_swap{ false };
+	uint64_t m_image_offset{ 0 };
+	int m_pixel_offset{ 0 };
+	int64_t m_line_offset{ 0 };
+};
+
+#endif // RAW_RASTER_VIEW_H
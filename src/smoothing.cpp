@@ -0,0 +1,243 @@
+#include "smoothing.h"
+
+#include <vector>
+#include <fmt/format.h>
+
+funcrst conv_2d(float* arr_in, int width, int height, float* arr_out, float* kernel, int size)
+{
+	if(arr_in == nullptr)
+		return funcrst(false, "filter::conv_2d, arr_in is nullptr.");
+	
+	if(dynamic_array_size(arr_in) != width * height)
+		return funcrst(false, fmt::format("filter::conv_2d, arr_in.size({}) is diff with width*height({}).",dynamic_array_size(arr_in),width * height));
+	
+	if(kernel == nullptr)
+		return funcrst(false, "filter::conv_2d, kernel is nullptr.");
+
+	if(dynamic_array_size(kernel) != size * size)
+		return funcrst(false, fmt::format("filter::conv_2d, kernel.size({}) is diff with size^2({}).",dynamic_array_size(kernel),size*size));
+
+	float* kernel_overturn = new float[size*size];
+	for(int i=0; i<size*size; i++)
+		kernel_overturn[i] = kernel[size*size-1-i];
+
+	if(arr_out == nullptr){
+		arr_out = new float[height * width];
+	}
+	else if(dynamic_array_size(arr_out) != height * width){
+		delete[] arr_out;
+		arr_out = new float[height * width];
+	}
+
+	for(int i = 0; i < height; i++){
+		for(int j = 0; j < width; j++){
+			/// 这种重复计算的方式肯定会多耗费一些时间, 如果使用同行向右滑动, 逐列增减数据的方式, 可以大大减少耗时
+			float sum = 0;
+			for(int m = 0; m< size; m++){
+				for(int n = 0; n< size; n++){
+					if(i-size/2+m < 0 || i-size/2+m > height-1 || j-size/2+n < 0 || j-size/2+n > width-1)
+						continue;/// 超界
+					sum +=  kernel_overturn[m*size+n] * arr_in[(i-size/2+m)*width+(j-size/2+n)];
+				}
+			}
+			arr_out[i*width+j]=sum;
+		}
+	}
+
+	delete[] kernel_overturn;
+	return funcrst(true, "filter::conv_2d finished.");
+}
+
+
+funcrst box_filter_separable(const float* arr_in, int width, int height, float* arr_out, int size, bool valid_mean, float* buffer)
+{
+	if(arr_in == nullptr || arr_out == nullptr)
+		return funcrst(false, "box_filter_separable, arr_in or arr_out is nullptr.");
+
+	if(size < 1 || size % 2 == 0)
+		return funcrst(false, fmt::format("box_filter_separable, size({}) is not a positive odd number.", size));
+
+	int r = size / 2;
+	std::vector<float> tmp;
+	if(buffer == nullptr){
+		tmp.resize(size_t(width) * height);
+		buffer = tmp.data();
+	}
+
+	/// 列方向的权重, 补零边界时为常数1/size, 有效均值时为窗口内有效列数的倒数
+	std::vector<float> weight_x(width, 1.f / size);
+	if(valid_mean){
+		for(int j = 0; j < width; j++)
+			weight_x[j] = 1.f / (std::min(j + r, width - 1) - std::max(j - r, 0) + 1);
+	}
+
+	/// 行向滑动求和: arr_in -> buffer, 使用double累加, 避免长行的累计误差
+#pragma omp parallel for
+	for(int i = 0; i < height; i++){
+		const float* src = arr_in + size_t(i) * width;
+		float* dst = buffer + size_t(i) * width;
+		double sum = 0;
+		for(int n = 0; n <= r && n < width; n++)
+			sum += src[n];
+		for(int j = 0; j < width; j++){
+			dst[j] = float(sum);
+			if(j + r + 1 < width) sum += src[j + r + 1];
+			if(j - r >= 0) sum -= src[j - r];
+		}
+	}
+
+	/// 列向滑动求和: buffer -> arr_out, 按列分组并行, 组内对整段列做向量加减
+	const int chunk = 512;
+#pragma omp parallel
+	{
+		std::vector<double> col_sum(chunk);
+#pragma omp for
+		for(int c0 = 0; c0 < width; c0 += chunk){
+			int n = std::min(chunk, width - c0);
+			std::fill(col_sum.begin(), col_sum.end(), 0.);
+			for(int m = 0; m <= r && m < height; m++){
+				const float* src = buffer + size_t(m) * width + c0;
+				for(int j = 0; j < n; j++)
+					col_sum[j] += src[j];
+			}
+
+			for(int i = 0; i < height; i++){
+				float weight_y = valid_mean ? 1.f / (std::min(i + r, height - 1) - std::max(i - r, 0) + 1) : 1.f / size;
+				float* dst = arr_out + size_t(i) * width + c0;
+				const float* wx = weight_x.data() + c0;
+#pragma omp simd
+				for(int j = 0; j < n; j++)
+					dst[j] = float(col_sum[j]) * weight_y * wx[j];
+
+				if(i + r + 1 < height){
+					const float* add = buffer + size_t(i + r + 1) * width + c0;
+#pragma omp simd
+					for(int j = 0; j < n; j++)
+						col_sum[j] += add[j];
+				}
+				if(i - r >= 0){
+					const float* sub = buffer + size_t(i - r) * width + c0;
+#pragma omp simd
+					for(int j = 0; j < n; j++)
+						col_sum[j] -= sub[j];
+				}
+			}
+		}
+	}
+
+	return funcrst(true, "box_filter_separable finished.");
+}
+
+funcrst box_filter_integral(const float* arr_in, int width, int height, float* arr_out, int size, bool valid_mean, double* sat)
+{
+	if(arr_in == nullptr || arr_out == nullptr)
+		return funcrst(false, "box_filter_integral, arr_in or arr_out is nullptr.");
+
+	if(size < 1 || size % 2 == 0)
+		return funcrst(false, fmt::format("box_filter_integral, size({}) is not a positive odd number.", size));
+
+	int r = size / 2;
+	size_t sat_width = size_t(width) + 1;
+	std::vector<double> tmp;
+	if(sat == nullptr){
+		tmp.resize(sat_width * (size_t(height) + 1));
+		sat = tmp.data();
+	}
+
+	/// 积分图, sat[i][j]为arr_in中[0,i)行, [0,j)列的总和, 首行首列为0
+	/// 先逐行求前缀和(行间并行), 再逐行向下累加(整行向量加法)
+	std::fill(sat, sat + sat_width, 0.);
+#pragma omp parallel for
+	for(int i = 0; i < height; i++){
+		const float* src = arr_in + size_t(i) * width;
+		double* dst = sat + (size_t(i) + 1) * sat_width;
+		double sum = 0;
+		dst[0] = 0;
+		for(int j = 0; j < width; j++){
+			sum += src[j];
+			dst[j + 1] = sum;
+		}
+	}
+	for(int i = 1; i < height; i++){
+		const double* up = sat + size_t(i) * sat_width;
+		double* dst = sat + (size_t(i) + 1) * sat_width;
+#pragma omp simd
+		for(size_t j = 0; j < sat_width; j++)
+			dst[j] += up[j];
+	}
+
+	double weight = 1. / (double(size) * size);
+#pragma omp parallel for
+	for(int i = 0; i < height; i++){
+		int i1 = std::max(i - r, 0), i2 = std::min(i + r, height - 1) + 1;
+		const double* top = sat + size_t(i1) * sat_width;
+		const double* bottom = sat + size_t(i2) * sat_width;
+		float* dst = arr_out + size_t(i) * width;
+		for(int j = 0; j < width; j++){
+			int j1 = std::max(j - r, 0), j2 = std::min(j + r, width - 1) + 1;
+			double sum = bottom[j2] - top[j2] - bottom[j1] + top[j1];
+			dst[j] = float(valid_mean ? sum / (double(i2 - i1) * (j2 - j1)) : sum * weight);
+		}
+	}
+
+	return funcrst(true, "box_filter_integral finished.");
+}
+
+funcrst separable_filter(const float* arr_in, int width, int height, float* arr_out, const float* kernel_x, const float* kernel_y, int size, float* buffer)
+{
+	if(arr_in == nullptr || arr_out == nullptr)
+		return funcrst(false, "separable_filter, arr_in or arr_out is nullptr.");
+
+	if(kernel_x == nullptr || kernel_y == nullptr)
+		return funcrst(false, "separable_filter, kernel_x or kernel_y is nullptr.");
+
+	if(size < 1 || size % 2 == 0)
+		return funcrst(false, fmt::format("separable_filter, size({}) is not a positive odd number.", size));
+
+	int r = size / 2;
+	std::vector<float> tmp;
+	if(buffer == nullptr){
+		tmp.resize(size_t(width) * height);
+		buffer = tmp.data();
+	}
+
+	/// 与conv_2d一致, 卷积前翻转核
+	std::vector<float> kx(kernel_x, kernel_x + size), ky(kernel_y, kernel_y + size);
+	std::reverse(kx.begin(), kx.end());
+	std::reverse(ky.begin(), ky.end());
+
+	/// 行向: arr_in -> buffer, 每个核系数对整行做一次乘加, 内层循环连续访问可向量化
+#pragma omp parallel for
+	for(int i = 0; i < height; i++){
+		const float* src = arr_in + size_t(i) * width;
+		float* dst = buffer + size_t(i) * width;
+		std::fill(dst, dst + width, 0.f);
+		for(int n = 0; n < size; n++){
+			int off = n - r;
+			float coef = kx[n];
+			int j_start = std::max(0, -off), j_end = std::min(width, width - off);
+#pragma omp simd
+			for(int j = j_start; j < j_end; j++)
+				dst[j] += coef * src[j + off];
+		}
+	}
+
+	/// 列向: buffer -> arr_out
+#pragma omp parallel for
+	for(int i = 0; i < height; i++){
+		float* dst = arr_out + size_t(i) * width;
+		std::fill(dst, dst + width, 0.f);
+		for(int m = 0; m < size; m++){
+			int ii = i - r + m;
+			if(ii < 0 || ii > height - 1)
+				continue;/// 超界
+			const float* src = buffer + size_t(ii) * width;
+			float coef = ky[m];
+#pragma omp simd
+			for(int j = 0; j < width; j++)
+				dst[j] += coef * src[j];
+		}
+	}
+
+	return funcrst(true, "separable_filter finished.");
+}
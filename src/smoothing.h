@@ -0,0 +1,82 @@
+#ifndef SMOOTHING_H
+#define SMOOTHING_H
+
+#include <algorithm>
+
+#include "datatype.h"
+
+/// 栅格平滑模块, 所有函数的数据均为行优先存储的float数组(width * height), 窗口尺寸size为奇数.
+/// 边界默认按补零处理, 即窗口内超界的像素按0参与计算, 与conv_2d的结果一致;
+/// valid_mean = true 时改为只统计窗口内有效像素的均值, 适合一般的栅格平滑.
+
+/// @brief 普通二维卷积, 逐像素计算size*size个乘加, 仅作为参考实现与测试基准
+funcrst conv_2d(float* arr_in, int width, int height, float* arr_out, float* kernel, int size);
+
+/// @brief 可分离的均值滤波, 先行向再列向滑动求和, 每个像素的计算量与size无关
+/// @param buffer 临时数组(width * height), 为nullptr时在函数内申请
+funcrst box_filter_separable(const float* arr_in, int width, int height, float* arr_out, int size, bool valid_mean = false, float* buffer = nullptr);
+
+/// @brief 基于积分图(summed-area table)的均值滤波, 每个像素只需4次查表, 适合大窗口
+/// @param sat 积分图数组((width + 1) * (height + 1)), 为nullptr时在函数内申请
+funcrst box_filter_integral(const float* arr_in, int width, int height, float* arr_out, int size, bool valid_mean = false, double* sat = nullptr);
+
+/// @brief 一般的可分离卷积核, 即 kernel = kernel_y^T * kernel_x, 两个一维核的长度均为size
+/// 与conv_2d相同, 计算前会将核翻转
+/// @param buffer 临时数组(width * height), 为nullptr时在函数内申请
+funcrst separable_filter(const float* arr_in, int width, int height, float* arr_out, const float* kernel_x, const float* kernel_y, int size, float* buffer = nullptr);
+
+/// @brief 编译期确定尺寸的K*K均值滤波(补零边界), 结果原地写回arr, buffer为同尺寸的临时数组
+/// 不申请任何内存, 用于goldstein这类逐block调用的场景
+template<int K>
+inline void box_filter_fixed(float* arr, float* buffer, int width, int height)
+{
+	static_assert(K % 2 == 1, "box_filter_fixed, K must be an odd number.");
+	constexpr int r = K / 2;
+	constexpr float weight = 1.f / (K * K);
+
+	/// 行向: arr -> buffer, 内部区域直接累加K个数, 由编译器展开
+	for(int i = 0; i < height; i++){
+		const float* src = arr + size_t(i) * width;
+		float* dst = buffer + size_t(i) * width;
+		for(int j = 0; j < r && j < width; j++){
+			float sum = 0;
+			for(int n = -r; n <= r; n++)
+				if(j + n >= 0 && j + n < width) sum += src[j + n];
+			dst[j] = sum;
+		}
+#pragma omp simd
+		for(int j = r; j < width - r; j++){
+			float sum = 0;
+			for(int n = -r; n <= r; n++)
+				sum += src[j + n];
+			dst[j] = sum;
+		}
+		for(int j = std::max(r, width - r); j < width; j++){
+			float sum = 0;
+			for(int n = -r; n <= r; n++)
+				if(j + n >= 0 && j + n < width) sum += src[j + n];
+			dst[j] = sum;
+		}
+	}
+
+	/// 列向: buffer -> arr, 逐行对整行做向量加法
+	for(int i = 0; i < height; i++){
+		float* dst = arr + size_t(i) * width;
+		int m_start = std::max(-r, -i);
+		int m_end = std::min(r, height - 1 - i);
+#pragma omp simd
+		for(int j = 0; j < width; j++)
+			dst[j] = 0;
+		for(int m = m_start; m <= m_end; m++){
+			const float* src = buffer + size_t(i + m) * width;
+#pragma omp simd
+			for(int j = 0; j < width; j++)
+				dst[j] += src[j];
+		}
+#pragma omp simd
+		for(int j = 0; j < width; j++)
+			dst[j] *= weight;
+	}
+}
+
+#endif // SMOOTHING_H
@@ -0,0 +1,111 @@
+/**
+ * @file smoothing_benchmark.cpp
+ * @author li-tann (li-tann@github.com)
+ * @brief 平滑模块与conv_2d的耗时对比, 用法: smoothing_benchmark [width] [height] [blocks]
+ * @version 0.1
+ * @date 2024-06-20
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <functional>
+
+#include <fmt/format.h>
+
+#include "smoothing.h"
+
+using namespace std;
+
+/// @brief 返回两个数组的最大绝对差
+float max_abs_diff(const float* a, const float* b, size_t n)
+{
+	float diff = 0;
+	for(size_t i = 0; i < n; i++)
+		diff = std::max(diff, std::abs(a[i] - b[i]));
+	return diff;
+}
+
+/// @brief 重复执行func共repeat次, 返回单次平均耗时(ms)
+double time_ms(std::function<void()> func, int repeat)
+{
+	auto start = chrono::system_clock::now();
+	for(int i = 0; i < repeat; i++)
+		func();
+	return spend_time(start) * 1000 / repeat;
+}
+
+int main(int argc, char* argv[])
+{
+	int width  = argc > 1 ? stoi(argv[1]) : 2048;
+	int height = argc > 2 ? stoi(argv[2]) : 2048;
+	int blocks = argc > 3 ? stoi(argv[3]) : 20000;
+
+	std::mt19937 gen(0);
+	std::uniform_real_distribution<float> dist(0.f, 100.f);
+
+	/// 1. goldstein场景: 大量32*32 block的5*5均值平滑
+	{
+		int size = 32;
+		float* block = new float[size * size];
+		float* ref = new float[size * size];
+		float* kernel = new float[25];
+		for(int k = 0; k < size * size; k++) block[k] = dist(gen);
+		for(int k = 0; k < 25; k++) kernel[k] = 0.04f;
+		std::vector<float> out(size * size), buffer(size * size);
+
+		double t_conv = time_ms([&]{ conv_2d(block, size, size, ref, kernel, 5); }, blocks);
+		double t_fixed = time_ms([&]{
+			std::copy(block, block + size * size, out.begin());
+			box_filter_fixed<5>(out.data(), buffer.data(), size, size);
+		}, blocks);
+		float diff_fixed = max_abs_diff(ref, out.data(), out.size());
+		double t_sep = time_ms([&]{ box_filter_separable(block, size, size, out.data(), 5, false, buffer.data()); }, blocks);
+		float diff_sep = max_abs_diff(ref, out.data(), out.size());
+
+		cout << fmt::format("32x32 block, 5x5 box, {} blocks (time per block):\n", blocks);
+		cout << fmt::format("  conv_2d              : {:10.5f} ms\n", t_conv);
+		cout << fmt::format("  box_filter_fixed<5>  : {:10.5f} ms, x{:.1f}, max diff {}\n", t_fixed, t_conv / t_fixed, diff_fixed);
+		cout << fmt::format("  box_filter_separable : {:10.5f} ms, x{:.1f}, max diff {}\n", t_sep, t_conv / t_sep, diff_sep);
+
+		delete[] block;
+		delete[] ref;
+		delete[] kernel;
+	}
+
+	/// 2. 整幅影像的均值平滑与可分离核
+	for(int size : {5, 15})
+	{
+		size_t n = size_t(width) * height;
+		float* image = new float[n];
+		float* ref = new float[n];
+		float* kernel = new float[size * size];
+		for(size_t k = 0; k < n; k++) image[k] = dist(gen);
+		for(int k = 0; k < size * size; k++) kernel[k] = 1.f / (size * size);
+		std::vector<float> out(n), kernel_1d(size, 1.f / size);
+
+		double t_conv = time_ms([&]{ conv_2d(image, width, height, ref, kernel, size); }, 1);
+		double t_sep = time_ms([&]{ box_filter_separable(image, width, height, out.data(), size); }, 5);
+		float diff_sep = max_abs_diff(ref, out.data(), n);
+		double t_sat = time_ms([&]{ box_filter_integral(image, width, height, out.data(), size); }, 5);
+		float diff_sat = max_abs_diff(ref, out.data(), n);
+		double t_kernel = time_ms([&]{ separable_filter(image, width, height, out.data(), kernel_1d.data(), kernel_1d.data(), size); }, 5);
+		float diff_kernel = max_abs_diff(ref, out.data(), n);
+
+		cout << fmt::format("{}x{} image, {}x{} box:\n", width, height, size, size);
+		cout << fmt::format("  conv_2d              : {:10.3f} ms\n", t_conv);
+		cout << fmt::format("  box_filter_separable : {:10.3f} ms, x{:.1f}, max diff {}\n", t_sep, t_conv / t_sep, diff_sep);
+		cout << fmt::format("  box_filter_integral  : {:10.3f} ms, x{:.1f}, max diff {}\n", t_sat, t_conv / t_sat, diff_sat);
+		cout << fmt::format("  separable_filter     : {:10.3f} ms, x{:.1f}, max diff {}\n", t_kernel, t_conv / t_kernel, diff_kernel);
+
+		delete[] image;
+		delete[] ref;
+		delete[] kernel;
+	}
+
+	return 0;
+}
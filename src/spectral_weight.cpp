@@ -0,0 +1,365 @@
+#include "spectral_weight.h"
+
+#include <cmath>
+#include <atomic>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SPECTRAL_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+/// gcc/clang需要为单个函数开启指令集, msvc可以直接使用intrinsics
+#if defined(SPECTRAL_X86) && defined(__GNUC__)
+#define TARGET_AVX2   __attribute__((target("avx2,fma")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+#else
+#define TARGET_AVX2
+#define TARGET_AVX512
+#endif
+
+/// pow(0, alpha)的取值, 与std::pow一致: alpha == 0 时为1, 否则为0
+static inline float pow_of_zero(float alpha)
+{
+	return alpha == 0.f ? 1.f : 0.f;
+}
+
+/// ---------------------------------------- scalar ----------------------------------------
+
+static void amplitude_scalar(const fftwf_complex* frequency, float* amplitude, int n)
+{
+	for(int k = 0; k < n; k++)
+		amplitude[k] = sqrtf(frequency[k][0] * frequency[k][0] + frequency[k][1] * frequency[k][1]);
+}
+
+static void weight_scalar(fftwf_complex* frequency, const float* smooth, float alpha, int n)
+{
+	float zero = pow_of_zero(alpha);
+	for(int k = 0; k < n; k++){
+		float weight = smooth[k] > 0 ? powf(smooth[k], alpha) : zero;
+		frequency[k][0] *= weight;
+		frequency[k][1] *= weight;
+	}
+}
+
+#ifdef SPECTRAL_X86
+
+/// 向量化的ln与exp采用cephes的多项式近似(与常见的sse/avx_mathfun相同), 单精度下相对误差约1e-7
+namespace cephes{
+	constexpr float sqrthf = 0.707106781186547524f;
+	constexpr float log_p0 = 7.0376836292e-2f, log_p1 = -1.1514610310e-1f, log_p2 = 1.1676998740e-1f;
+	constexpr float log_p3 = -1.2420140846e-1f, log_p4 = 1.4249322787e-1f, log_p5 = -1.6668057665e-1f;
+	constexpr float log_p6 = 2.0000714765e-1f, log_p7 = -2.4999993993e-1f, log_p8 = 3.3333331174e-1f;
+	constexpr float log_q1 = -2.12194440e-4f, log_q2 = 0.693359375f;
+	constexpr float exp_hi = 88.3762626647949f, exp_lo = -88.3762626647949f;
+	constexpr float log2e = 1.44269504088896341f;
+	constexpr float exp_c1 = 0.693359375f, exp_c2 = -2.12194440e-4f;
+	constexpr float exp_p0 = 1.9875691500e-4f, exp_p1 = 1.3981999507e-3f, exp_p2 = 8.3334519073e-3f;
+	constexpr float exp_p3 = 4.1665795894e-2f, exp_p4 = 1.6666665459e-1f, exp_p5 = 5.0000001201e-1f;
+}
+
+/// ---------------------------------------- avx2 ----------------------------------------
+
+/// @brief ln(x), 要求x > 0
+TARGET_AVX2 static inline __m256 log_avx2(__m256 x)
+{
+	using namespace cephes;
+	const __m256 one = _mm256_set1_ps(1.f);
+	x = _mm256_max_ps(x, _mm256_castsi256_ps(_mm256_set1_epi32(0x00800000)));	/// 最小的正规数
+
+	__m256i emm0 = _mm256_srli_epi32(_mm256_castps_si256(x), 23);
+	x = _mm256_and_ps(x, _mm256_castsi256_ps(_mm256_set1_epi32(~0x7f800000)));
+	x = _mm256_or_ps(x, _mm256_set1_ps(0.5f));
+	emm0 = _mm256_sub_epi32(emm0, _mm256_set1_epi32(0x7f));
+	__m256 e = _mm256_add_ps(_mm256_cvtepi32_ps(emm0), one);
+
+	__m256 mask = _mm256_cmp_ps(x, _mm256_set1_ps(sqrthf), _CMP_LT_OS);
+	__m256 tmp = _mm256_and_ps(x, mask);
+	x = _mm256_sub_ps(x, one);
+	e = _mm256_sub_ps(e, _mm256_and_ps(one, mask));
+	x = _mm256_add_ps(x, tmp);
+
+	__m256 z = _mm256_mul_ps(x, x);
+	__m256 y = _mm256_set1_ps(log_p0);
+	y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(log_p1));
+	y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(log_p2));
+	y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(log_p3));
+	y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(log_p4));
+	y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(log_p5));
+	y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(log_p6));
+	y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(log_p7));
+	y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(log_p8));
+	y = _mm256_mul_ps(_mm256_mul_ps(y, x), z);
+
+	y = _mm256_fmadd_ps(e, _mm256_set1_ps(log_q1), y);
+	y = _mm256_fnmadd_ps(z, _mm256_set1_ps(0.5f), y);
+	x = _mm256_add_ps(x, y);
+	return _mm256_fmadd_ps(e, _mm256_set1_ps(log_q2), x);
+}
+
+TARGET_AVX2 static inline __m256 exp_avx2(__m256 x)
+{
+	using namespace cephes;
+	const __m256 one = _mm256_set1_ps(1.f);
+	x = _mm256_min_ps(x, _mm256_set1_ps(exp_hi));
+	x = _mm256_max_ps(x, _mm256_set1_ps(exp_lo));
+
+	__m256 fx = _mm256_floor_ps(_mm256_fmadd_ps(x, _mm256_set1_ps(log2e), _mm256_set1_ps(0.5f)));
+	x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(exp_c1), x);
+	x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(exp_c2), x);
+
+	__m256 z = _mm256_mul_ps(x, x);
+	__m256 y = _mm256_set1_ps(exp_p0);
+	y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(exp_p1));
+	y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(exp_p2));
+	y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(exp_p3));
+	y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(exp_p4));
+	y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(exp_p5));
+	y = _mm256_fmadd_ps(y, z, _mm256_add_ps(x, one));
+
+	__m256i emm0 = _mm256_add_epi32(_mm256_cvttps_epi32(fx), _mm256_set1_epi32(0x7f));
+	emm0 = _mm256_slli_epi32(emm0, 23);
+	return _mm256_mul_ps(y, _mm256_castsi256_ps(emm0));
+}
+
+TARGET_AVX2 static void amplitude_avx2(const fftwf_complex* frequency, float* amplitude, int n)
+{
+	const float* src = reinterpret_cast<const float*>(frequency);
+	int k = 0;
+	for(; k + 8 <= n; k += 8){
+		__m256 a = _mm256_loadu_ps(src + 2 * k);		/// re0 im0 ... re3 im3
+		__m256 b = _mm256_loadu_ps(src + 2 * k + 8);	/// re4 im4 ... re7 im7
+		a = _mm256_mul_ps(a, a);
+		b = _mm256_mul_ps(b, b);
+		/// hadd的结果顺序为 0 1 4 5 2 3 6 7, 按64位重排为 0 1 2 3 4 5 6 7
+		__m256 sum = _mm256_hadd_ps(a, b);
+		sum = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(sum), 0xD8));
+		_mm256_storeu_ps(amplitude + k, _mm256_sqrt_ps(sum));
+	}
+	amplitude_scalar(frequency + k, amplitude + k, n - k);
+}
+
+TARGET_AVX2 static void weight_avx2(fftwf_complex* frequency, const float* smooth, float alpha, int n)
+{
+	float* dst = reinterpret_cast<float*>(frequency);
+	const __m256 v_alpha = _mm256_set1_ps(alpha);
+	const __m256 v_zero = _mm256_set1_ps(pow_of_zero(alpha));
+	const __m256 zero = _mm256_setzero_ps();
+	int k = 0;
+	for(; k + 8 <= n; k += 8){
+		__m256 s = _mm256_loadu_ps(smooth + k);
+		__m256 valid = _mm256_cmp_ps(s, zero, _CMP_GT_OQ);
+		__m256 w = exp_avx2(_mm256_mul_ps(v_alpha, log_avx2(s)));
+		w = _mm256_blendv_ps(v_zero, w, valid);
+
+		/// w0 w1 ... w7 -> (w0 w0 w1 w1 w2 w2 w3 w3), (w4 w4 w5 w5 w6 w6 w7 w7)
+		__m256 lo = _mm256_unpacklo_ps(w, w);
+		__m256 hi = _mm256_unpackhi_ps(w, w);
+		__m256 w_a = _mm256_permute2f128_ps(lo, hi, 0x20);
+		__m256 w_b = _mm256_permute2f128_ps(lo, hi, 0x31);
+
+		_mm256_storeu_ps(dst + 2 * k, _mm256_mul_ps(_mm256_loadu_ps(dst + 2 * k), w_a));
+		_mm256_storeu_ps(dst + 2 * k + 8, _mm256_mul_ps(_mm256_loadu_ps(dst + 2 * k + 8), w_b));
+	}
+	weight_scalar(frequency + k, smooth + k, alpha, n - k);
+}
+
+/// ---------------------------------------- avx512 ----------------------------------------
+
+TARGET_AVX512 static inline __m512 log_avx512(__m512 x)
+{
+	using namespace cephes;
+	const __m512 one = _mm512_set1_ps(1.f);
+	x = _mm512_max_ps(x, _mm512_castsi512_ps(_mm512_set1_epi32(0x00800000)));
+
+	__m512i emm0 = _mm512_srli_epi32(_mm512_castps_si512(x), 23);
+	x = _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(x), _mm512_set1_epi32(~0x7f800000)));
+	x = _mm512_castsi512_ps(_mm512_or_si512(_mm512_castps_si512(x), _mm512_castps_si512(_mm512_set1_ps(0.5f))));
+	emm0 = _mm512_sub_epi32(emm0, _mm512_set1_epi32(0x7f));
+	__m512 e = _mm512_add_ps(_mm512_cvtepi32_ps(emm0), one);
+
+	__mmask16 mask = _mm512_cmp_ps_mask(x, _mm512_set1_ps(sqrthf), _CMP_LT_OS);
+	__m512 tmp = _mm512_maskz_mov_ps(mask, x);
+	x = _mm512_sub_ps(x, one);
+	e = _mm512_mask_sub_ps(e, mask, e, one);
+	x = _mm512_add_ps(x, tmp);
+
+	__m512 z = _mm512_mul_ps(x, x);
+	__m512 y = _mm512_set1_ps(log_p0);
+	y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(log_p1));
+	y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(log_p2));
+	y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(log_p3));
+	y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(log_p4));
+	y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(log_p5));
+	y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(log_p6));
+	y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(log_p7));
+	y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(log_p8));
+	y = _mm512_mul_ps(_mm512_mul_ps(y, x), z);
+
+	y = _mm512_fmadd_ps(e, _mm512_set1_ps(log_q1), y);
+	y = _mm512_fnmadd_ps(z, _mm512_set1_ps(0.5f), y);
+	x = _mm512_add_ps(x, y);
+	return _mm512_fmadd_ps(e, _mm512_set1_ps(log_q2), x);
+}
+
+TARGET_AVX512 static inline __m512 exp_avx512(__m512 x)
+{
+	using namespace cephes;
+	const __m512 one = _mm512_set1_ps(1.f);
+	x = _mm512_min_ps(x, _mm512_set1_ps(exp_hi));
+	x = _mm512_max_ps(x, _mm512_set1_ps(exp_lo));
+
+	__m512 fx = _mm512_roundscale_ps(_mm512_fmadd_ps(x, _mm512_set1_ps(log2e), _mm512_set1_ps(0.5f)), _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+	x = _mm512_fnmadd_ps(fx, _mm512_set1_ps(exp_c1), x);
+	x = _mm512_fnmadd_ps(fx, _mm512_set1_ps(exp_c2), x);
+
+	__m512 z = _mm512_mul_ps(x, x);
+	__m512 y = _mm512_set1_ps(exp_p0);
+	y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(exp_p1));
+	y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(exp_p2));
+	y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(exp_p3));
+	y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(exp_p4));
+	y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(exp_p5));
+	y = _mm512_fmadd_ps(y, z, _mm512_add_ps(x, one));
+
+	__m512i emm0 = _mm512_add_epi32(_mm512_cvttps_epi32(fx), _mm512_set1_epi32(0x7f));
+	emm0 = _mm512_slli_epi32(emm0, 23);
+	return _mm512_mul_ps(y, _mm512_castsi512_ps(emm0));
+}
+
+TARGET_AVX512 static void amplitude_avx512(const fftwf_complex* frequency, float* amplitude, int n)
+{
+	const float* src = reinterpret_cast<const float*>(frequency);
+	/// 取两个寄存器中偶数位置的元素
+	const __m512i even = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+	int k = 0;
+	for(; k + 16 <= n; k += 16){
+		__m512 a = _mm512_loadu_ps(src + 2 * k);
+		__m512 b = _mm512_loadu_ps(src + 2 * k + 16);
+		a = _mm512_mul_ps(a, a);
+		b = _mm512_mul_ps(b, b);
+		/// 相邻的re^2与im^2相加, 结果位于偶数位置
+		a = _mm512_add_ps(a, _mm512_permute_ps(a, 0xB1));
+		b = _mm512_add_ps(b, _mm512_permute_ps(b, 0xB1));
+		__m512 sum = _mm512_permutex2var_ps(a, even, b);
+		_mm512_storeu_ps(amplitude + k, _mm512_sqrt_ps(sum));
+	}
+	amplitude_scalar(frequency + k, amplitude + k, n - k);
+}
+
+TARGET_AVX512 static void weight_avx512(fftwf_complex* frequency, const float* smooth, float alpha, int n)
+{
+	float* dst = reinterpret_cast<float*>(frequency);
+	const __m512 v_alpha = _mm512_set1_ps(alpha);
+	const __m512 v_zero = _mm512_set1_ps(pow_of_zero(alpha));
+	/// w0 ... w15 -> (w0 w0 ... w7 w7), (w8 w8 ... w15 w15)
+	const __m512i dup_lo = _mm512_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7);
+	const __m512i dup_hi = _mm512_setr_epi32(8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13, 14, 14, 15, 15);
+	int k = 0;
+	for(; k + 16 <= n; k += 16){
+		__m512 s = _mm512_loadu_ps(smooth + k);
+		__mmask16 valid = _mm512_cmp_ps_mask(s, _mm512_setzero_ps(), _CMP_GT_OQ);
+		__m512 w = exp_avx512(_mm512_mul_ps(v_alpha, log_avx512(s)));
+		w = _mm512_mask_mov_ps(v_zero, valid, w);
+
+		__m512 w_a = _mm512_permutexvar_ps(dup_lo, w);
+		__m512 w_b = _mm512_permutexvar_ps(dup_hi, w);
+		_mm512_storeu_ps(dst + 2 * k, _mm512_mul_ps(_mm512_loadu_ps(dst + 2 * k), w_a));
+		_mm512_storeu_ps(dst + 2 * k + 16, _mm512_mul_ps(_mm512_loadu_ps(dst + 2 * k + 16), w_b));
+	}
+	weight_scalar(frequency + k, smooth + k, alpha, n - k);
+}
+
+#endif // SPECTRAL_X86
+
+/// ---------------------------------------- dispatch ----------------------------------------
+
+simd_level detect_simd_level()
+{
+#if defined(SPECTRAL_X86) && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if(info[0] < 7)
+		return simd_level::scalar;
+
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	bool fma = (info[2] & (1 << 12)) != 0;
+	if(!osxsave || !avx)
+		return simd_level::scalar;
+
+	/// 操作系统需要保存ymm(及zmm)寄存器
+	unsigned long long xcr0 = _xgetbv(0);
+	__cpuidex(info, 7, 0);
+	bool avx2 = (info[1] & (1 << 5)) != 0;
+	bool avx512f = (info[1] & (1 << 16)) != 0;
+	if(avx512f && (xcr0 & 0xE6) == 0xE6)
+		return simd_level::avx512;
+	if(avx2 && fma && (xcr0 & 0x6) == 0x6)
+		return simd_level::avx2;
+	return simd_level::scalar;
+#elif defined(SPECTRAL_X86) && defined(__GNUC__)
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx512f"))
+		return simd_level::avx512;
+	if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		return simd_level::avx2;
+	return simd_level::scalar;
+#else
+	return simd_level::scalar;
+#endif
+}
+
+static std::atomic<simd_level>& current_level()
+{
+	static std::atomic<simd_level> level(detect_simd_level());
+	return level;
+}
+
+simd_level spectral_simd_level()
+{
+	return current_level().load(std::memory_order_relaxed);
+}
+
+void set_spectral_simd_level(simd_level level)
+{
+	simd_level supported = detect_simd_level();
+	current_level().store(int(level) > int(supported) ? supported : level);
+}
+
+const char* simd_level_name(simd_level level)
+{
+	switch (level)
+	{
+	case simd_level::avx512: return "avx512";
+	case simd_level::avx2: return "avx2";
+	default: return "scalar";
+	}
+}
+
+void spectral_amplitude(const fftwf_complex* frequency, float* amplitude, int n)
+{
+	switch (spectral_simd_level())
+	{
+#ifdef SPECTRAL_X86
+	case simd_level::avx512: amplitude_avx512(frequency, amplitude, n); break;
+	case simd_level::avx2: amplitude_avx2(frequency, amplitude, n); break;
+#endif
+	default: amplitude_scalar(frequency, amplitude, n); break;
+	}
+}
+
+void spectral_weight(fftwf_complex* frequency, const float* smooth, float alpha, int n)
+{
+	switch (spectral_simd_level())
+	{
+#ifdef SPECTRAL_X86
+	case simd_level::avx512: weight_avx512(frequency, smooth, alpha, n); break;
+	case simd_level::avx2: weight_avx2(frequency, smooth, alpha, n); break;
+#endif
+	default: weight_scalar(frequency, smooth, alpha, n); break;
+	}
+}
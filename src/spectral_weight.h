@@ -0,0 +1,28 @@
+#ifndef SPECTRAL_WEIGHT_H
+#define SPECTRAL_WEIGHT_H
+
+#include <fftw3.h>
+
+/// goldstein频域加权的向量化内核, 直接处理交错存储的fftwf_complex数组(re, im, re, im, ...).
+/// 运行时检测cpu支持的指令集, 按 avx512 > avx2 > scalar 的顺序选择实现, 非x86平台只有scalar实现.
+
+enum class simd_level{ scalar, avx2, avx512 };
+
+/// @brief 当前cpu(及操作系统)支持的最高指令集
+simd_level detect_simd_level();
+
+/// @brief 当前使用的指令集, 默认为detect_simd_level()
+simd_level spectral_simd_level();
+
+/// @brief 强制使用指定的指令集(用于对比测试), 超出cpu支持范围时降为detect_simd_level()
+void set_spectral_simd_level(simd_level level);
+
+const char* simd_level_name(simd_level level);
+
+/// @brief amplitude[k] = |frequency[k]|
+void spectral_amplitude(const fftwf_complex* frequency, float* amplitude, int n);
+
+/// @brief frequency[k] *= smooth[k]^alpha, smooth[k] <= 0 时按pow(0, alpha)处理
+void spectral_weight(fftwf_complex* frequency, const float* smooth, float alpha, int n);
+
+#endif // SPECTRAL_WEIGHT_H
@@ -1,13 +1,29 @@
 #include "raster_include.h"
+#include "raster_statistics.h"
 
 /*
     sub_statistics.add_argument("img_filepath")
         .help("raster image filepath.");
 
     sub_statistics.add_argument("band")
-        .help("band, default is 1.")
+        .help("band, default is 1, 0 means all bands (in one pass).")
         .scan<'i',int>()
         .default_value("1");
+
+    sub_statistics.add_argument("-q","--quantiles")
+        .help("optional quantiles within [0,1], e.g. '-q 0.02 0.5 0.98'.")
+        .scan<'g',double>()
+        .nargs(argparse::nargs_pattern::at_least_one);
+
+    sub_statistics.add_argument("--approx")
+        .help("approximate statistics, read overview if existed, otherwise read one of every 'sample_step' blocks.")
+        .implicit_value(true)
+        .default_value(false);
+
+    sub_statistics.add_argument("--sample_step")
+        .help("used with --approx when the image has no overview, default is 10.")
+        .scan<'i',int>()
+        .default_value("10");
 */
 
 int statistics(argparse::ArgumentParser* args, std::shared_ptr<spdlog::logger> logger)
@@ -15,6 +31,19 @@ int statistics(argparse::ArgumentParser* args, std::shared_ptr<spdlog::logger> l
     std::string img_filepath = args->get<std::string>("img_filepath");
     int band = args->get<int>("band");
 
+    raster_statistics_options opt;
+    opt.approx = args->get<bool>("--approx");
+    opt.sample_step = args->get<int>("--sample_step");
+    std::vector<double> quantiles;
+    if(args->is_used("--quantiles")){
+        quantiles = args->get<std::vector<double>>("--quantiles");
+        opt.quantiles = true;
+    }
+    if(opt.sample_step < 1){
+        PRINT_LOGGER(logger, warn, fmt::format("sample_step input is a invalid data ({}) which has been replaced by default ({})", opt.sample_step, 10));
+        opt.sample_step = 10;
+    }
+
     GDALAllRegister();
     CPLSetConfigOption("GDAL_FILENAME_IS_UTF8", "NO");
 
@@ -24,32 +53,39 @@ int statistics(argparse::ArgumentParser* args, std::shared_ptr<spdlog::logger> l
         return -1;
     }
     int bands = ds->GetRasterCount();
+    GDALClose(ds);
 
-    if(band > bands){
-        PRINT_LOGGER(logger, error, fmt::format("band({}(input)) is bigger than ds.bands({})", band, bands));
+    if(band > bands || band < 0){
+        PRINT_LOGGER(logger, error, fmt::format("band({}(input)) is out of range [0,{}]", band, bands));
         return -2;
     }
+    if(band > 0)
+        opt.bands.push_back(band);
 
-    GDALRasterBand* rb = ds->GetRasterBand(band);
-        
-    double min, max, mean, stddev;
-    auto err = rb->ComputeStatistics(FALSE, &min, &max, &mean, &stddev, NULL,NULL);
-    if(err != CE_None){
-        PRINT_LOGGER(logger, error, "rb->ComputeStatistics failed.");
-        GDALClose(ds);
+    auto start_time = std::chrono::system_clock::now();
+    std::vector<band_statistics> stats;
+    funcrst rst = compute_raster_statistics(img_filepath, opt, stats);
+    if(!rst){
+        PRINT_LOGGER(logger, error, fmt::format("compute_raster_statistics failed. ({})", rst.explain));
         return -3;
     }
-    std::string msg = "statistics info:\n"
-    "band " + std::to_string(band) + ":\n"
-    "minium :" + std::to_string(min) + "\n" +
-    "maxium :" + std::to_string(max) + "\n" +
-    "mean   :" + std::to_string(mean) + "\n" + 
-    "stdDev :" + std::to_string(stddev);
-
-    PRINT_LOGGER(logger, info, msg);
 
-    GDALClose(ds);
+    std::string msg = fmt::format("statistics info{}:", opt.approx ? " (approx)" : "");
+    for(auto& st : stats){
+        msg += fmt::format("\nband {}:\n"
+            "minium :{}\n"
+            "maxium :{}\n"
+            "mean   :{}\n"
+            "stdDev :{}\n"
+            "valid  :{}\n"
+            "nodata :{}\n"
+            "nan    :{}",
+            st.band, st.min, st.max, st.mean, st.stddev(), st.count, st.nodata_count, st.nan_count);
+        for(double q : quantiles)
+            msg += fmt::format("\nq({})  :{}", q, st.quantile(q));
+    }
 
-    PRINT_LOGGER(logger, info, "set_nodata_value success.");
+    PRINT_LOGGER(logger, info, msg);
+    PRINT_LOGGER(logger, info, fmt::format("statistics success, spend time {}s.", spend_time(start_time)));
     return 1;
 }
\ No newline at end of file
@@ -7,8 +7,56 @@
 
 #include <gdal_priv.h>
 
+#include "raw_file_io.h"
+
 using tuple_bs = std::tuple<bool, std::string>;
 
+/// 读写二进制文件时每次处理的元素数, 整块读取后交换字节序, 或整块交换后写入
+constexpr size_t binary_io_chunk = size_t(1) << 20;
+
+/// @brief 读取count个_Ty(可以为复数)到array, b_swap为true时交换字节序
+template<typename _Ty>
+tuple_bs binary_io_read(const char* filepath, _Ty* array, size_t count, bool b_swap)
+{
+    raw_file file;
+    funcrst rst = file.open(filepath, false);
+    if(!rst)
+        return std::make_tuple(false, "ifs.open failed.");
+    for(size_t i = 0; i < count; i += binary_io_chunk){
+        size_t num = std::min(binary_io_chunk, count - i);
+        rst = file.read_at(uint64_t(i) * sizeof(_Ty), array + i, num * sizeof(_Ty));
+        if(!rst)
+            return std::make_tuple(false, rst.explain);
+        if(b_swap)
+            swap_byte_order(array + i, num);
+    }
+    return std::make_tuple(true, "read_binary succeed.");
+}
+
+/// @brief 将array中的count个_Ty(可以为复数)写入文件, b_swap为true时先在缓冲区内交换字节序
+template<typename _Ty>
+tuple_bs binary_io_write(const char* filepath, const _Ty* array, size_t count, bool b_swap)
+{
+    raw_file file;
+    funcrst rst = file.open(filepath, true, uint64_t(count) * sizeof(_Ty));
+    if(!rst)
+        return std::make_tuple(false, "ofs.open failed.");
+    std::vector<_Ty> buffer(b_swap ? std::min(binary_io_chunk, count) : 0);
+    for(size_t i = 0; i < count; i += binary_io_chunk){
+        size_t num = std::min(binary_io_chunk, count - i);
+        const _Ty* src = array + i;
+        if(b_swap){
+            std::copy(src, src + num, buffer.data());
+            swap_byte_order(buffer.data(), num);
+            src = buffer.data();
+        }
+        rst = file.write_at(uint64_t(i) * sizeof(_Ty), src, num * sizeof(_Ty));
+        if(!rst)
+            return std::make_tuple(false, rst.explain);
+    }
+    return std::make_tuple(true, "write_binary succeed.");
+}
+
 // template<typename _Ty>
 // inline _Ty binary_swap(_Ty src)
 // {
@@ -47,39 +95,12 @@ public:
 
     tuple_bs read_binary(const char* filepath, bool b_swap = true)
     {
-        using namespace std;
-        ifstream ifs(filepath,ifstream::binary);
-        if(!ifs.is_open()){
-            return make_tuple(false,"ifs.open failed.");
-        }
-
-        size_t sizeof_Ty = sizeof(_Ty);
-        int num = 0;
-        _Ty val_init;
-        while (ifs.read((char*)&val_init, sizeof_Ty)) { 
-            //high-low bytes trans
-            array[num++] = b_swap ? binary_swap(val_init) : val_init;
-            if(num >= width * height)break;
-        }
-        ifs.close();
-        return make_tuple(true,"read_binary succeed.");
+        return binary_io_read(filepath, array, size_t(width) * height, b_swap);
     }
     
     tuple_bs write_binary(const char* filepath, bool b_swap = true)
     {
-        using namespace std;
-        ofstream ofs(filepath, ofstream::binary);
-        if(!ofs.is_open()){
-            return make_tuple(false,"ofs.open failed.");
-        }
-
-        for(int i=0; i< width * height; i++){
-            _Ty val = (b_swap ? binary_swap(array[i]) : array[i]);
-            ofs.write((char*)(&val),sizeof(_Ty));
-        }
-
-        ofs.close();
-        return make_tuple(true,"write_binary succeed.");
+        return binary_io_write(filepath, array, size_t(width) * height, b_swap);
     }
 
     tuple_bs read_tif(const char* filepath)
@@ -153,47 +174,12 @@ public:
     
     tuple_bs read_binary_cpx(const char* filepath, bool b_swap = true)
     {
-        using namespace std;
-        ifstream ifs(filepath,ifstream::binary);
-        if(!ifs.is_open()){
-            return make_tuple(false,"ifs.open failed.");
-        }
-
-        size_t sizeof_Ty = sizeof(_Ty);
-        int num = 0;
-        _Ty val_init;
-        bool isReal {true}; // isReal -- isImag
-        while (ifs.read((char*)&val_init, sizeof_Ty)) { 
-            //high-low bytes trans
-            if(isReal){
-                array[num].real(b_swap ? binary_swap(val_init) : val_init);
-            }else{
-                array[num++].imag(b_swap ? binary_swap(val_init) : val_init);
-            }
-            isReal = !isReal;
-                
-            if(num >= width * height)break;
-        }
-        ifs.close();
-        return make_tuple(true,"read_binary succeed.");
+        return binary_io_read(filepath, array, size_t(width) * height, b_swap);
     }
     
     tuple_bs write_binary_cpx(const char* filepath, bool b_swap = true)
     {
-        using namespace std;
-        ofstream ofs(filepath, ofstream::binary);
-        if(!ofs.is_open())
-            return make_tuple(false,"ofs.open failed.");
-
-        for(int i=0; i< width * height; i++){
-            _Ty real = (b_swap ? binary_swap(array[i].real()) : array[i].real());
-            _Ty imag = (b_swap ? binary_swap(array[i].imag()) : array[i].imag());
-            ofs.write((char*)(&real),sizeof(_Ty));
-            ofs.write((char*)(&imag),sizeof(_Ty));
-        }
-
-        ofs.close();
-        return make_tuple(true,"write_binary succeed.");
+        return binary_io_write(filepath, array, size_t(width) * height, b_swap);
     }
 
     tuple_bs read_tif_cpx(const char* filepath)
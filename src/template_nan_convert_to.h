@@ -2,112 +2,106 @@
 #define TEMPLATE_NAN_CONVERT_TO
 
 #include <gdal_priv.h>
+#include <omp.h>
 
 #include <vector>
 #include <string>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <iostream>
 #include "datatype.h"
+#include "block_window.h"
 
-/// gdaldataset* ds must be opened by gdalopen(..., ga_update)
+/// nodata_transto与value_transto基于block_transform(block_window.h)逐窗口读取ds_in, 替换后写入ds_out.
+/// ds_out通常由create_like(raster_copy.h)按ds_in新建, 此时各线程以只读句柄并行读取ds_in;
+/// ds_in与ds_out可以是同一个以GA_Update打开的数据集(原地处理), 此时读写都在一个锁内执行
+
+/// 整数类型不存在nan, ds_in与ds_out不同时直接拷贝
 template<typename _Ty>
-funcrst nodata_transto(GDALDataset* ds, _Ty value)
+funcrst nodata_transto(GDALDataset* ds_in, GDALDataset* ds_out, _Ty value)
 {
     using namespace std;
     string func_name = "nodata_transto";
     cout <<func_name <<" start."<<endl;
-    
-    if(ds == nullptr)
-        return funcrst(false, "ds is nullptr");
-
-    int xsize = ds->GetRasterXSize();
-    int ysize = ds->GetRasterYSize();
-    int bands = ds->GetRasterCount();
-
-    cout<<"progress: ";
-    double last_percent = -1;
-    for(int b = 1;b <= bands; b++)
-    {
-        GDALRasterBand* rb = ds->GetRasterBand(b);
-        for(int y = 0; y< ysize; y++)
-        {
-            _Ty* arr = new _Ty[xsize];
-            
-            rb->RasterIO(GF_Read,0,y,xsize,1,arr,xsize,1,rb->GetRasterDataType(),0,0);
-            for(int x=0; x< xsize; x++){
-                if(isnan(arr[x])){arr[x] = value;}
-            }
-            rb->RasterIO(GF_Write,0,y,xsize,1,arr,xsize,1,rb->GetRasterDataType(),0,0);
-            delete[] arr;
 
-            ///print prog,
-            double percent = double((b-1) *ysize + y) / (bands * ysize) ;
-            if(percent - last_percent > 0.01)
-            {
-                last_percent = percent;
-                if(int(percent * 100)%5 != 0)
-                    continue;
+    if(ds_in == nullptr || ds_out == nullptr)
+        return funcrst(false, "ds_in or ds_out is nullptr");
 
-                if(int(percent * 100)%10 == 0)
-                    cout<< int(percent * 100);
-                else
-                    cout<< "..";
-            }
+    if constexpr (!std::is_floating_point<_Ty>::value){
+        if(ds_in == ds_out){
+            cout<<func_name <<" successd (integer datatype has no nan)."<<endl;
+            return funcrst(true, "nodata_transto func successd.");
         }
+        return block_transform<_Ty>(ds_in, ds_out, func_name, [](int, _Ty*, size_t){});
+    }
+    else{
+        funcrst rst = block_transform<_Ty>(ds_in, ds_out, func_name, [value](int, _Ty* arr, size_t count){
+#pragma omp simd
+            for(size_t x = 0; x < count; x++)
+                arr[x] = (arr[x] != arr[x]) ? value : arr[x];
+        });
+        if(rst)
+            cout<<func_name <<" successd."<<endl;
+        return rst;
     }
-    cout<<100<<endl;
-
-    cout<<func_name <<" successd."<<endl;
-    return funcrst(true, "nodata_transto func successd.");
 }
 
 
 template<typename _Ty>
-funcrst value_transto(GDALDataset* ds, _Ty value_in, _Ty value_out)
+funcrst value_transto(GDALDataset* ds_in, GDALDataset* ds_out, _Ty value_in, _Ty value_out)
 {
     using namespace std;
     string func_name = "value_transto";
     cout <<func_name <<" start."<<endl;
 
-    if(ds == nullptr)
-        return funcrst(false, "ds is nullptr");
+    if(ds_in == nullptr || ds_out == nullptr)
+        return funcrst(false, "ds_in or ds_out is nullptr");
+
+    funcrst rst = block_transform<_Ty>(ds_in, ds_out, func_name, [value_in, value_out](int, _Ty* arr, size_t count){
+#pragma omp simd
+        for(size_t x = 0; x < count; x++)
+            arr[x] = (arr[x] == value_in) ? value_out : arr[x];
+    });
+    if(rst)
+        cout<<func_name <<" successd."<<endl;
+    return rst;
+}
 
-    int xsize = ds->GetRasterXSize();
-    int ysize = ds->GetRasterYSize();
-    int bands = ds->GetRasterCount();
+/// @brief 按datatype(通常为ds_in第一个波段的数据类型)分派value_transto, 支持所有非复数的数值类型
+/// value_in, value_out会先转换为对应类型, 超出类型范围时返回false
+inline funcrst value_transto(GDALDataset* ds_in, GDALDataset* ds_out, GDALDataType datatype, double value_in, double value_out)
+{
+    auto call = [&](auto type_tag) -> funcrst {
+        using _Ty = decltype(type_tag);
+        if constexpr (std::is_integral<_Ty>::value){
+            auto in_range = [](double v){ return v >= double(std::numeric_limits<_Ty>::lowest()) && v <= double(std::numeric_limits<_Ty>::max()); };
+            if(!in_range(value_in) || !in_range(value_out))
+                return funcrst(false, "value_transto, value (" + std::to_string(value_in) + " or " + std::to_string(value_out) + ") is out of range of " + GDALGetDataTypeName(datatype) + ".");
+        }
+        return value_transto(ds_in, ds_out, _Ty(value_in), _Ty(value_out));
+    };
 
-    cout<<"progress: ";
-    double last_percent = -1;
-    for(int b = 1;b <= bands; b++)
+    switch (datatype)
     {
-        GDALRasterBand* rb = ds->GetRasterBand(b);
-        for(int y = 0; y< ysize; y++)
-        {
-            _Ty* arr = new _Ty[xsize];
-            rb->RasterIO(GF_Read,0,y,xsize,1,arr,xsize,1,rb->GetRasterDataType(),0,0);
-            for(int x=0; x< xsize; x++){
-                if(arr[x] == value_in){arr[x] = value_out;}
-            }
-            rb->RasterIO(GF_Write,0,y,xsize,1,arr,xsize,1,rb->GetRasterDataType(),0,0);
-            delete[] arr;
-
-            ///print prog,
-            double percent = double((b-1) *ysize + y) / (bands * ysize) ;
-            if(percent - last_percent > 0.01)
-            {
-                last_percent = percent;
-                if(int(percent * 100)%5 != 0)
-                    continue;
-
-                if(int(percent * 100)%10 == 0)
-                    cout<< int(percent * 100);
-                else
-                    cout<< "..";
-            }
-        }
+    case GDT_Byte:      return call((unsigned char)0);
+    case GDT_UInt16:    return call((unsigned short)0);
+    case GDT_Int16:     return call(short(0));
+    case GDT_UInt32:    return call((unsigned int)0);
+    case GDT_Int32:     return call(int(0));
+    case GDT_Float32:   return call(float(0));
+    case GDT_Float64:   return call(double(0));
+#if GDAL_VERSION_NUM >= 3050000
+    case GDT_Int64:     return call(std::int64_t(0));
+    case GDT_UInt64:    return call(std::uint64_t(0));
+#endif
+#if GDAL_VERSION_NUM >= 3070000
+    case GDT_Int8:      return call(std::int8_t(0));
+#endif
+    default:
+        return funcrst(false, std::string("value_transto, unsupported datatype (") + GDALGetDataTypeName(datatype) + ").");
     }
-    cout<<100<<endl;
-
-    cout<<func_name <<" successd."<<endl;
-    return funcrst(true, "value_transto func successd.");
 }
 
-#endif //TEMPLATE_NAN_CONVERT_TO
\ No newline at end of file
+#endif //TEMPLATE_NAN_CONVERT_TO
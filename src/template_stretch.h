@@ -7,75 +7,39 @@
 #include <string>
 
 #include "datatype.h"
+#include "block_window.h"
 
-// template<typename _Ty>
-// funcrst histogram_stretch(GDALRasterBand* rb, int xsize, int ysize, _Ty min, _Ty max, GDALDataType datatype)
-// {
-//     _Ty* arr = new _Ty[xsize *ysize];
-//     rb->RasterIO(GF_Read, 0, 0, xsize, ysize, arr, xsize, ysize,datatype,0,0);
-//     for(int i=0; i < xsize * ysize; i++){
-//         if(arr[i] < min){arr[i] = min;}
-//         else if(arr[i] > max){arr[i] = max;}
-//     }
-//     rb->RasterIO(GF_Write, 0, 0, xsize, ysize, arr, xsize, ysize,datatype,0,0);
-//     delete[] arr;
-// }
+/// @brief 拉伸后每个波段的截断范围, nodata像素保持不变
+struct stretch_range
+{
+    double min, max;
+    bool has_nodata;
+    double nodata;
+};
 
+/// @brief 按block顺序将ds_in各波段截断到ranges[band-1]内, 写入ds_out(可以与ds_in相同), 不申请整波段的内存
 template<typename _Ty>
-funcrst rasterband_histogram_stretch(GDALRasterBand* rb, int band, int xsize, int ysize, int HISTOGRAM_SIZE, double stretch_rate)
+funcrst dataset_histogram_stretch(GDALDataset* ds_in, GDALDataset* ds_out, const std::vector<stretch_range>& ranges)
 {
-    using namespace std;
-    GDALDataType datatype = rb->GetRasterDataType();
-    CPLErr err;
-    double minmax[2];
-    GUIntBig* histogram_result = new GUIntBig[HISTOGRAM_SIZE];
-    err = rb->ComputeRasterMinMax(FALSE,minmax);
-    if(err == CE_Failure){
-        return funcrst(false, fmt::format("band[{}].computeRasterMinMax failed.", band));
-    }
-    err = rb->GetHistogram(minmax[0], minmax[1],HISTOGRAM_SIZE, histogram_result, FALSE, FALSE, GDALDummyProgress, nullptr);
-    if(err == CE_Failure){
-        return funcrst(false, fmt::format("band[{}].getHistrogram failed.", band));
-    }
-
-
-    /// statistics, accumulate & accumulate_percent
-    GUIntBig* histogram_accumulate = new GUIntBig[HISTOGRAM_SIZE];
-    histogram_accumulate[0] = histogram_result[0];
-    for(int i=1; i<HISTOGRAM_SIZE; i++){
-        histogram_accumulate[i] = histogram_accumulate[i-1] + histogram_result[i];
-    }
-
-    double* histogram_accumulate_percent = new double[HISTOGRAM_SIZE];
-    double min, max;
-    for(int i=0; i<HISTOGRAM_SIZE; i++){
-        histogram_accumulate_percent[i] = 1. * histogram_accumulate[i] / histogram_accumulate[HISTOGRAM_SIZE-1] ;
-        if(i==0)continue;
-        if((histogram_accumulate_percent[i-1] <= stretch_rate || i == 1) && histogram_accumulate_percent[i] >= stretch_rate){
-            min = minmax[0] + (minmax[1] - minmax[0])/ HISTOGRAM_SIZE * (i-1);
+    if(ds_in == nullptr || int(ranges.size()) != ds_in->GetRasterCount())
+        return funcrst(false, "dataset_histogram_stretch, ds_in is nullptr or ranges.size is diff with ds_in.bands.");
+
+    return block_transform<_Ty>(ds_in, ds_out, "dataset_histogram_stretch", [&ranges](int band, _Ty* arr, size_t count){
+        const stretch_range& range = ranges[band - 1];
+        _Ty _TyMin = _Ty(range.min);
+        _Ty _TyMax = _Ty(range.max);
+        if(!range.has_nodata){
+#pragma omp simd
+            for(size_t i = 0; i < count; i++)
+                arr[i] = arr[i] < _TyMin ? _TyMin : (arr[i] > _TyMax ? _TyMax : arr[i]);
         }
-        if(histogram_accumulate_percent[i-1] <= 1 - stretch_rate && histogram_accumulate_percent[i] >= 1 - stretch_rate){
-            max = minmax[0] + (minmax[1] - minmax[0])/ HISTOGRAM_SIZE * i;
+        else{
+            _Ty nodata = _Ty(range.nodata);
+#pragma omp simd
+            for(size_t i = 0; i < count; i++)
+                arr[i] = arr[i] == nodata ? nodata : (arr[i] < _TyMin ? _TyMin : (arr[i] > _TyMax ? _TyMax : arr[i]));
         }
-    }
-    delete[] histogram_accumulate;
-    delete[] histogram_accumulate_percent;
-
-    _Ty _TyMin = _Ty(min);
-    _Ty _TyMax = _Ty(max);
-
-    _Ty* arr = new _Ty[xsize *ysize];
-    rb->RasterIO(GF_Read, 0, 0, xsize, ysize, arr, xsize, ysize,datatype,0,0);
-    for(int i=0; i < xsize * ysize; i++){
-        if(arr[i] < _TyMin){arr[i] = _TyMin;}
-        else if(arr[i] > _TyMax){arr[i] = _TyMax;}
-    }
-    rb->RasterIO(GF_Write, 0, 0, xsize, ysize, arr, xsize, ysize,datatype,0,0);
-    delete[] arr;
-
-    return funcrst(true, fmt::format("band[{}].rasterband_histogram_stretch success.", band));
+    });
 }
 
-
-
-#endif ///TEMPLATE_STRETCH
\ No newline at end of file
+#endif ///TEMPLATE_STRETCH
@@ -54,7 +54,7 @@ int main(int argc, char* argv[])
     return_msg(0,msg);
 
     bool high_low_byte_trans = true;
-    if(argv[2] == "false"){
+    if(string(argv[2]) == "false"){
         high_low_byte_trans = false;
     }
 
@@ -0,0 +1,385 @@
+#include "tile_catalog.h"
+
+#include <map>
+#include <numeric>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+#include <type_traits>
+
+#include <omp.h>
+#include <fmt/format.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/// 文件结构: header | records(可读的在前, 与R-tree的下标一致) | 路径字符串与filter_name | R-tree的ids | R-tree的nodes
+/// 各段按本机字节序与对齐直接写出, 加载时按偏移一次读入; 版本或结构大小不同时视为无效目录(重新扫描即可).
+/// 不使用内存映射: 记录中的路径要转为tile_info::path, update需要逐条比较全部记录, 各段总是完整读入(数万个文件约数MB),
+/// 映射后再拷贝与一次顺序读取相比没有收益
+const char catalog_magic[8] = {'T','I','L','E','C','A','T','\0'};
+const uint32_t catalog_version = 2;
+
+struct catalog_header{
+    char magic[8];
+    uint32_t version;
+    uint32_t node_capacity;
+    uint32_t record_size;
+    uint32_t node_size;
+    uint64_t tile_count;        ///< 可读的文件数
+    uint64_t record_count;      ///< 可读 + 不可读的文件数
+    uint64_t record_offset;
+    uint64_t string_offset, string_size;
+    uint64_t id_offset, id_count;
+    uint64_t node_offset, node_count;
+    uint64_t filter_offset, filter_size;    ///< 最近一次update的filter_name, 在字符串段中
+};
+
+struct catalog_record{
+    uint64_t path_offset, path_size;
+    int64_t mtime;
+    uint64_t size;
+    double lon_min, lon_max, lat_min, lat_max;
+    double x_res, y_res;
+    double nodata;
+    int32_t datatype;
+    int32_t width, height;
+    uint8_t has_nodata;
+    uint8_t reserved[3];
+};
+
+/// R-tree节点在文件中的结构, envelope_rtree::node含OGREnvelope(有自定义的拷贝构造, 不能按字节读写)且有未初始化的填充字节
+struct catalog_node{
+    double min_x, max_x, min_y, max_y;
+    uint64_t first, count;
+    uint8_t leaf;
+    uint8_t reserved[7];
+};
+
+static_assert(std::is_trivially_copyable<catalog_record>::value, "catalog_record should be trivially copyable.");
+static_assert(std::is_trivially_copyable<catalog_node>::value, "catalog_node should be trivially copyable.");
+
+catalog_node to_node(const envelope_rtree::node& n)
+{
+    catalog_node c;
+    std::memset(&c, 0, sizeof(c));
+    c.min_x = n.env.MinX; c.max_x = n.env.MaxX;
+    c.min_y = n.env.MinY; c.max_y = n.env.MaxY;
+    c.first = n.first;
+    c.count = n.count;
+    c.leaf = n.leaf;
+    return c;
+}
+
+envelope_rtree::node from_node(const catalog_node& c)
+{
+    envelope_rtree::node n;
+    n.env.MinX = c.min_x; n.env.MaxX = c.max_x;
+    n.env.MinY = c.min_y; n.env.MaxY = c.max_y;
+    n.first = c.first;
+    n.count = c.count;
+    n.leaf = c.leaf != 0;
+    return n;
+}
+
+catalog_record to_record(const tile_info& t, uint64_t path_offset)
+{
+    catalog_record r;
+    std::memset(&r, 0, sizeof(r));
+    r.path_offset = path_offset;
+    r.path_size = t.path.size();
+    r.mtime = t.mtime;
+    r.size = t.size;
+    r.lon_min = t.lon_min; r.lon_max = t.lon_max;
+    r.lat_min = t.lat_min; r.lat_max = t.lat_max;
+    r.x_res = t.x_res; r.y_res = t.y_res;
+    r.nodata = t.nodata;
+    r.datatype = int32_t(t.datatype);
+    r.width = t.width; r.height = t.height;
+    r.has_nodata = t.has_nodata;
+    return r;
+}
+
+tile_info from_record(const catalog_record& r, const char* strings)
+{
+    tile_info t;
+    t.path.assign(strings + r.path_offset, size_t(r.path_size));
+    t.mtime = r.mtime;
+    t.size = r.size;
+    t.lon_min = r.lon_min; t.lon_max = r.lon_max;
+    t.lat_min = r.lat_min; t.lat_max = r.lat_max;
+    t.x_res = r.x_res; t.y_res = r.y_res;
+    t.nodata = r.nodata;
+    t.datatype = GDALDataType(r.datatype);
+    t.width = r.width; t.height = r.height;
+    t.has_nodata = r.has_nodata != 0;
+    return t;
+}
+
+/// @brief 各文件四至范围的外接矩形
+std::vector<OGREnvelope> tile_envelopes(const std::vector<tile_info>& tiles)
+{
+    std::vector<OGREnvelope> envelopes(tiles.size());
+    for(size_t i = 0; i < tiles.size(); i++){
+        envelopes[i].MinX = MIN(tiles[i].lon_min, tiles[i].lon_max);
+        envelopes[i].MaxX = MAX(tiles[i].lon_min, tiles[i].lon_max);
+        envelopes[i].MinY = MIN(tiles[i].lat_min, tiles[i].lat_max);
+        envelopes[i].MaxY = MAX(tiles[i].lat_min, tiles[i].lat_max);
+    }
+    return envelopes;
+}
+
+/// @brief 用GDAL读取文件的四至范围等信息, 无法打开时返回false
+bool read_tile_info(tile_info& t)
+{
+    GDALDataset* ds = (GDALDataset*)GDALOpen(t.path.c_str(), GA_ReadOnly);
+    if(!ds)
+        return false;
+    if(ds->GetRasterCount() < 1){
+        GDALClose(ds);
+        return false;
+    }
+    double gt[6] = {0, 1, 0, 0, 0, 1};
+    ds->GetGeoTransform(gt);
+    t.width = ds->GetRasterXSize();
+    t.height = ds->GetRasterYSize();
+    GDALRasterBand* rb = ds->GetRasterBand(1);
+    t.datatype = rb->GetRasterDataType();
+    int has_nodata = 0;
+    t.nodata = rb->GetNoDataValue(&has_nodata);
+    t.has_nodata = has_nodata != 0;
+    GDALClose(ds);
+
+    t.lon_min = gt[0]; t.lon_max = gt[0] + t.width * gt[1];
+    t.lat_max = gt[3]; t.lat_min = gt[3] + t.height * gt[5];
+    t.x_res = gt[1]; t.y_res = gt[5];
+    return true;
+}
+
+}
+
+funcrst tile_catalog::load(std::string catalog_path)
+{
+    m_tiles.clear();
+    m_unreadable.clear();
+    m_filter_name.clear();
+    m_index = envelope_rtree();
+    m_modified = true;
+
+    std::error_code ec;
+    uint64_t file_size = fs::file_size(catalog_path, ec);
+    std::ifstream ifs(catalog_path, std::ios::binary);
+    if(ec || !ifs.is_open())
+        return funcrst(false, fmt::format("tile_catalog::load, open '{}' failed.", catalog_path));
+
+    catalog_header header;
+    if(file_size < sizeof(header) || !ifs.read((char*)&header, sizeof(header)))
+        return funcrst(false, "tile_catalog::load, file is too small.");
+    if(std::memcmp(header.magic, catalog_magic, sizeof(catalog_magic)) != 0 || header.version != catalog_version ||
+       header.record_size != sizeof(catalog_record) || header.node_size != sizeof(catalog_node))
+        return funcrst(false, "tile_catalog::load, unsupported catalog format or version.");
+
+    /// [offset, offset + count * size)是否在文件内
+    auto contains = [&](uint64_t offset, uint64_t count, uint64_t size){
+        return offset <= file_size && count <= (file_size - offset) / size;
+    };
+    if(header.tile_count > header.record_count ||
+       !contains(header.record_offset, header.record_count, sizeof(catalog_record)) ||
+       !contains(header.string_offset, header.string_size, 1) ||
+       !contains(header.id_offset, header.id_count, sizeof(uint64_t)) ||
+       !contains(header.node_offset, header.node_count, sizeof(catalog_node)) ||
+       header.filter_offset > header.string_size || header.filter_size > header.string_size - header.filter_offset)
+        return funcrst(false, "tile_catalog::load, catalog is truncated.");
+
+    std::vector<catalog_record> records(size_t(header.record_count));
+    std::string strings(size_t(header.string_size), '\0');
+    std::vector<uint64_t> ids(size_t(header.id_count));
+    std::vector<catalog_node> disk_nodes(size_t(header.node_count));
+    auto read_section = [&](uint64_t offset, void* data, uint64_t bytes){
+        ifs.seekg(std::streamoff(offset));
+        return bytes == 0 || bool(ifs.read((char*)data, std::streamsize(bytes)));
+    };
+    if(!read_section(header.record_offset, records.data(), records.size() * sizeof(catalog_record)) ||
+       !read_section(header.string_offset, strings.data(), strings.size()) ||
+       !read_section(header.id_offset, ids.data(), ids.size() * sizeof(uint64_t)) ||
+       !read_section(header.node_offset, disk_nodes.data(), disk_nodes.size() * sizeof(catalog_node)))
+        return funcrst(false, fmt::format("tile_catalog::load, read '{}' failed.", catalog_path));
+
+    for(size_t i = 0; i < records.size(); i++){
+        if(records[i].path_offset > header.string_size || records[i].path_size > header.string_size - records[i].path_offset){
+            m_tiles.clear();
+            m_unreadable.clear();
+            return funcrst(false, "tile_catalog::load, invalid path in catalog.");
+        }
+        (i < header.tile_count ? m_tiles : m_unreadable).push_back(from_record(records[i], strings.data()));
+    }
+    m_filter_name = strings.substr(size_t(header.filter_offset), size_t(header.filter_size));
+
+    /// 直接恢复R-tree, 不重新排序; 结构不合法时重新构建
+    std::vector<envelope_rtree::node> nodes(disk_nodes.size());
+    std::transform(disk_nodes.begin(), disk_nodes.end(), nodes.begin(), from_node);
+    m_index = envelope_rtree(tile_envelopes(m_tiles), std::move(ids), std::move(nodes), int(header.node_capacity));
+    if(m_index.size() > 0 && m_index.nodes().empty())
+        rebuild_index();
+    else
+        m_modified = false;
+
+    return funcrst(true, fmt::format("tile_catalog::load success, {} tiles, {} unreadable files, last filter '{}'.",
+        m_tiles.size(), m_unreadable.size(), m_filter_name));
+}
+
+funcrst tile_catalog::save(std::string catalog_path) const
+{
+    std::string strings;
+    std::vector<catalog_record> records;
+    records.reserve(m_tiles.size() + m_unreadable.size());
+    for(auto list : {&m_tiles, &m_unreadable}){
+        for(auto& t : *list){
+            records.push_back(to_record(t, strings.size()));
+            strings += t.path;
+        }
+    }
+    uint64_t filter_offset = strings.size();
+    strings += m_filter_name;
+    std::vector<catalog_node> nodes(m_index.nodes().size());
+    std::transform(m_index.nodes().begin(), m_index.nodes().end(), nodes.begin(), to_node);
+
+    catalog_header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, catalog_magic, sizeof(catalog_magic));
+    header.version = catalog_version;
+    header.node_capacity = uint32_t(m_index.capacity());
+    header.record_size = sizeof(catalog_record);
+    header.node_size = sizeof(catalog_node);
+    header.tile_count = m_tiles.size();
+    header.record_count = records.size();
+    header.record_offset = sizeof(catalog_header);
+    header.string_offset = header.record_offset + records.size() * sizeof(catalog_record);
+    header.string_size = strings.size();
+    /// ids与nodes按8字节对齐
+    header.id_offset = (header.string_offset + header.string_size + 7) / 8 * 8;
+    header.id_count = m_index.ids().size();
+    header.node_offset = header.id_offset + header.id_count * sizeof(uint64_t);
+    header.node_count = nodes.size();
+    header.filter_offset = filter_offset;
+    header.filter_size = m_filter_name.size();
+
+    std::string temp_path = catalog_path + ".tmp";
+    {
+        std::ofstream ofs(temp_path, std::ios::binary | std::ios::trunc);
+        if(!ofs.is_open())
+            return funcrst(false, fmt::format("tile_catalog::save, open '{}' failed.", temp_path));
+        const char padding[8] = {0};
+        ofs.write((const char*)&header, sizeof(header));
+        ofs.write((const char*)records.data(), records.size() * sizeof(catalog_record));
+        ofs.write(strings.data(), strings.size());
+        ofs.write(padding, header.id_offset - header.string_offset - header.string_size);
+        ofs.write((const char*)m_index.ids().data(), m_index.ids().size() * sizeof(uint64_t));
+        ofs.write((const char*)nodes.data(), nodes.size() * sizeof(catalog_node));
+        if(!ofs.good())
+            return funcrst(false, fmt::format("tile_catalog::save, write '{}' failed.", temp_path));
+    }
+
+    std::error_code ec;
+    fs::rename(temp_path, catalog_path, ec);
+    if(ec){
+        fs::remove(temp_path, ec);
+        return funcrst(false, fmt::format("tile_catalog::save, rename to '{}' failed.", catalog_path));
+    }
+    return funcrst(true, fmt::format("tile_catalog::save success, {} tiles.", m_tiles.size()));
+}
+
+funcrst tile_catalog::update(std::string root, std::string filter_name, std::function<bool(const std::string& filename)> filter, int threads, tile_catalog_stats* stats)
+{
+    tile_catalog_stats st;
+
+    /// 1. 扫描文件夹, 只读取目录项的修改时间与大小, 不打开文件; 不满足filter的文件也参与比较, 以保留其他filter建立的记录
+    std::vector<tile_info> scanned;
+    std::vector<char> matched;
+    std::error_code ec;
+    for(auto iter = fs::recursive_directory_iterator(root, fs::directory_options::skip_permission_denied, ec);
+        iter != fs::recursive_directory_iterator(); iter.increment(ec))
+    {
+        if(ec)
+            return funcrst(false, fmt::format("tile_catalog::update, scan '{}' failed, {}.", root, ec.message()));
+        if(!iter->is_regular_file(ec))
+            continue;
+        tile_info t;
+        t.path = iter->path().string();
+        t.mtime = int64_t(iter->last_write_time(ec).time_since_epoch().count());
+        t.size = uint64_t(iter->file_size(ec));
+        scanned.push_back(t);
+        matched.push_back(!filter || filter(iter->path().filename().string()));
+    }
+    if(ec)
+        return funcrst(false, fmt::format("tile_catalog::update, scan '{}' failed, {}.", root, ec.message()));
+
+    /// 2. 与目录比较, 路径, 修改时间与大小都相同的直接使用目录中的记录(无论是否满足filter);
+    /// 新增或修改过的文件只有满足filter时才读取, 不满足的不记录(修改过的原记录视为删除)
+    std::map<std::string, std::pair<const tile_info*, bool>> known;
+    for(auto& t : m_tiles)
+        known[t.path] = {&t, true};
+    for(auto& t : m_unreadable)
+        known[t.path] = {&t, false};
+
+    std::vector<tile_info> kept;
+    std::vector<char> readable;
+    std::vector<size_t> to_read;
+    for(size_t i = 0; i < scanned.size(); i++){
+        auto it = known.find(scanned[i].path);
+        if(it != known.end() && it->second.first->mtime == scanned[i].mtime && it->second.first->size == scanned[i].size){
+            kept.push_back(*it->second.first);
+            readable.push_back(it->second.second);
+            (matched[i] ? st.reused : st.kept)++;
+            known.erase(it);
+        }
+        else if(matched[i]){
+            if(it != known.end())
+                known.erase(it);
+            to_read.push_back(kept.size());
+            kept.push_back(std::move(scanned[i]));
+            readable.push_back(0);
+        }
+    }
+    st.removed = known.size();
+    st.added = to_read.size();
+
+    /// 3. 多线程打开新增或修改过的文件
+    if(threads <= 0)
+        threads = omp_get_num_procs();
+    int num = int(to_read.size());
+#pragma omp parallel for schedule(dynamic) num_threads(threads)
+    for(int k = 0; k < num; k++)
+        readable[to_read[k]] = read_tile_info(kept[to_read[k]]);
+
+    /// 按路径排序
+    std::vector<size_t> order(kept.size());
+    std::iota(order.begin(), order.end(), size_t(0));
+    std::sort(order.begin(), order.end(), [&](size_t l, size_t r){ return kept[l].path < kept[r].path; });
+    std::vector<tile_info> tiles, unreadable;
+    for(size_t i : order)
+        (readable[i] ? tiles : unreadable).push_back(std::move(kept[i]));
+    st.unreadable = unreadable.size();
+
+    if(st.added > 0 || st.removed > 0 || m_modified){
+        m_tiles.swap(tiles);
+        m_unreadable.swap(unreadable);
+        rebuild_index();
+    }
+    if(filter_name != m_filter_name){
+        m_filter_name = filter_name;
+        m_modified = true;
+    }
+    if(stats)
+        *stats = st;
+    return funcrst(true, fmt::format("tile_catalog::update success, {} reused, {} added or changed, {} removed, {} unreadable, {} kept for other filters.",
+        st.reused, st.added, st.removed, st.unreadable, st.kept));
+}
+
+void tile_catalog::rebuild_index()
+{
+    m_index = envelope_rtree(tile_envelopes(m_tiles));
+    m_modified = true;
+}
@@ -0,0 +1,79 @@
+#ifndef TILE_CATALOG_H
+#define TILE_CATALOG_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <functional>
+
+#include <gdal_priv.h>
+
+#include "datatype.h"
+#include "envelope_rtree.h"
+
+/// 分块数据(如Copernicus DEM)文件夹的二进制目录, 替代原来的IMGS_INFO_FOR_MERGING.txt.
+/// 目录记录每个文件的路径, 修改时间, 大小, 四至范围, 数据类型, nodata与分辨率, 以及四至范围的R-tree(envelope_rtree),
+/// 加载时按偏移一次读入各段并直接恢复R-tree(不重新排序); 更新时只重新读取新增或修改过(修改时间或大小不同)的文件, 并多线程打开.
+/// 不同的文件名筛选条件(如正则表达式)共用一个目录: 已有的记录不因不满足当前条件而删除, 使用者在查询结果中再按条件筛选.
+
+/// @brief 单个文件的信息
+struct tile_info{
+    std::string path;
+    int64_t mtime{ 0 };             ///< 文件修改时间(std::filesystem::file_time_type的计数)
+    uint64_t size{ 0 };             ///< 文件大小(字节)
+    int width{ 0 }, height{ 0 };
+    GDALDataType datatype{ GDT_Unknown };
+    double lon_min{ 0 }, lon_max{ 0 }, lat_min{ 0 }, lat_max{ 0 };
+    double x_res{ 0 }, y_res{ 0 };  ///< 六参数中的gt[1]与gt[5]
+    bool has_nodata{ false };
+    double nodata{ 0 };
+};
+
+/// @brief update的统计结果
+struct tile_catalog_stats{
+    size_t reused{ 0 };             ///< 未修改, 直接使用目录中的记录
+    size_t added{ 0 };              ///< 新增或修改过, 重新读取
+    size_t removed{ 0 };            ///< 目录中有但文件夹中已不存在
+    size_t unreadable{ 0 };         ///< GDAL无法打开的文件
+    size_t kept{ 0 };               ///< 不满足本次filter, 但未修改而保留的记录
+};
+
+class tile_catalog
+{
+public:
+    /// @brief 读取目录文件, 格式或版本不符时返回false, 此时目录为空
+    funcrst load(std::string catalog_path);
+
+    /// @brief 写出目录文件(先写临时文件再重命名)
+    funcrst save(std::string catalog_path) const;
+
+    /// @brief 递归扫描root, 与当前目录比较后只读取文件名满足filter的新增或修改过的文件;
+    /// 未修改的记录即使不满足filter也保留, 只有文件已删除或修改后不满足filter时才移除
+    /// @param filter_name filter的描述(如正则表达式), 记录在目录中
+    /// @param threads 打开文件的线程数, 0表示全部cpu
+    funcrst update(std::string root, std::string filter_name, std::function<bool(const std::string& filename)> filter, int threads, tile_catalog_stats* stats = nullptr);
+
+    /// @brief 最近一次update使用的filter_name
+    const std::string& filter_name() const { return m_filter_name; }
+
+    /// @brief 是否有未保存的修改
+    bool modified() const { return m_modified; }
+
+    /// @brief GDAL可以打开的文件, 按路径排序, 包括其他filter建立的记录
+    const std::vector<tile_info>& tiles() const { return m_tiles; }
+
+    /// @brief tiles()四至范围的R-tree, 查询结果为tiles()中的下标
+    const envelope_rtree& index() const { return m_index; }
+
+private:
+    void rebuild_index();
+
+    std::vector<tile_info> m_tiles;
+    /// GDAL无法打开的文件也记录下来(只有路径, 修改时间与大小), 未修改时不再重复尝试
+    std::vector<tile_info> m_unreadable;
+    std::string m_filter_name;
+    envelope_rtree m_index;
+    bool m_modified{ false };
+};
+
+#endif // TILE_CATALOG_H
@@ -8,14 +8,19 @@
 
 #include <omp.h>
 #include <mutex>
+#include <future>
+#include <atomic>
 
 #include <spdlog/spdlog.h>
 #include <spdlog/sinks/basic_file_sink.h>
 
 #include <gdal_priv.h>
 #include <ogrsf_frmts.h>
+#include <gdal_alg.h>
 
 #include "datatype.h"
+#include "envelope_rtree.h"
+#include "tile_catalog.h"
 
 #define EXE_NAME "unified_geoimage_merging"
 
@@ -38,6 +43,15 @@ struct ll_range{
     double lon_min, lon_max, lat_min, lat_max;
 };
 
+/// @brief 掩膜为0的像素置为nodata, 无分支的逐像素选择, 可以被编译器向量化
+template<typename _Ty>
+void apply_mask(_Ty* arr, const unsigned char* mask, _Ty nodata, int count)
+{
+#pragma omp simd
+    for(int i = 0; i < count; i++)
+        arr[i] = mask[i] ? arr[i] : nodata;
+}
+
 // enum class mergingMethod{minimum, maximum};
 enum class mergingMethod{rectangle, intersect_rectangle, irregular};
 
@@ -133,105 +147,58 @@ int main(int argc, char* argv[])
     vector<string> valid_imgpaths;
     /// 有效数据对应的四至范围
     vector<ll_range> valid_ll_ranges;
-    int valid_num = 0;
 
     regex reg_f(regex_regular);
-    smatch result;
 
-    fs::path path_imgs_info(root_path.string() + "/IMGS_INFO_FOR_MERGING.txt");
-    if(fs::exists(path_imgs_info))
+    /// 分块数据的二进制目录(路径, 修改时间, 大小, 四至范围, 数据类型, nodata, 分辨率及四至范围的R-tree),
+    /// 已存在时读取并直接恢复R-tree, 再与文件夹的扫描结果比较, 只重新读取新增或修改过的文件;
+    /// 目录保留其他正则表达式建立的记录, 使用时再按当前的正则表达式筛选
+    fs::path path_catalog(root_path.string() + "/TILES_CATALOG_FOR_MERGING.bin");
+    string catalog_filename = path_catalog.filename().string();
+    auto tile_filter = [&](const string& filename){
+        /// 跳过目录文件本身(及保存时的临时文件)
+        if(filename.compare(0, catalog_filename.size(), catalog_filename) == 0)
+            return false;
+        smatch result;
+        return !b_regex || regex_match(filename, result, reg_f);
+    };
+    tile_catalog catalog;
     {
-        /// 如果IMGS_INFO_FOR_MERGING.txt文件已存在, 就直接读取文件内的DEM地址以及DEM对应的四至范围
-        spdlog::info("IMGS_INFO_FOR_MERGING.txt is existed");
-        std::ifstream ifs(path_imgs_info.string());
-        if(!ifs.is_open()){
-            spdlog::warn("IMGS_INFO_FOR_MERGING.txt open failed, turn to write...");
-            goto write;
-        }
-        string str;
-        int idx = 0;
-        vector<string> splited_str;
-        while(getline(ifs,str))
-        {
-            idx++;
-            if(idx == 1)
-                continue;
-            strSplit(str, splited_str, ",");
-            if(splited_str.size()<5)
-                continue;
-            
-            auto t = ll_range(stod(splited_str[1]),stod(splited_str[2]),stod(splited_str[3]),stod(splited_str[4]));
-
-            valid_imgpaths.push_back(splited_str[0]);
-            valid_ll_ranges.push_back(t);
-            valid_num++;
-
-            cout<<fmt::format("\rnumber of validimage: {}",valid_num);
-        }
-        ifs.close();
-        cout<<"\n";
-        spdlog::info("extract valid_imgpaths & valid_ll_ranges from IMGS_INFO_FOR_MERGING.txt");
-    }
-    else{
-write:
-        /// 如果找不到IMGS_INFO_FOR_MERGING.txt文件, 就逐个读取并存储
-        spdlog::info("there is no IMGS_INFO_FOR_MERGING.txt file, let's create it.(which will spend a little of times.)");
-        std::ofstream ofs(path_imgs_info.string());
-        if(ofs.is_open()){
-            ofs<<"regex regular: "<<regex_regular<<endl;
-        }
-        int idx = 0;
-        for (auto& iter : fs::recursive_directory_iterator(root_path)){
-            if(iter.is_directory())
-                continue;
-
-            string filename = iter.path().filename().string();
-            bool res = regex_match(filename, result, reg_f);
-            if(b_regex && !res)
-                continue;
-
-            GDALDataset* ds = (GDALDataset*)GDALOpen(iter.path().string().c_str(), GA_ReadOnly);
-            if(!ds){
-                continue;
-            }
+        auto catalog_starttime = chrono::system_clock::now();
+        funcrst rst = catalog.load(path_catalog.string());
+        if(rst)
+            spdlog::info(rst.explain);
+        else
+            spdlog::info(fmt::format("{} let's create it.(which will spend a little of times.)", rst.explain));
 
-            double* gt = new double[6];
-            ds->GetGeoTransform(gt);
-            int width = ds->GetRasterXSize();
-            int height= ds->GetRasterYSize();
-
-            GDALClose(ds);
-
-            double lon_min = gt[0], lon_max = gt[0] +  width * gt[1];
-            double lat_max = gt[3], lat_min = gt[3] + height * gt[5];
-            auto t = ll_range(lon_min,lon_max,lat_min,lat_max);
-            delete[] gt;
-            
-            
-            valid_imgpaths.push_back(iter.path().string());
-            valid_ll_ranges.push_back(t);
-            valid_num++;
-            spdlog::info(fmt::format("\rnumber of validimage: {}",valid_num));
-
-            if(ofs.is_open()){
-                ofs<<fmt::format("{},{},{},{},{}",iter.path().string(),lon_min,lon_max,lat_min,lat_max)<<endl;
-            }
+        rst = catalog.update(root_path.string(), regex_regular, tile_filter, 0);
+        if(!rst){
+            return return_msg(-4, rst.explain);
         }
-        cout<<"\n";
-        spdlog::info("extract valid_imgpaths & valid_ll_ranges from dem file.");
-
-        if(ofs.is_open()){
-            ofs.close();
-            spdlog::warn("valid_imgpaths & valid_ll_ranges has been write in IMGS_INFO_FOR_MERGING.txt file.");
+        spdlog::info(rst.explain);
+
+        if(catalog.modified()){
+            rst = catalog.save(path_catalog.string());
+            if(rst)
+                spdlog::warn(fmt::format("valid_imgpaths & valid_ll_ranges has been write in {}.", catalog_filename));
+            else
+                spdlog::info(fmt::format("{} valid_imgpaths & valid_ll_ranges write in file failed.", rst.explain));
         }
-        else{
-            spdlog::info("ofs.open IMGS_INFO_FOR_MERGING.txt failed, valid_imgpaths & valid_ll_ranges write in file failed.");
-        }
-        
+        spdlog::info(fmt::format("catalog spend time: {:.3f}s.", spend_time(catalog_starttime)));
+    }
+    /// 下标与catalog.tiles()及其R-tree一致, b_selected为满足当前正则表达式的文件
+    vector<char> b_selected(catalog.tiles().size(), 0);
+    size_t selected_num = 0;
+    for(size_t i = 0; i < catalog.tiles().size(); i++){
+        const tile_info& tile = catalog.tiles()[i];
+        valid_imgpaths.push_back(tile.path);
+        valid_ll_ranges.push_back(ll_range(tile.lon_min, tile.lon_max, tile.lat_min, tile.lat_max));
+        b_selected[i] = tile_filter(fs::path(tile.path).filename().string());
+        selected_num += b_selected[i];
     }
 
-    spdlog::info(fmt::format("number of valid_file: {}",valid_imgpaths.size()));
-    if(valid_imgpaths.size() == 0){
+    spdlog::info(fmt::format("number of valid_file: {} (of {} in catalog)", selected_num, valid_imgpaths.size()));
+    if(selected_num == 0){
         return return_msg(-5, "there is no valid file in argv[1].");
     }
 #ifdef PRINT_DETAILS
@@ -361,6 +328,12 @@ write:
         return return_msg(-3, "number of geometry in shp < 1");
     }
 
+    /// 2.2 几何体的外接矩形构建R-tree, 用于筛选分块数据(#3)以及irregular方法中按条带栅格化掩膜(#5)
+    vector<OGREnvelope> shp_envelopes(shp_geometry_vec.size());
+    for(size_t g_idx = 0; g_idx < shp_geometry_vec.size(); g_idx++)
+        shp_geometry_vec[g_idx]->getEnvelope(&shp_envelopes[g_idx]);
+    envelope_rtree shp_rtree(shp_envelopes);
+
 
 #ifdef SYSTEM_PAUSE
     system("pause");
@@ -374,72 +347,70 @@ write:
     int invalid_imgpath_num = 0; 
     int contains_num = 0;
     vector<string> contains_imgpath;
+    vector<tile_info> contains_tiles;
     
-    // OGRGeometry* geometry;
-
-    int idx = 0;
-    int last_percentage = -1;
-#pragma omp parallel for
-    for(int i=0; i<valid_imgpaths.size(); i++)
-    // for(auto& imgpath : valid_imgpaths)
+    /// 3.1 分块数据的四至范围与shp中几何体的外接矩形分别有R-tree, 由外接矩形连接得到候选的(分块, 几何体)对, 只有候选才做精确的相交判断
+    auto select_starttime = chrono::system_clock::now();
+    /// 分块数据的R-tree随目录一起保存, 下标与valid_imgpaths一致
+    const envelope_rtree& img_rtree = catalog.index();
+
+    /// 每个分块数据对应的候选几何体下标
+    vector<vector<int>> candidates(valid_imgpaths.size());
+    vector<char> b_contains_vec(valid_imgpaths.size(), 0);
+    if(merging_method == mergingMethod::intersect_rectangle || merging_method == mergingMethod::irregular)
     {
-        int current_percentage = int(idx * 1000 / valid_imgpaths.size());
-        if(current_percentage > last_percentage){
-            last_percentage = current_percentage;
-            std::cout<<fmt::format("\r  preparing percentage {:.1f}%({}/{}): ",last_percentage/10., idx, valid_imgpaths.size());
-        }
-        idx++;
-
-        string imgpath = valid_imgpaths[i];
-        ll_range range = valid_ll_ranges[i];
-
-        double img_lon_min = range.lon_min;
-        double img_lon_max = range.lon_max;
-        double img_lat_max = range.lat_max;
-        double img_lat_min = range.lat_min;
-
-#ifdef PRINT_DETAILS
-        std::cout<<fmt::format("img range, left:{:.4f}, top:{:.4f}, right:{:.4f}, down:{:.4f}.",
-                    img_lon_min, img_lat_max, img_lon_max, img_lat_min);
-#endif
-        /// 判断该影像与shp是否相交(广义上的相交，包含计算四至范围(rectangle)和求相交矩形(intersect-rectangle, irregular)两种方法)
-        bool b_contains = false;
-        if(merging_method == mergingMethod::intersect_rectangle || merging_method == mergingMethod::irregular)
+        envelope_join(img_rtree, shp_rtree, [&](size_t img_idx, size_t g_idx){
+            if(b_selected[img_idx])
+                candidates[img_idx].push_back(int(g_idx));
+        });
+        size_t candidate_pairs = 0;
+        for(auto& c : candidates) candidate_pairs += c.size();
+        spdlog::info(fmt::format("envelope join: {} candidate pairs of (image, geometry), instead of {}.",
+                        candidate_pairs, selected_num * shp_geometry_vec.size()));
+
+        /// 3.2 候选对做精确的GEOS相交判断
+#pragma omp parallel for schedule(dynamic)
+        for(int i=0; i<valid_imgpaths.size(); i++)
         {
-            OGRGeometry* img_geometry = range_to_ogrgeometry(img_lon_min, img_lon_max, img_lat_min, img_lat_max);
-            for(int g_idx = 0; g_idx < shp_geometry_vec.size(); g_idx++){
+            if(candidates[i].empty())
+                continue;
+            ll_range range = valid_ll_ranges[i];
+            OGRGeometry* img_geometry = range_to_ogrgeometry(range.lon_min, range.lon_max, range.lat_min, range.lat_max);
+            for(int g_idx : candidates[i]){
                 if(shp_geometry_vec[g_idx]->Intersects(img_geometry)){
-                    b_contains = true;
+                    b_contains_vec[i] = 1;
                     break;
                 }
             }
             OGRGeometryFactory::destroyGeometry(img_geometry);
         }
-        else{
-            if(img_lon_min > shp_lon_max || img_lon_max < shp_lon_min || img_lat_max < shp_lat_min || img_lat_min > shp_lat_max){
-                b_contains = false;
-            }else{
-                b_contains = true;
-            }
-        }
-        
-        
-        if(!b_contains){
+    }
+    else{
+        img_rtree.query(envelope_total, [&](size_t img_idx){
+            b_contains_vec[img_idx] = b_selected[img_idx];
+        });
+    }
+
+    /// 3.3 按原始顺序汇总相交的影像及其覆盖范围
+    for(size_t i=0; i<valid_imgpaths.size(); i++)
+    {
+        if(!b_contains_vec[i])
             continue;
-        }
 
-        /// 到这里说明相交
-        mtx.lock();
+        ll_range range = valid_ll_ranges[i];
+#ifdef PRINT_DETAILS
+        std::cout<<fmt::format("img range, left:{:.4f}, top:{:.4f}, right:{:.4f}, down:{:.4f}.\n",
+                    range.lon_min, range.lat_max, range.lon_max, range.lat_min);
+#endif
         ++contains_num;
-
-        contains_lon_max = MAX(img_lon_max, contains_lon_max);
-        contains_lon_min = MIN(img_lon_min, contains_lon_min);
-        contains_lat_max = MAX(img_lat_max, contains_lat_max);
-        contains_lat_min = MIN(img_lat_min, contains_lat_min);
-        contains_imgpath.push_back(imgpath);
-        mtx.unlock();
+        contains_lon_max = MAX(range.lon_max, contains_lon_max);
+        contains_lon_min = MIN(range.lon_min, contains_lon_min);
+        contains_lat_max = MAX(range.lat_max, contains_lat_max);
+        contains_lat_min = MIN(range.lat_min, contains_lat_min);
+        contains_imgpath.push_back(valid_imgpaths[i]);
+        contains_tiles.push_back(catalog.tiles()[i]);
     }
-    cout<<"\n";
+    spdlog::info(fmt::format("select images spend time: {:.3f}s.", spend_time(select_starttime)));
     GDALClose(shp_dataset);
     valid_imgpaths.clear();
 
@@ -463,7 +434,7 @@ write:
 #endif
 
     /// 3. 读取影像文件, 将满足条件的所有影像（contains）写到同一个tif里
-    spdlog::info(" #4. Generate output images and assign initial values (short/int: -32767; float: NAN). If the file exists and the size and six parameters are the same, skip the initialization process directly.");
+    spdlog::info(" #4. Generate output images as sparse tiled tif with nodata (short/int: -32767; float: NAN), blocks not covered by any image are never written. If the file exists and the size and six parameters are the same, reuse it directly.");
 
     int width  = (int)ceil((contains_lon_max - contains_lon_min) / spacing);
     int height = (int)ceil((contains_lat_max - contains_lat_min) / spacing);
@@ -480,7 +451,7 @@ write:
         op_ds = (GDALDataset*)GDALOpen(op_filepath.c_str(),GA_Update);
         if(!op_ds){
             fs::remove(path_output);
-            spdlog::warn("output file existed, but open failed, let's remove, create and init it.");
+            spdlog::warn("output file existed, but open failed, let's remove and create it.");
             goto init;
         }
         int temp_width = op_ds->GetRasterXSize();
@@ -497,239 +468,263 @@ write:
         if(temp_width != width || temp_height != height || temp_datatype != datatype){
             GDALClose(op_ds);
             fs::remove(path_output);
-            spdlog::warn(fmt::format("output file is diff with target, let's remove, create and init it."));
+            spdlog::warn(fmt::format("output file is diff with target, let's remove and create it."));
             goto init;
         }
-        spdlog::info("the existed output file is same with target, so there is no need to init this file.");
+        spdlog::info("the existed output file is same with target, reuse it.");
     }
     else{
 init:
-        spdlog::warn(" ##4.1. output file is unexisted, let's create and init it (which will spend a little of time).");
+        spdlog::warn(" ##4.1. output file is unexisted, let's create it.");
         GDALDriver* driver_tif = GetGDALDriverManager()->GetDriverByName("GTiff");
 
+        /// 分块且稀疏(SPARSE_OK)的tif: 没有写入的block不占用文件空间, 读取时为nodata, 因此不再需要逐行写入初始值
         char **papszOptions = NULL;
         papszOptions = CSLSetNameValue(papszOptions, "BIGTIFF", "IF_NEEDED");
+        papszOptions = CSLSetNameValue(papszOptions, "TILED", "YES");
+        papszOptions = CSLSetNameValue(papszOptions, "BLOCKXSIZE", "512");
+        papszOptions = CSLSetNameValue(papszOptions, "BLOCKYSIZE", "512");
+        papszOptions = CSLSetNameValue(papszOptions, "SPARSE_OK", "TRUE");
         op_ds = driver_tif->Create(op_filepath.c_str(), width, height, 1, datatype, papszOptions);
+        CSLDestroy(papszOptions);
+        if(!op_ds){
+            return return_msg(-7, fmt::format("create output file failed, {}", CPLGetLastErrorMsg()));
+        }
         op_rb = op_ds->GetRasterBand(1);
         op_ds->SetGeoTransform(op_gt);
         if(op_ds->SetSpatialRef(osr) != CE_None){
             spdlog::warn("op_ds->SetSpatialRef(osr) failed.");
         }
-        spdlog::info(fmt::format("output_rasterband init...",width, height));
-        last_percentage = 0;
-        auto init_starttime = chrono::system_clock::now();
-
-        switch (datatype)
-        {
-        case GDT_Int16:
-            {
-                short* arr = new short[width];
-                for(int i=0; i< width; i++) arr[i] = -32767;
-                for(int i = 0; i< height; i++){
-                    int current_percentage = i * 1000 / height;
-                    if(current_percentage > last_percentage){
-                        last_percentage = current_percentage;
-                        auto spend = spend_time(init_starttime);
-                        size_t remain_sceond = static_cast<size_t>(spend / last_percentage * (1000  - last_percentage));
-                        std::cout<<fmt::format("\r  init percentage {:.1f}%({}/{}), remain_time:{}s...            ",last_percentage/10., i, height,remain_sceond);
-                    }
-                    op_rb->RasterIO(GF_Write, 0, i, width, 1, arr, width, 1, datatype, 0, 0);
-                }
-                delete[] arr;
-                op_rb->SetNoDataValue(-32767);
-            }
-            break;
-        case GDT_Int32:
-            {
-                int* arr = new int[width];
-                for(int i=0; i< width; i++) arr[i] = -32767;
-                for(int i = 0; i< height; i++){
-                    int current_percentage = i * 1000 / height;
-                    if(current_percentage > last_percentage){
-                        last_percentage = current_percentage;
-                        auto spend = spend_time(init_starttime);
-                        size_t remain_sceond = static_cast<size_t>(spend / last_percentage * (1000  - last_percentage));
-                        std::cout<<fmt::format("\r  init percentage {:.1f}%({}/{}), remain_time:{}s...            ",last_percentage/10., i, height,remain_sceond);
-                    }
-                    op_rb->RasterIO(GF_Write, 0, i, width, 1, arr, width, 1, datatype, 0, 0);
-                }
-                delete[] arr;
-                op_rb->SetNoDataValue(-32767);
-            }
-            break;
-        case GDT_Float32:
-            {
-                float* arr = new float[width];
-                for(int k=0; k< width; k++) arr[k] = NAN;
-                for(int i = 0; i< height; i++){
-                    int current_percentage = i * 1000 / height;
-                    if(current_percentage > last_percentage){
-                        last_percentage = current_percentage;
-                        auto spend = spend_time(init_starttime);
-                        size_t remain_sceond = static_cast<size_t>(spend / last_percentage * (1000  - last_percentage));
-                        std::cout<<fmt::format("\r  init percentage {:.1f}%({}/{}), remain_time:{}s...            ",last_percentage/10., i, height,remain_sceond);
-                    }
-                    op_rb->RasterIO(GF_Write, 0, i, width, 1, arr, width, 1, datatype, 0, 0);
-                }
-                delete[] arr;
-                op_rb->SetNoDataValue(NAN);
-            }
-            break;
-        }
-        std::cout<<"\n";
+        op_rb->SetNoDataValue(datatype == GDT_Float32 ? NAN : -32767);
 
     }
 
     /// 3.2 拼接
     spdlog::info(" #5. DEM merging.");
     auto merging_starttime= chrono::system_clock::now();
-// #pragma omp parallel for
-    for(int i = 0; i< contains_imgpath.size(); i++)
-    // for(auto& imgpath : contains_imgpath)
-    {
-        auto t1= chrono::system_clock::now();
 
-        string imgpath = contains_imgpath[i];
-        GDALDataset* ds = (GDALDataset*)GDALOpen(imgpath.c_str(), GA_ReadOnly);
-        if(!ds){
-            continue;
-        }
-        GDALRasterBand* rb = ds->GetRasterBand(1);
-
-        int tmp_width = ds->GetRasterXSize();
-        int tmp_height= ds->GetRasterYSize();
-        double tmp_gt[6];
-        ds->GetGeoTransform(tmp_gt);
-
-        int start_x = (int)round((tmp_gt[0] - op_gt[0]) / op_gt[1]);
-        int start_y = (int)round((tmp_gt[3] - op_gt[3]) / op_gt[5]);
-#ifdef PRINT_DETAILS
-        std::cout<<fmt::format("img in root: start({},{}), size:({},{}), end:({},{})",
-                        start_x,start_y,
-                        tmp_width, tmp_height,
-                        start_x + tmp_width - 1,
-                        start_y + tmp_height - 1);
-#endif
-
-#if 1
-        /// 对于高纬度的地区, 
-        int target_width = tmp_width;
-        int target_height= tmp_height;
-
-        bool b_height_larger_than_width = false;
-        GDALRasterIOExtraArg ex_arg;
-        INIT_RASTERIO_EXTRA_ARG(ex_arg);
-        if(tmp_height > tmp_width){
-            b_height_larger_than_width = true;
-            target_width = target_height;
-            ex_arg.eResampleAlg = GDALRIOResampleAlg::GRIORA_Bilinear;
-        }
+    /// 5.1 每个分块数据在输出中的窗口, 由目录中的六参数与尺寸计算, 不需要打开文件; 保持目录中的顺序, 重叠时以此决定覆盖的先后
+    /// 对于高纬度的地区(高大于宽), 读取时按高度重采样为正方形
+    struct merge_window{
+        size_t tile;                        ///< contains_tiles中的下标
+        int start_x, start_y;
+        int target_width, target_height;
+    };
+    vector<merge_window> merge_windows;
+    for(size_t i = 0; i < contains_tiles.size(); i++){
+        const tile_info& t = contains_tiles[i];
+        merge_window w;
+        w.tile = i;
+        w.start_x = (int)round((t.lon_min - op_gt[0]) / op_gt[1]);
+        w.start_y = (int)round((t.lat_max - op_gt[3]) / op_gt[5]);
+        w.target_height = t.height;
+        w.target_width = t.height > t.width ? t.height : t.width;
+        merge_windows.push_back(w);
+    }
 
-        /// 如果使用irrugular方法, 为了不增加太多耗时, 需要实现计算该数据中每个降采样像素快与shp的相交情况
-        int step = 100;
-        int un_intersect_num = 0;
-        int b_target_height= target_height / step;
-        int b_target_width = target_width  / step;
-        bool* b_arr_intersect = nullptr;
-        
-        if(merging_method == mergingMethod::irregular)
+    /// 5.2 输出按block行划分为条带(约256MB), 条带内的分块数据由线程池并行解码, 按目录顺序拷贝到条带缓存;
+    /// 条带由单独的写出线程按顺序写出(双缓存, 写出第s个条带时解码第s+1个), 只有写出线程访问op_ds.
+    /// 只写出有数据覆盖的block(按连续的block列合并为一次写入), 其余block保持稀疏
+    int block_x_size, block_y_size;
+    op_rb->GetBlockSize(&block_x_size, &block_y_size);
+    size_t row_bytes = size_t(width) * datasize;
+    int strip_rows = MAX(1, int((size_t(256) << 20) / row_bytes));
+    strip_rows = MIN(height, MAX(block_y_size, strip_rows / block_y_size * block_y_size));
+    int strip_num = (height + strip_rows - 1) / strip_rows;
+    int blocks_x = (width + block_x_size - 1) / block_x_size;
+    double nodata_value = datatype == GDT_Float32 ? NAN : -32767;
+    spdlog::info(fmt::format("merging {} images in {} strips of {} rows.", merge_windows.size(), strip_num, strip_rows));
+
+    /// irregular方法: 按条带把(缓冲后的)shp几何体栅格化为byte掩膜(GDALRasterizeGeometries, 扫描线填充, ALL_TOUCHED),
+    /// 每个条带只栅格化一次, 再按行分块并行; 掩膜直接写入strip_mask(MEM波段的DATAPOINTER), 不需要拷贝
+    GDALDriver* dri_mem = GetGDALDriverManager()->GetDriverByName("MEM");
+    auto rasterize_mask = [&](int r0, int r1, unsigned char* mask){
+        int chunk_rows = 64;
+        int chunk_num = (r1 - r0 + chunk_rows - 1) / chunk_rows;
+        std::atomic<bool> ok(true);
+#pragma omp parallel for schedule(dynamic)
+        for(int c = 0; c < chunk_num; c++)
         {
-            b_arr_intersect = new bool[b_target_height * b_target_width];
-            /// 如果拼接方式选择irregular, 就需要计算降采样后的像素与shp的相交关系
-            for(int row = 0; row < b_target_height; row++){
-                for(int col = 0; col < b_target_width; col++){
-                    double lon_min = op_gt[0] + (start_x + col * step) * op_gt[1];
-                    double lon_max = op_gt[0] + (start_x + (col+1) * step) * op_gt[1];
-                    double lat_max = op_gt[3] + (start_y + row * step) * op_gt[5];
-                    double lat_min = op_gt[3] + (start_y + (row+1) * step) * op_gt[5];
-                    bool b = false;
-                    OGRGeometry* img_geometry = range_to_ogrgeometry(lon_min, lon_max, lat_min, lat_max);
-                    for(auto& geometry : shp_geometry_vec){
-                        b = b || geometry->Intersects(img_geometry);
-                    }
-                    OGRGeometryFactory::destroyGeometry(img_geometry);
+            int c0 = r0 + c * chunk_rows, c1 = MIN(r1, c0 + chunk_rows);
+            OGREnvelope chunk_envelope;
+            chunk_envelope.MinX = op_gt[0];
+            chunk_envelope.MaxX = op_gt[0] + width * op_gt[1];
+            chunk_envelope.MaxY = op_gt[3] + c0 * op_gt[5];
+            chunk_envelope.MinY = op_gt[3] + c1 * op_gt[5];
+            vector<OGRGeometryH> geometries;
+            shp_rtree.query(chunk_envelope, [&](size_t g_idx){
+                geometries.push_back((OGRGeometryH)shp_geometry_vec[g_idx]);
+            });
+            if(geometries.empty())
+                continue;
 
-                    b_arr_intersect[row * b_target_width + col] = b;
-                    if(!b) un_intersect_num++;
-                }
+            unsigned char* chunk_mask = mask + size_t(c0 - r0) * width;
+            GDALDataset* ds_mask = dri_mem->Create("", width, c1 - c0, 0, GDT_Byte, nullptr);
+            char pointer[64] = {0};
+            CPLPrintPointer(pointer, chunk_mask, sizeof(pointer));
+            char** band_options = CSLSetNameValue(nullptr, "DATAPOINTER", pointer);
+            if(!ds_mask || ds_mask->AddBand(GDT_Byte, band_options) != CE_None){
+                ok = false;
+                CSLDestroy(band_options);
+                if(ds_mask)
+                    GDALClose(ds_mask);
+                continue;
             }
+            CSLDestroy(band_options);
+            double chunk_gt[6] = {op_gt[0], op_gt[1], op_gt[2], op_gt[3] + c0 * op_gt[5], op_gt[4], op_gt[5]};
+            ds_mask->SetGeoTransform(chunk_gt);
+
+            int band = 1;
+            vector<double> burn_values(geometries.size(), 1.);
+            char** rasterize_options = CSLSetNameValue(nullptr, "ALL_TOUCHED", "TRUE");
+            if(GDALRasterizeGeometries((GDALDatasetH)ds_mask, 1, &band, int(geometries.size()), geometries.data(),
+                    nullptr, nullptr, burn_values.data(), rasterize_options, nullptr, nullptr) != CE_None)
+                ok = false;
+            CSLDestroy(rasterize_options);
+            GDALClose(ds_mask);
         }
+        return bool(ok);
+    };
 
-        // void* arr = malloc(tmp_width * tmp_height * datasize);
-        void* arr = malloc(target_width * target_height * datasize);
+    vector<unsigned char> strip_buffer[2];
+    vector<char> strip_covered[2];      ///< 条带内每个block列是否有数据覆盖
+    vector<unsigned char> strip_mask;   ///< irregular方法中条带的掩膜, 1为在shp内
+    std::future<std::pair<CPLErr, std::string>> pending_write;    ///< 写出结果与错误信息(CPLGetLastErrorMsg只对当前线程有效, 需在写出线程中获取)
+    int pending_strip = -1;
+    int failed_num = 0;
+    for(int s = 0; s < strip_num; s++)
+    {
+        int r0 = s * strip_rows;
+        int r1 = MIN(height, r0 + strip_rows);
+        vector<unsigned char>& strip = strip_buffer[s % 2];
+        strip.resize(row_bytes * (r1 - r0));
+        GDALCopyWords64(&nodata_value, GDT_Float64, 0, strip.data(), datatype, datasize, GPtrDiff_t(width) * (r1 - r0));
+        vector<char>& covered = strip_covered[s % 2];
+        covered.assign(blocks_x, 0);
+        if(merging_method == mergingMethod::irregular){
+            strip_mask.assign(size_t(width) * (r1 - r0), 0);
+            if(!rasterize_mask(r0, r1, strip_mask.data()))
+                spdlog::warn(fmt::format("rasterize mask of strip {} failed, {}", s, CPLGetLastErrorMsg()));
+        }
 
-        
-        rb->RasterIO(GF_Read, 0, 0, tmp_width, tmp_height, arr, target_width, target_height, datatype, 0, 0, b_height_larger_than_width ? &ex_arg : NULL);
-        // rb->RasterIO(GF_Read, 0, 0, tmp_width, tmp_height, arr, tmp_width, tmp_height, datatype, 0, 0);
+        vector<int> strip_windows;
+        for(int k = 0; k < int(merge_windows.size()); k++){
+            const merge_window& w = merge_windows[k];
+            if(w.start_y < r1 && w.start_y + w.target_height > r0)
+                strip_windows.push_back(k);
+        }
 
-        if(merging_method == mergingMethod::irregular)
+#pragma omp parallel
         {
-            switch (datatype)
+            vector<unsigned char> arr;
+#pragma omp for ordered schedule(dynamic)
+            for(int k = 0; k < int(strip_windows.size()); k++)
             {
-            case GDT_Int16:{
-                short* p_arr = (short*)arr;
-                for(int row = 0; row < target_height; row++){
-                    for(int col = 0; col < target_width; col++){
-                        int b_arr_index = row / step * b_target_width + col/step;
-                        if(!b_arr_intersect[b_arr_index]){
-                            p_arr[row * target_width + col] = -32767;
-                        }
+                const merge_window& w = merge_windows[strip_windows[k]];
+                const tile_info& t = contains_tiles[w.tile];
+                /// 该分块数据在本条带内的行, 以及在输出范围内的列
+                int y0 = MAX(r0, w.start_y), y1 = MIN(r1, w.start_y + w.target_height);
+                int x0 = MAX(0, w.start_x), x1 = MIN(width, w.start_x + w.target_width);
+                int rows = y1 - y0;
+                bool ok = x0 < x1;
+
+                if(ok){
+                    GDALDataset* ds = (GDALDataset*)GDALOpen(t.path.c_str(), GA_ReadOnly);
+                    ok = ds != nullptr;
+                    if(ok){
+                        GDALRasterIOExtraArg ex_arg;
+                        INIT_RASTERIO_EXTRA_ARG(ex_arg);
+                        bool b_height_larger_than_width = w.target_width != t.width;
+                        if(b_height_larger_than_width)
+                            ex_arg.eResampleAlg = GDALRIOResampleAlg::GRIORA_Bilinear;
+                        arr.resize(size_t(w.target_width) * rows * datasize);
+                        ok = ds->GetRasterBand(1)->RasterIO(GF_Read, 0, y0 - w.start_y, t.width, rows, arr.data(), w.target_width, rows,
+                                datatype, 0, 0, b_height_larger_than_width ? &ex_arg : NULL) == CE_None;
+                        GDALClose(ds);
                     }
                 }
-                }break;
-            case GDT_Int32:{
-                int* p_arr = (int*)arr;
-                for(int row = 0; row < target_height; row++){
-                    for(int col = 0; col < target_width; col++){
-                        int b_arr_index = row / step * b_target_width + col/step;
-                        if(!b_arr_intersect[b_arr_index]){
-                            p_arr[row * target_width + col] = -32767;
+
+                if(ok && merging_method == mergingMethod::irregular)
+                {
+                    /// 与条带掩膜逐像素选择, 掩膜外置为无效值
+                    for(int y = y0; y < y1; y++){
+                        unsigned char* p = arr.data() + (size_t(y - y0) * w.target_width + (x0 - w.start_x)) * datasize;
+                        const unsigned char* m = strip_mask.data() + size_t(y - r0) * width + x0;
+                        switch (datatype)
+                        {
+                        case GDT_Int16:
+                            apply_mask((short*)p, m, short(-32767), x1 - x0);
+                            break;
+                        case GDT_Int32:
+                            apply_mask((int*)p, m, int(-32767), x1 - x0);
+                            break;
+                        case GDT_Float32:
+                            apply_mask((float*)p, m, float(NAN), x1 - x0);
+                            break;
+                        default:
+                            break;
                         }
                     }
                 }
-                }break;
-            case GDT_Float32:{
-                float* p_arr = (float*)arr;
-                for(int row = 0; row < target_height; row++){
-                    for(int col = 0; col < target_width; col++){
-                        int b_arr_index = row / step * b_target_width + col/step;
-                        if(!b_arr_intersect[b_arr_index]){
-                            p_arr[row * target_width + col] = NAN;
+
+                /// 按目录顺序拷贝到条带缓存, 窗口重叠时目录中靠后的数据覆盖靠前的
+#pragma omp ordered
+                {
+                    if(!ok){
+                        failed_num++;
+                    }
+                    else{
+                        for(int bx = x0 / block_x_size; bx * block_x_size < x1; bx++)
+                            covered[bx] = 1;
+                        for(int y = y0; y < y1; y++){
+                            memcpy(strip.data() + size_t(y - r0) * row_bytes + size_t(x0) * datasize,
+                                arr.data() + (size_t(y - y0) * w.target_width + (x0 - w.start_x)) * datasize,
+                                size_t(x1 - x0) * datasize);
                         }
                     }
                 }
-                }break;
             }
-            delete[] b_arr_intersect;
         }
 
-        op_rb->RasterIO(GF_Write, start_x, start_y, target_width, target_height, arr, target_width, target_height, datatype, 0, 0);
-        
-#else
-        void* arr = malloc(tmp_width * datasize);
-
-        for(int ii = 0; ii < tmp_height; ii++)
-        {
-            rb->RasterIO(GF_Read, 0, ii, tmp_width, 1, arr, tmp_width, 1, datatype, 0, 0);
-            op_rb->RasterIO(GF_Write, start_x, start_y + ii, tmp_width, 1, arr, tmp_width, 1, datatype, 0, 0);
-        }
-
-#endif
-        free(arr);
-        GDALClose(ds);
-
-
-        auto t2= chrono::system_clock::now();
-        if( i != 0){
-            auto spend = spend_time(merging_starttime);
-            size_t remain_sceond = size_t(spend / i * (contains_num  - i));
-            std::cout<<fmt::format("\r  merging percentage {:.1f}%({}/{}), time of parent rasterio spend:{}s, remain_time:{}s...            ",
-            i*100./contains_num, i, contains_num,
-            spend_time(t1,t2), 
-            remain_sceond);
+        /// 等待上一个条带写出后, 再写出当前条带
+        if(pending_write.valid()){
+            auto [err, msg] = pending_write.get();
+            if(err != CE_None)
+                spdlog::warn(fmt::format("write strip {} failed, {}", pending_strip, msg));
         }
+        pending_strip = s;
+        pending_write = std::async(std::launch::async, [&op_rb, &strip, &covered, r0, r1, width, datatype, datasize, row_bytes, blocks_x, block_x_size](){
+            CPLErr err = CE_None;
+            for(int bx0 = 0; bx0 < blocks_x && err == CE_None; bx0++){
+                if(!covered[bx0])
+                    continue;
+                int bx1 = bx0;
+                while(bx1 < blocks_x && covered[bx1])
+                    bx1++;
+                int x0 = bx0 * block_x_size, x1 = MIN(width, bx1 * block_x_size);
+                err = op_rb->RasterIO(GF_Write, x0, r0, x1 - x0, r1 - r0, strip.data() + size_t(x0) * datasize, x1 - x0, r1 - r0,
+                        datatype, datasize, GSpacing(row_bytes));
+                bx0 = bx1;
+            }
+            return std::make_pair(err, std::string(err != CE_None ? CPLGetLastErrorMsg() : ""));
+        });
+
+        auto spend = spend_time(merging_starttime);
+        size_t remain_sceond = size_t(spend / (s + 1) * (strip_num - s - 1));
+        std::cout<<fmt::format("\r  merging percentage {:.1f}%({}/{}), images in strip:{}, remain_time:{}s...            ",
+        (s + 1)*100./strip_num, s + 1, strip_num,
+        strip_windows.size(),
+        remain_sceond);
+    }
+    if(pending_write.valid()){
+        auto [err, msg] = pending_write.get();
+        if(err != CE_None)
+            spdlog::warn(fmt::format("write strip {} failed, {}", pending_strip, msg));
     }
     std::cout<<"\n";
+    if(failed_num > 0)
+        spdlog::warn(fmt::format("{} parts of images open or read failed, skipped.", failed_num));
+    spdlog::info(fmt::format("merging spend time: {:.3f}s.", spend_time(merging_starttime)));
 
     GDALClose(op_ds);
     
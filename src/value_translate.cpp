@@ -1,5 +1,6 @@
 #include "raster_include.h"
 #include "template_nan_convert_to.h"
+#include "raster_copy.h"
 /*
         sub_value_translate.add_argument("input_imgpath")
             .help("the original image with the source value.");
@@ -23,65 +24,47 @@ int value_translate(argparse::ArgumentParser* args, std::shared_ptr<spdlog::logg
     double input_val = args->get<double>("source_value");
     double output_val = args->get<double>("target_value");
 
-    if(input_filepath!= output_filepath){
-        fs::path src(input_filepath);
-        fs::path dst(output_filepath);
-        if(fs::exists(dst)){
-            PRINT_LOGGER(logger, warn, "output is existed, we will remove and copy input to output.");
-            fs::remove(dst);
-        }
-        fs::copy(src,dst);
-    }
-    PRINT_LOGGER(logger, info, "input_file has been copy to output_file.");
-
     GDALAllRegister();
     CPLSetConfigOption("GDAL_FILENAME_IS_UTF8", "NO");
 
-    GDALDataset* ds = static_cast<GDALDataset*>(GDALOpen(output_filepath.c_str(), GA_Update));
-    if(ds == nullptr){
-        PRINT_LOGGER(logger, error,"ds is nullptr. output is no-existed(when input==output), or cann't be create?");
+    /// 输入输出相同时原地处理, 否则只读打开输入, 以输入的驱动与创建参数新建输出并直接写入, 不再复制输入文件
+    bool in_place = input_filepath == output_filepath;
+    GDALDataset* ds_in = static_cast<GDALDataset*>(GDALOpen(input_filepath.c_str(), in_place ? GA_Update : GA_ReadOnly));
+    if(ds_in == nullptr){
+        PRINT_LOGGER(logger, error,"ds_in is nullptr.");
         return -1;
     }
-        
-    int xsize = ds->GetRasterXSize();
-    int ysize = ds->GetRasterYSize();
-    int bands = ds->GetRasterCount();
-    GDALDataType datatype = ds->GetRasterBand(1)->GetRasterDataType();
-    PRINT_LOGGER(logger, info, fmt::format("the basic info of output_file: width:{}, height:{}, datatype:{}", xsize, ysize, GDALGetDataTypeName(datatype)));
 
-    funcrst rst;
-    switch (datatype)
-    {
-    case GDT_Float32:{
-        float in_val = input_val, out_val = output_val;
-        PRINT_LOGGER(logger, info,fmt::format("input_value:[{}], output_value:[{}]", in_val, out_val));
-        rst = value_transto(ds, in_val, out_val);
-    }break;
-    case GDT_Float64:{
-        double in_val = input_val, out_val = output_val;
-        PRINT_LOGGER(logger, info,fmt::format("input_value:[{}], output_value:[{}]", in_val, out_val));
-        rst = value_transto(ds,in_val, out_val);
-    }break;
-    case GDT_Int16:{
-        short in_val = input_val, out_val = output_val;
-        PRINT_LOGGER(logger, info,fmt::format("input_value:[{}], output_value:[{}]", in_val, out_val));
-        rst = value_transto(ds,in_val,out_val);
-    }break;
-    case GDT_Int32:{
-        int in_val = input_val, out_val = output_val;
-        PRINT_LOGGER(logger, info,fmt::format("input_value:[{}], output_value:[{}]", in_val, out_val));
-        rst = value_transto(ds, in_val, out_val);
-    }break;
-    default:
-        PRINT_LOGGER(logger, error,"unsupport datatype. (not float, double, short, int)");
-        return -2;
+    int xsize = ds_in->GetRasterXSize();
+    int ysize = ds_in->GetRasterYSize();
+    GDALDataType datatype = ds_in->GetRasterBand(1)->GetRasterDataType();
+    PRINT_LOGGER(logger, info, fmt::format("the basic info of input_file: width:{}, height:{}, datatype:{}", xsize, ysize, GDALGetDataTypeName(datatype)));
+
+    GDALDataset* ds_out = ds_in;
+    if(!in_place){
+        if(fs::exists(output_filepath)){
+            PRINT_LOGGER(logger, warn, "output is existed, we will remove it.");
+            fs::remove(output_filepath);
+        }
+        std::string err;
+        ds_out = create_like(ds_in, output_filepath, err);
+        if(ds_out == nullptr){
+            GDALClose(ds_in);
+            PRINT_LOGGER(logger, error, fmt::format("ds_out is nullptr, {}", err));
+            return -2;
+        }
     }
+
+    PRINT_LOGGER(logger, info,fmt::format("input_value:[{}], output_value:[{}]", input_val, output_val));
+    funcrst rst = value_transto(ds_in, ds_out, datatype, input_val, output_val);
+    if(ds_out != ds_in)
+        GDALClose(ds_out);
+    GDALClose(ds_in);
     if(!rst){
         PRINT_LOGGER(logger, error,fmt::format("template function 'value_transto', return false, cause '{}'",rst.explain));
         return -3;
     }
-    
-    GDALClose(ds);
+
     PRINT_LOGGER(logger, info,"value_translate success.");
     return 0;
 
@@ -1,4 +1,10 @@
 #include "raster_include.h"
+#include "raw_raster_view.h"
+
+#include <omp.h>
+#include <atomic>
+#include <memory>
+
 /*
     sub_vrt_to_tif.add_argument("vrt")
         .help("input image filepath (*.vrt)");
@@ -6,12 +12,50 @@
     sub_vrt_to_tif.add_argument("tif")
         .help("output image filepath (*.tif)");    
 
+    sub_vrt_to_tif.add_argument("-b","--block")
+        .help("tile size of output tif, 0 means striped tif, default is 256.")
+        .scan<'i',int>()
+        .default_value("256");
+
+    sub_vrt_to_tif.add_argument("-c","--compress")
+        .help("compression of output tif: none, deflate, zstd or lzw, default is none.")
+        .choices("none","deflate","zstd","lzw")
+        .default_value("none");
+
+    sub_vrt_to_tif.add_argument("-p","--predictor")
+        .help("predictor used with compression, 0 means auto (2 for integer, 3 for float, 1 for complex), default is 0.")
+        .scan<'i',int>()
+        .choices("0","1","2","3")
+        .default_value("0");
+
+    sub_vrt_to_tif.add_argument("--bigtiff")
+        .help("BIGTIFF creation option: yes, no, if_needed or if_safer, default is if_safer.")
+        .choices("yes","no","if_needed","if_safer")
+        .default_value("if_safer");
+
+    sub_vrt_to_tif.add_argument("-t","--threads")
+        .help("threads for reading and compressing, 0 means all cpus, default is 0.")
+        .scan<'i',int>()
+        .default_value("0");
 */
 
 int vrt_to_tif(argparse::ArgumentParser* args,std::shared_ptr<spdlog::logger> logger)
 {
     string vrt_filepath = args->get<string>("vrt");
     string tif_filepath = args->get<string>("tif");
+    int block = args->get<int>("--block");
+    string compress = args->get<string>("--compress");
+    int predictor = args->get<int>("--predictor");
+    string bigtiff = args->get<string>("--bigtiff");
+    int threads = args->get<int>("--threads");
+    std::transform(compress.begin(), compress.end(), compress.begin(), ::toupper);
+    std::transform(bigtiff.begin(), bigtiff.end(), bigtiff.begin(), ::toupper);
+    if(block < 0 || block % 16 != 0){
+        PRINT_LOGGER(logger, error, fmt::format("block ({}) should be 0 or a multiple of 16.", block));
+        return -1;
+    }
+    if(threads <= 0)
+        threads = omp_get_num_procs();
 
     GDALAllRegister();
     CPLSetConfigOption("GDAL_FILENAME_IS_UTF8", "NO");
@@ -27,34 +71,126 @@ int vrt_to_tif(argparse::ArgumentParser* args,std::shared_ptr<spdlog::logger> lo
     int height = ds_in->GetRasterYSize();
     int bands = ds_in->GetRasterCount();
     GDALDataType datatype = rb->GetRasterDataType();
-    int datasize = GDALGetDataTypeSize(datatype);
+    int datasize = GDALGetDataTypeSizeBytes(datatype);
+
+    /// 创建选项: 分块, 压缩(及预测器), BIGTIFF, 压缩线程数
+    if(predictor == 0)
+        predictor = GDALDataTypeIsComplex(datatype) ? 1 : (GDALDataTypeIsFloating(datatype) ? 3 : 2);
+    char** options = nullptr;
+    if(block > 0){
+        options = CSLSetNameValue(options, "TILED", "YES");
+        options = CSLSetNameValue(options, "BLOCKXSIZE", std::to_string(block).c_str());
+        options = CSLSetNameValue(options, "BLOCKYSIZE", std::to_string(block).c_str());
+    }
+    if(compress != "NONE"){
+        options = CSLSetNameValue(options, "COMPRESS", compress.c_str());
+        options = CSLSetNameValue(options, "PREDICTOR", std::to_string(predictor).c_str());
+        options = CSLSetNameValue(options, "NUM_THREADS", std::to_string(threads).c_str());
+    }
+    options = CSLSetNameValue(options, "BIGTIFF", bigtiff.c_str());
 
     GDALDriver* driver_tif = GetGDALDriverManager()->GetDriverByName("GTiff");
-    GDALDataset* ds_out = driver_tif->Create(tif_filepath.c_str(), width, height, bands, datatype,NULL);
+    GDALDataset* ds_out = driver_tif->Create(tif_filepath.c_str(), width, height, bands, datatype, options);
+    CSLDestroy(options);
     if(!ds_out){
         GDALClose(ds_in);
-        PRINT_LOGGER(logger, error, "ds_out is nullptr");
+        PRINT_LOGGER(logger, error, fmt::format("ds_out is nullptr, {}", CPLGetLastErrorMsg()));
         return -2;
     }
-    GDALRasterBand* rb_out = ds_out->GetRasterBand(1);
+    double gt[6];
+    if(ds_in->GetGeoTransform(gt) == CE_None)
+        ds_out->SetGeoTransform(gt);
+    ds_out->SetProjection(ds_in->GetProjectionRef());
+    for(int b = 1; b <= bands; b++){
+        int has_nodata = 0;
+        double nodata = ds_in->GetRasterBand(b)->GetNoDataValue(&has_nodata);
+        if(has_nodata)
+            ds_out->GetRasterBand(b)->SetNoDataValue(nodata);
+    }
+    GDALClose(ds_in);
+
+    /// raw vrt(如tif2vrt的结果)的波段直接从内存映射读取, 不经过GDAL的block cache; 视图只读, 各线程共用
+    std::vector<std::unique_ptr<raw_raster_view>> views(bands);
+    bool all_raw = true;
+    for(int b = 1; b <= bands; b++){
+        views[b - 1] = std::make_unique<raw_raster_view>();
+        if(!views[b - 1]->open_vrt(vrt_filepath, b)){
+            views[b - 1].reset();
+            all_raw = false;
+        }
+    }
 
-    for(int b = 1; b <= bands; b++)
+    /// 以输出的分块行为单位划分条带(整行宽), 多线程读取, 按条带顺序写出, 使输出按分块顺序写入
+    int tile_rows = block > 0 ? block : 1;
+    int strip = tile_rows * MAX(1, int((size_t(1) << 22) / (size_t(width) * tile_rows)));
+    int num = (height + strip - 1) / strip;
+    std::atomic<bool> failed(false);
+    std::string err_msg;
+    auto set_failed = [&](std::string msg){
+#pragma omp critical(vrt_to_tif_err)
+        {
+            if(!failed.exchange(true))
+                err_msg = msg;
+        }
+    };
+
+    auto start_time = std::chrono::system_clock::now();
+#pragma omp parallel num_threads(threads)
     {
-        auto rb_in = ds_in->GetRasterBand(b);
-        auto rb_out = ds_out->GetRasterBand(b);
-        void* arr = malloc(width * datasize);
-        for(int i=0; i<height; i++)
+        GDALDataset* ds_thread = all_raw ? nullptr : (GDALDataset*)GDALOpen(vrt_filepath.c_str(), GA_ReadOnly);
+        if(!all_raw && ds_thread == nullptr)
+            set_failed("open vrt failed in thread.");
+        std::vector<unsigned char> arr;
+
+#pragma omp for ordered schedule(dynamic)
+        for(int s = 0; s < num; s++)
         {
-            rb_in->RasterIO(GF_Read, 0, i, width, 1, arr, width, 1, datatype, 0, 0);
-            rb_out->RasterIO(GF_Write, 0, i, width, 1, arr, width, 1, datatype, 0, 0);
+            int row = s * strip;
+            int rows = MIN(strip, height - row);
+            GSpacing band_space = GSpacing(width) * rows * datasize;
+            bool ok = !failed;
+            if(ok){
+                arr.resize(size_t(band_space) * bands);
+                /// 映射区关闭了整文件的顺序预读(MADV_RANDOM), 读取前按条带预读, 避免逐页缺页
+                for(int b = 1; b <= bands; b++){
+                    if(views[b - 1])
+                        views[b - 1]->will_need(row, rows);
+                }
+                for(int b = 1; b <= bands && ok; b++){
+                    unsigned char* dst = arr.data() + band_space * (b - 1);
+                    if(views[b - 1])
+                        ok = views[b - 1]->read(0, row, width, rows, dst, datatype);
+                    else
+                        ok = ds_thread->GetRasterBand(b)->RasterIO(GF_Read, 0, row, width, rows, dst, width, rows, datatype, 0, 0) == CE_None;
+                }
+                if(!ok)
+                    set_failed(fmt::format("read rows [{}, {}) failed.", row, row + rows));
+            }
+
+#pragma omp ordered
+            {
+                if(ok && !failed){
+                    CPLErr err = ds_out->RasterIO(GF_Write, 0, row, width, rows, arr.data(), width, rows, datatype,
+                        bands, nullptr, datasize, GSpacing(width) * datasize, band_space, nullptr);
+                    if(err != CE_None)
+                        set_failed(fmt::format("write rows [{}, {}) failed, {}", row, row + rows, CPLGetLastErrorMsg()));
+                    else
+                        GDALTermProgress(double(row + rows) / height, nullptr, nullptr);
+                }
+            }
         }
-        free(arr);
+
+        if(ds_thread)
+            GDALClose(ds_thread);
     }
 
-    GDALClose(ds_in);
     GDALClose(ds_out);
+    if(failed){
+        PRINT_LOGGER(logger, error, fmt::format("vrt_to_tif failed, {}", err_msg));
+        return -3;
+    }
 
-    PRINT_LOGGER(logger, info,"vrt_to_tif success.");
+    PRINT_LOGGER(logger, info, fmt::format("vrt_to_tif success, spend time {}s.", spend_time(start_time)));
     return 1;
 }
 
@@ -68,30 +204,94 @@ int vrt_to_tif(argparse::ArgumentParser* args,std::shared_ptr<spdlog::logger> lo
         
     sub_tif_to_vrt.add_argument("ByteOrder")
         .help("MSB or LSB");
+
+    sub_tif_to_vrt.add_argument("--direct_io")
+        .help("write binary with direct io (bypass the system cache), for data much larger than memory.")
+        .implicit_value(true)
+        .default_value(false);
 */
 
 #include "binary_write.h"
 
+/// @brief 按行条带并行读取tif的第一个波段, 每个线程独立打开数据集, 用binary_write::write_rows写入各自的行
+template<typename _Ty>
+funcrst tif_to_binary_strips(std::string tif_filepath, binary_write<_Ty>& bw, GDALDataType datatype)
+{
+    GDALDataset* ds = (GDALDataset*)GDALOpen(tif_filepath.c_str(), GA_ReadOnly);
+    if(!ds)
+        return funcrst(false, "tif_to_binary_strips, ds is nullptr.");
+    int width = ds->GetRasterXSize();
+    int height = ds->GetRasterYSize();
+    int block_x, block_y;
+    ds->GetRasterBand(1)->GetBlockSize(&block_x, &block_y);
+    GDALClose(ds);
+
+    /// 条带高度为block高度的整数倍, 每个条带约4M像素
+    block_y = MAX(1, block_y);
+    int strip = block_y * MAX(1, int((size_t(1) << 22) / (size_t(width) * block_y)));
+    int num = (height + strip - 1) / strip;
+    std::atomic<bool> failed(false);
+    std::string err_msg;
+
+#pragma omp parallel
+    {
+        GDALDataset* ds_thread = (GDALDataset*)GDALOpen(tif_filepath.c_str(), GA_ReadOnly);
+        std::vector<_Ty> arr;
+#pragma omp for schedule(dynamic)
+        for(int s = 0; s < num; s++)
+        {
+            if(failed || ds_thread == nullptr){
+                failed = true;
+                continue;
+            }
+            int row = s * strip;
+            int rows = MIN(strip, height - row);
+            arr.resize(size_t(rows) * width);
+            funcrst rst(true, "");
+            CPLErr err = ds_thread->GetRasterBand(1)->RasterIO(GF_Read, 0, row, width, rows, arr.data(), width, rows, datatype, 0, 0);
+            if(err != CE_None)
+                rst = funcrst(false, CPLGetLastErrorMsg());
+            else
+                rst = bw.write_rows(row, rows, arr.data());
+            if(!rst){
+#pragma omp critical(tif_to_binary_strips_err)
+                {
+                    failed = true;
+                    err_msg = rst.explain;
+                }
+            }
+        }
+        if(ds_thread)
+            GDALClose(ds_thread);
+    }
+
+    if(failed)
+        return funcrst(false, "tif_to_binary_strips failed. (" + err_msg + ")");
+    return funcrst(true, "tif_to_binary_strips success.");
+}
+
 #define IMG_WRITE(type) \
         binary_write<type> bw;                                                          \
-        rst = bw.init(binary_filepath.c_str(), height, width, byte_order);              \
+        rst = bw.init(binary_filepath.c_str(), height, width, byte_order, direct_io);   \
         if(!rst){                                                                       \
             PRINT_LOGGER(logger, error, fmt::format("bw<{}>.init failed, by {}.",#type, rst.explain));      \
             return -3;                                                                  \
         }                                                                               \
-        type* arr = new type[width];                                                    \
-        for(int i=0; i<height; i++){                                                    \
-            rb_in->RasterIO(GF_Read, 0, i, width, 1, arr, width, 1, datatype, 0, 0);    \
-            bw.array_to_bin(arr, width);                                                \
+        rst = tif_to_binary_strips<type>(tif_filepath, bw, datatype);                   \
+        if(!rst){                                                                       \
+            PRINT_LOGGER(logger, error, fmt::format("bw<{}>.write failed, by {}.",#type, rst.explain)); \
+            return -4;                                                                  \
+        }                                                                               \
+        rst = bw.close();                                                               \
+        if(!rst){                                                                       \
+            PRINT_LOGGER(logger, error, fmt::format("bw<{}>.close failed, by {}.",#type, rst.explain)); \
+            return -4;                                                                  \
         }                                                                               \
-        std::cout<<std::endl;                                                           \
-        delete[] arr;                                                                   \
         rst = bw.print_vrt();                                                           \
         if(!rst){                                                                       \
             PRINT_LOGGER(logger, error, fmt::format("bw<{}>.print_vrt failed, by {}.",#type, rst.explain)); \
             return -4;                                                                  \
         }                                                                               \
-        bw.close();                                                                     \
 
 int tif_to_vrt(argparse::ArgumentParser* args,std::shared_ptr<spdlog::logger> logger)
 {
@@ -106,6 +306,7 @@ int tif_to_vrt(argparse::ArgumentParser* args,std::shared_ptr<spdlog::logger> lo
         return -1;
     }
     ByteOrder_ byte_order = (str_byteorder == "LSB" ? ByteOrder_::LSB : ByteOrder_::MSB );
+    bool direct_io = args->get<bool>("--direct_io");
 
     GDALAllRegister();
     CPLSetConfigOption("GDAL_FILENAME_IS_UTF8", "NO");